@@ -0,0 +1,543 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Micro-benchmarks for the embedder's own hot paths. Links against the stub
+// engine so that only embedder overhead is measured. Run with an optional
+// substring to select benchmarks by name.
+
+#include <linux/input.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_loop.h"
+#include "flutter_application.h"
+#include "flutter_engine_stub.h"
+#include "frame_capture.h"
+#include "framebuffer_display.h"
+#include "histogram.h"
+#include "pointer_event_queue.h"
+#include "standard_message_codec.h"
+#include "utils.h"
+
+namespace flutter {
+
+// An OpenGL render delegate that does no work so that only the embedder's
+// callback plumbing is measured.
+class NullRenderDelegate : public FlutterApplication::RenderDelegate {
+public:
+  bool OnApplicationContextMakeCurrent() override { return true; }
+
+  bool OnApplicationContextClearCurrent() override { return true; }
+
+  bool OnApplicationPresent() override { return true; }
+};
+
+class BenchmarkRunner {
+public:
+  explicit BenchmarkRunner(std::string filter) : filter_(std::move(filter)) {}
+
+  // Runs |body| once and reports the time per iteration. |body| performs
+  // |iterations| iterations and may append a note to the report.
+  void Run(const std::string &name, size_t iterations,
+           const std::function<void(size_t iterations, std::string &note)>
+               &body) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+      return;
+    }
+
+    std::string note;
+    const auto start = GetMonotonicTimeNanos();
+    body(iterations, note);
+    const auto elapsed = GetMonotonicTimeNanos() - start;
+
+    std::cout << std::left << std::setw(32) << name << std::right
+              << std::setw(10) << iterations << std::setw(14) << std::fixed
+              << std::setprecision(1)
+              << static_cast<double>(elapsed) / iterations << " ns/op  "
+              << note << std::endl;
+  }
+
+private:
+  const std::string filter_;
+};
+
+// The files of a minimal JIT bundle, with the ICU data file the application
+// falls back to. The stub engine reads neither.
+static const char *kBundleFiles[] = {"kernel_blob.bin", "icudtl.dat"};
+
+static void RemoveBundle(const std::string &bundle) {
+  for (auto name : kBundleFiles) {
+    ::unlink((bundle + "/" + name).c_str());
+  }
+  ::rmdir(bundle.c_str());
+}
+
+// Creates the bundle in a temporary directory, which RemoveBundle deletes.
+static std::string PrepareBundle() {
+  char directory[] = "/tmp/flutter_benchmark_XXXXXX";
+  if (::mkdtemp(directory) == nullptr) {
+    return "";
+  }
+
+  std::string bundle = directory;
+  for (auto name : kBundleFiles) {
+    auto file = ::fopen((bundle + "/" + name).c_str(), "wb");
+    if (file == nullptr) {
+      RemoveBundle(bundle);
+      return "";
+    }
+    ::fclose(file);
+  }
+  return bundle;
+}
+
+static std::string FormatSummary(const Histogram::Summary &summary) {
+  return "p50 " + std::to_string(summary.p50) + " us, p95 " +
+         std::to_string(summary.p95) + " us, p99 " +
+         std::to_string(summary.p99) + " us";
+}
+
+static void BenchmarkStartup(BenchmarkRunner &runner,
+                             const std::string &bundle) {
+  runner.Run("ApplicationStartup", 200, [&](size_t iterations, std::string &) {
+    EventLoop loop;
+    NullRenderDelegate delegate;
+    for (size_t i = 0; i < iterations; ++i) {
+      FlutterApplication application(bundle, {bundle}, delegate, loop);
+      if (!application.IsValid()) {
+        FLWAY_ERROR << "Could not launch the application." << std::endl;
+        return;
+      }
+    }
+  });
+}
+
+static void BenchmarkPointerEvents(BenchmarkRunner &runner) {
+  // A producer thread feeding strokes through the ring and coalescer to the
+  // engine-facing thread as fast as it can. The producer waits for each
+  // stroke to be dispatched before starting the next so the ring never fills.
+  runner.Run(
+      "PointerQueueThroughput", 1000000,
+      [&](size_t iterations, std::string &note) {
+        const size_t stroke_length = 512;
+        std::atomic<size_t> strokes_done(0);
+        size_t dispatched = 0;
+        size_t batches = 0;
+        PointerEventQueue queue(
+            1000000000ull / 60,
+            [&](const FlutterPointerEvent *events, size_t count, uint64_t) {
+              dispatched += count;
+              batches++;
+              for (size_t i = 0; i < count; ++i) {
+                if (events[i].phase == kUp) {
+                  strokes_done++;
+                }
+              }
+            });
+
+        std::thread producer([&]() {
+          FlutterPointerEvent event = {};
+          event.struct_size = sizeof(event);
+          size_t strokes = 0;
+          for (size_t i = 0; i < iterations; ++i) {
+            const auto position = i % stroke_length;
+            if (position == 0) {
+              event.phase = kDown;
+            } else if (position == stroke_length - 1 || i == iterations - 1) {
+              event.phase = kUp;
+            } else {
+              event.phase = kMove;
+            }
+            event.x = position;
+            event.timestamp = i;
+            queue.OnInputPointerEvents(&event, 1);
+            if (event.phase == kUp) {
+              strokes++;
+              while (strokes_done.load() != strokes) {
+                std::this_thread::yield();
+              }
+            }
+          }
+          queue.Close();
+        });
+
+        // Block on the wakeup like the event loop would, until coalesced
+        // moves are due.
+        uint64_t deadline = 0;
+        while (!queue.IsClosed()) {
+          int timeout = -1;
+          if (deadline != 0) {
+            const auto now = GetMonotonicTimeNanos();
+            timeout = deadline > now ? (deadline - now) / 1000000 : 0;
+          }
+          struct pollfd poll_fd = {queue.GetWakeupFD(), POLLIN, 0};
+          ::poll(&poll_fd, 1, timeout);
+          deadline = queue.Dispatch();
+        }
+        producer.join();
+
+        note = std::to_string(dispatched) + " dispatched in " +
+               std::to_string(batches) + " batches, " +
+               std::to_string(queue.GetCoalescedCount()) + " coalesced";
+      });
+}
+
+// A barcode scanner typing codes as fast as it can, each key pressed and
+// released in reports of their own. Each code is typed once the previous
+// one has been sent so that the ring never fills.
+static void BenchmarkKeyEvents(BenchmarkRunner &runner,
+                               const std::string &bundle) {
+  EventLoop loop;
+  NullRenderDelegate delegate;
+  FlutterApplication application(bundle, {bundle}, delegate, loop);
+  auto keyboard = application.AcceptKeyEvents();
+  if (keyboard == nullptr) {
+    FLWAY_ERROR << "Could not accept key events." << std::endl;
+    return;
+  }
+
+  runner.Run(
+      "KeyEventBurst", 1000000, [&](size_t iterations, std::string &note) {
+        static const uint16_t kBarcode[] = {
+            KEY_4, KEY_0, KEY_0, KEY_6, KEY_3, KEY_8, KEY_1,
+            KEY_3, KEY_3, KEY_9, KEY_3, KEY_2, KEY_1, KEY_ENTER,
+        };
+        const size_t code_length = sizeof(kBarcode) / sizeof(kBarcode[0]);
+        FlutterEngineStubResetCounters();
+        loop.TakeStats();
+
+        std::thread scanner([&]() {
+          InputKeyEvent event;
+          size_t sent = 0;
+          for (size_t i = 0; i < iterations; ++i) {
+            event.timestamp = GetMonotonicTimeNanos() / 1000;
+            event.code = kBarcode[i % code_length];
+            event.pressed = true;
+            keyboard->OnInputKeyEvents(&event, 1);
+            event.pressed = false;
+            keyboard->OnInputKeyEvents(&event, 1);
+            sent += 2;
+            if (i % code_length == code_length - 1 || i == iterations - 1) {
+              while (FlutterEngineStubGetPlatformMessageCount() != sent) {
+                std::this_thread::yield();
+              }
+            }
+          }
+          loop.Terminate();
+        });
+        loop.Run();
+        scanner.join();
+
+        note = std::to_string(FlutterEngineStubGetPlatformMessageCount()) +
+               " messages in " + std::to_string(loop.TakeStats().wakeups) +
+               " wakeups";
+      });
+}
+
+static void BenchmarkPresent(BenchmarkRunner &runner,
+                             const std::string &bundle) {
+  {
+    EventLoop loop;
+    NullRenderDelegate delegate;
+    FlutterApplication application(bundle, {bundle}, delegate, loop);
+    auto config = FlutterEngineStubGetRendererConfig();
+    auto user_data = FlutterEngineStubGetUserData();
+
+    runner.Run("OpenGLFrameCallbacks", 1000000,
+               [&](size_t iterations, std::string &) {
+                 for (size_t i = 0; i < iterations; ++i) {
+                   config->open_gl.make_current(user_data);
+                   config->open_gl.fbo_callback(user_data);
+                   config->open_gl.present(user_data);
+                   config->open_gl.clear_current(user_data);
+                 }
+               });
+  }
+
+  const size_t width = 800;
+  const size_t height = 480;
+  const size_t row_bytes = width * 4;
+  std::vector<uint8_t> frames[2];
+  for (auto &frame : frames) {
+    frame.resize(row_bytes * height);
+  }
+  for (size_t i = 0; i < frames[0].size(); ++i) {
+    frames[0][i] = i * 31;
+    frames[1][i] = i * 17;
+  }
+
+  for (auto format : {PixelFormat::kBGRA8888, PixelFormat::kRGBA8888,
+                      PixelFormat::kRGB565}) {
+    EventLoop loop;
+    FramebufferDisplay display(width, height, format);
+    FlutterApplication application(bundle, {bundle}, display, loop);
+    auto config = FlutterEngineStubGetRendererConfig();
+    auto user_data = FlutterEngineStubGetUserData();
+
+    // Every tile changes on every frame.
+    runner.Run(std::string{"SoftwarePresent"} + PixelFormatToString(format),
+               1000, [&](size_t iterations, std::string &note) {
+                 const auto start = GetMonotonicTimeNanos();
+                 for (size_t i = 0; i < iterations; ++i) {
+                   config->software.surface_present_callback(
+                       user_data, frames[i % 2].data(), row_bytes, height);
+                 }
+                 const double seconds =
+                     (GetMonotonicTimeNanos() - start) / 1e9;
+                 note = std::to_string(static_cast<size_t>(
+                            row_bytes * height * iterations / seconds / 1e6)) +
+                        " MB/s read";
+               });
+
+    // A static screen with a small clock like region that changes on every
+    // frame.
+    runner.Run(std::string{"SoftwarePresentTicking"} +
+                   PixelFormatToString(format),
+               1000, [&](size_t iterations, std::string &) {
+                 auto &frame = frames[0];
+                 for (size_t i = 0; i < iterations; ++i) {
+                   for (size_t y = 16; y < 48; ++y) {
+                     ::memset(frame.data() + y * row_bytes + 16 * 4, i,
+                              96 * 4);
+                   }
+                   config->software.surface_present_callback(
+                       user_data, frame.data(), row_bytes, height);
+                 }
+               });
+  }
+}
+
+static void BenchmarkFrameCapture(BenchmarkRunner &runner,
+                                  const std::string &bundle) {
+  const size_t width = 800;
+  const size_t height = 480;
+  const size_t row_bytes = width * 4;
+
+  // Mostly flat UI with a gradient header and some text-like noise.
+  std::vector<uint8_t> pixels(row_bytes * height, 0xf0);
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      auto pixel = pixels.data() + y * row_bytes + x * 4;
+      if (y < 64) {
+        pixel[0] = 0x80 + y;
+        pixel[1] = 0x40 + x / 8;
+        pixel[2] = 0x20;
+      } else if (y % 24 < 12 && x % 7 < 3) {
+        pixel[0] = pixel[1] = pixel[2] = (x * 13 + y * 7) & 0xff;
+      }
+      pixel[3] = 0xff;
+    }
+  }
+
+  FrameCapture::Frame frame;
+  frame.pixels = pixels.data();
+  frame.width = width;
+  frame.height = height;
+  frame.format = PixelFormat::kBGRA8888;
+  std::vector<uint8_t> encoded;
+  runner.Run("QOIEncode", 100, [&](size_t iterations, std::string &note) {
+    size_t size = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+      size = EncodeQOI(frame, encoded);
+    }
+    note = std::to_string(size / 1024) + " KiB per frame";
+  });
+
+  // The raster thread's share of capturing with the software renderer. The
+  // encoder keeps up or frames are skipped.
+  EventLoop loop;
+  FramebufferDisplay display(width, height, PixelFormat::kBGRA8888);
+  FrameCapture capture("/dev/null", 0);
+  display.SetFrameCapture(&capture);
+  FlutterApplication application(bundle, {bundle}, display, loop);
+  auto config = FlutterEngineStubGetRendererConfig();
+  auto user_data = FlutterEngineStubGetUserData();
+  runner.Run("SoftwarePresentCaptured", 1000,
+             [&](size_t iterations, std::string &) {
+               for (size_t i = 0; i < iterations; ++i) {
+                 pixels[(i % height) * row_bytes] = i;
+                 config->software.surface_present_callback(
+                     user_data, pixels.data(), row_bytes, height);
+               }
+             });
+}
+
+static void BenchmarkTaskDispatch(BenchmarkRunner &runner,
+                                  const std::string &bundle) {
+  EventLoop loop;
+  NullRenderDelegate delegate;
+  FlutterApplication application(bundle, {bundle}, delegate, loop);
+
+  struct State {
+    EventLoop *loop;
+    Histogram latency;
+    size_t remaining = 0;
+  } state;
+  state.loop = &loop;
+
+  // Each task carries the time it was posted.
+  FlutterEngineStubSetTaskCallback(
+      [](uint64_t posted, void *user_data) {
+        auto state = reinterpret_cast<State *>(user_data);
+        state->latency.Record((GetMonotonicTimeNanos() - posted) / 1000);
+        if (--state->remaining == 0) {
+          state->loop->Terminate();
+        }
+      },
+      &state);
+
+  runner.Run("PlatformTaskDispatch", 100000,
+             [&](size_t iterations, std::string &note) {
+               state.remaining = iterations;
+               std::thread poster([iterations]() {
+                 for (size_t i = 0; i < iterations; ++i) {
+                   FlutterEngineStubPostPlatformTask(GetMonotonicTimeNanos(),
+                                                     0 /* now */);
+                 }
+               });
+               loop.Run();
+               poster.join();
+               note = "post to run latency " +
+                      FormatSummary(state.latency.TakeSummary());
+             });
+
+  // Tasks due in the future must run on time and not early.
+  runner.Run("PlatformTaskDeadline", 200,
+             [&](size_t iterations, std::string &note) {
+               state.remaining = iterations;
+               const auto now = GetMonotonicTimeNanos();
+               for (size_t i = 0; i < iterations; ++i) {
+                 // Target times spread over the next 200ms. Lateness is
+                 // measured from the target time.
+                 const auto target = now + (i + 1) * 1000000ull;
+                 FlutterEngineStubPostPlatformTask(target, target);
+               }
+               loop.Run();
+               note = "lateness " + FormatSummary(state.latency.TakeSummary());
+             });
+
+  FlutterEngineStubSetTaskCallback(nullptr, nullptr);
+}
+
+static void BenchmarkPlatformMessages(BenchmarkRunner &runner,
+                                      const std::string &bundle) {
+  EventLoop loop;
+  NullRenderDelegate delegate;
+  FlutterApplication application(bundle, {bundle}, delegate, loop);
+  auto &dispatcher = application.GetPlatformMessageDispatcher();
+
+  // A method call carrying one sensor sample, as a plugin would receive it.
+  StandardMessageWriter call;
+  call.WriteString("sample");
+  call.BeginMap(2);
+  call.WriteString("timestamp");
+  call.WriteInt(GetMonotonicTimeNanos());
+  call.WriteString("values");
+  const double values[] = {0.1, -9.81, 0.02};
+  call.WriteFloat64List(values, 3);
+
+  Arena arena;
+  StandardMessageWriter reply;
+  double sum = 0.0;
+  dispatcher.SetHandler(
+      "benchmark/sensor",
+      [&](const uint8_t *message, size_t size,
+          PlatformMessageResponse response) {
+        StandardMethodCall method_call;
+        if (!DecodeStandardMethodCall(message, size, arena, method_call)) {
+          return;
+        }
+        auto samples = method_call.arguments->Find("values");
+        if (samples != nullptr &&
+            samples->type == StandardValueType::kFloat64List) {
+          for (size_t i = 0; i < samples->size; ++i) {
+            sum += samples->float64_list[i];
+          }
+        }
+        reply.Clear();
+        reply.BeginSuccessEnvelope();
+        reply.WriteBool(true);
+        response.Send(reply.GetData(), reply.GetSize());
+        arena.Reset();
+      });
+
+  // The message is copied into a malloc'd buffer like the engine's.
+  std::vector<uint8_t> message(call.GetData(),
+                               call.GetData() + call.GetSize());
+  runner.Run("PlatformMessageDecode", 1000000,
+             [&](size_t iterations, std::string &note) {
+               FlutterEngineStubResetCounters();
+               for (size_t i = 0; i < iterations; ++i) {
+                 FlutterEngineStubDispatchPlatformMessage(
+                     "benchmark/sensor", message.data(), message.size(),
+                     true /* expects_response */);
+               }
+               note = std::to_string(
+                          FlutterEngineStubGetPlatformMessageResponseCount()) +
+                      " responses";
+               if (sum == 0.0) {
+                 FLWAY_ERROR << "Sensor samples were not decoded."
+                             << std::endl;
+               }
+             });
+
+  StandardMessageWriter sample;
+  runner.Run("PlatformMessageSend", 1000000,
+             [&](size_t iterations, std::string &note) {
+               FlutterEngineStubResetCounters();
+               for (size_t i = 0; i < iterations; ++i) {
+                 sample.Clear();
+                 sample.BeginList(2);
+                 sample.WriteInt(i);
+                 sample.WriteFloat64List(values, 3);
+                 dispatcher.Send("benchmark/sensor", sample.GetData(),
+                                 sample.GetSize());
+               }
+               note = std::to_string(
+                          FlutterEngineStubGetPlatformMessageCount()) +
+                      " messages";
+             });
+
+  dispatcher.SetHandler("benchmark/sensor", nullptr);
+}
+
+static bool Main(std::vector<std::string> args) {
+  const auto bundle = PrepareBundle();
+  if (bundle.empty()) {
+    FLWAY_ERROR << "Could not prepare the benchmark bundle." << std::endl;
+    return false;
+  }
+
+  BenchmarkRunner runner(args.empty() ? "" : args[0]);
+  BenchmarkStartup(runner, bundle);
+  BenchmarkPointerEvents(runner);
+  BenchmarkKeyEvents(runner, bundle);
+  BenchmarkPresent(runner, bundle);
+  BenchmarkFrameCapture(runner, bundle);
+  BenchmarkTaskDispatch(runner, bundle);
+  BenchmarkPlatformMessages(runner, bundle);
+  RemoveBundle(bundle);
+  return true;
+}
+
+} // namespace flutter
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    args.push_back(argv[i]);
+  }
+  return flutter::Main(std::move(args)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
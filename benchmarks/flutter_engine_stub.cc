@@ -0,0 +1,319 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter_engine_stub.h"
+
+#include <time.h>
+
+#include <atomic>
+
+#define FLUTTER_STUB_EXPORT extern "C" __attribute__((visibility("default")))
+
+struct _FlutterEngine {
+  FlutterRendererConfig config = {};
+  FlutterTaskRunnerDescription platform_task_runner = {};
+  bool has_platform_task_runner = false;
+  VsyncCallback vsync_callback = nullptr;
+  FlutterPlatformMessageCallback platform_message_callback = nullptr;
+  void *user_data = nullptr;
+};
+
+struct _FlutterTaskRunner {};
+
+struct _FlutterPlatformMessageResponseHandle {
+  FlutterDataCallback callback = nullptr;
+  void *user_data = nullptr;
+};
+
+static _FlutterEngine gEngine;
+static _FlutterTaskRunner gPlatformTaskRunner;
+static bool gEngineRunning = false;
+
+static FlutterEngineStubTaskCallback gTaskCallback = nullptr;
+static void *gTaskCallbackUserData = nullptr;
+
+static std::atomic<size_t> gPointerEventCount{0};
+static std::atomic<size_t> gPointerEventCallCount{0};
+static std::atomic<size_t> gVsyncCount{0};
+static std::atomic<size_t> gPlatformMessageCount{0};
+static std::atomic<size_t> gPlatformMessageResponseCount{0};
+static std::atomic<size_t> gExternalTextureFrameCount{0};
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineRun(size_t version, const FlutterRendererConfig *config,
+                 const FlutterProjectArgs *args, void *user_data,
+                 FlutterEngine *engine_out) {
+  if (version != FLUTTER_ENGINE_VERSION || config == nullptr ||
+      args == nullptr || engine_out == nullptr) {
+    return kInvalidArguments;
+  }
+
+  if (gEngineRunning) {
+    return kInternalInconsistency;
+  }
+
+  gEngine = _FlutterEngine{};
+  gEngine.config = *config;
+  gEngine.user_data = user_data;
+  gEngine.vsync_callback = args->vsync_callback;
+  gEngine.platform_message_callback = args->platform_message_callback;
+  if (args->custom_task_runners != nullptr &&
+      args->custom_task_runners->platform_task_runner != nullptr) {
+    gEngine.platform_task_runner =
+        *args->custom_task_runners->platform_task_runner;
+    gEngine.has_platform_task_runner = true;
+  }
+
+  gEngineRunning = true;
+  *engine_out = &gEngine;
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineShutdown(FlutterEngine engine) {
+  if (engine != &gEngine || !gEngineRunning) {
+    return kInvalidArguments;
+  }
+  gEngineRunning = false;
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult FlutterEngineSendWindowMetricsEvent(
+    FlutterEngine engine, const FlutterWindowMetricsEvent *event) {
+  return engine == &gEngine && event != nullptr ? kSuccess : kInvalidArguments;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult FlutterEngineSendPointerEvent(
+    FlutterEngine engine, const FlutterPointerEvent *events,
+    size_t events_count) {
+  if (engine != &gEngine || events == nullptr) {
+    return kInvalidArguments;
+  }
+  gPointerEventCount.fetch_add(events_count, std::memory_order_relaxed);
+  gPointerEventCallCount.fetch_add(1, std::memory_order_relaxed);
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineOnVsync(FlutterEngine engine, intptr_t baton,
+                     uint64_t frame_start_time_nanos,
+                     uint64_t frame_target_time_nanos) {
+  if (engine != &gEngine) {
+    return kInvalidArguments;
+  }
+  gVsyncCount.fetch_add(1, std::memory_order_relaxed);
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT uint64_t FlutterEngineGetCurrentTime() {
+  timespec time = {};
+  ::clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineRunTask(FlutterEngine engine, const FlutterTask *task) {
+  if (engine != &gEngine || task == nullptr) {
+    return kInvalidArguments;
+  }
+  if (gTaskCallback != nullptr) {
+    gTaskCallback(task->task, gTaskCallbackUserData);
+  }
+  return kSuccess;
+}
+
+// Messages sent to Dart code are counted and dropped. Messages that expect a
+// reply are answered with an empty one right away.
+FLUTTER_STUB_EXPORT FlutterEngineResult FlutterEngineSendPlatformMessage(
+    FlutterEngine engine, const FlutterPlatformMessage *message) {
+  if (engine != &gEngine || message == nullptr ||
+      message->channel == nullptr) {
+    return kInvalidArguments;
+  }
+  gPlatformMessageCount.fetch_add(1, std::memory_order_relaxed);
+  auto handle = message->response_handle;
+  if (handle != nullptr && handle->callback != nullptr) {
+    handle->callback(nullptr, 0, handle->user_data);
+  }
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterPlatformMessageCreateResponseHandle(
+    FlutterEngine engine, FlutterDataCallback data_callback, void *user_data,
+    FlutterPlatformMessageResponseHandle **response_out) {
+  if (engine != &gEngine || data_callback == nullptr ||
+      response_out == nullptr) {
+    return kInvalidArguments;
+  }
+  auto handle = new _FlutterPlatformMessageResponseHandle();
+  handle->callback = data_callback;
+  handle->user_data = user_data;
+  *response_out = handle;
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterPlatformMessageReleaseResponseHandle(
+    FlutterEngine engine, FlutterPlatformMessageResponseHandle *response) {
+  if (engine != &gEngine || response == nullptr) {
+    return kInvalidArguments;
+  }
+  delete response;
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineSendPlatformMessageResponse(
+    FlutterEngine engine, const FlutterPlatformMessageResponseHandle *handle,
+    const uint8_t *data, size_t data_length) {
+  if (engine != &gEngine || handle == nullptr) {
+    return kInvalidArguments;
+  }
+  gPlatformMessageResponseCount.fetch_add(1, std::memory_order_relaxed);
+  delete handle;
+  return kSuccess;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineRegisterExternalTexture(FlutterEngine engine,
+                                     int64_t texture_identifier) {
+  return engine == &gEngine ? kSuccess : kInvalidArguments;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineUnregisterExternalTexture(FlutterEngine engine,
+                                       int64_t texture_identifier) {
+  return engine == &gEngine ? kSuccess : kInvalidArguments;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineMarkExternalTextureFrameAvailable(FlutterEngine engine,
+                                               int64_t texture_identifier) {
+  if (engine != &gEngine) {
+    return kInvalidArguments;
+  }
+  gExternalTextureFrameCount.fetch_add(1, std::memory_order_relaxed);
+  return kSuccess;
+}
+
+// The stub behaves like a debug engine and runs kernel blobs.
+FLUTTER_STUB_EXPORT bool FlutterEngineRunsAOTCompiledDartCode(void) {
+  return false;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineCreateAOTData(const FlutterEngineAOTDataSource *source,
+                           FlutterEngineAOTData *data_out) {
+  return kInvalidArguments;
+}
+
+FLUTTER_STUB_EXPORT FlutterEngineResult
+FlutterEngineCollectAOTData(FlutterEngineAOTData data) {
+  return kInvalidArguments;
+}
+
+FLUTTER_STUB_EXPORT const FlutterRendererConfig *
+FlutterEngineStubGetRendererConfig(void) {
+  return gEngineRunning ? &gEngine.config : nullptr;
+}
+
+FLUTTER_STUB_EXPORT const FlutterTaskRunnerDescription *
+FlutterEngineStubGetPlatformTaskRunner(void) {
+  return gEngineRunning && gEngine.has_platform_task_runner
+             ? &gEngine.platform_task_runner
+             : nullptr;
+}
+
+FLUTTER_STUB_EXPORT VsyncCallback FlutterEngineStubGetVsyncCallback(void) {
+  return gEngineRunning ? gEngine.vsync_callback : nullptr;
+}
+
+FLUTTER_STUB_EXPORT void *FlutterEngineStubGetUserData(void) {
+  return gEngineRunning ? gEngine.user_data : nullptr;
+}
+
+FLUTTER_STUB_EXPORT void
+FlutterEngineStubPostPlatformTask(uint64_t task, uint64_t target_time_nanos) {
+  auto runner = FlutterEngineStubGetPlatformTaskRunner();
+  if (runner == nullptr) {
+    return;
+  }
+  FlutterTask engine_task = {};
+  engine_task.runner = &gPlatformTaskRunner;
+  engine_task.task = task;
+  runner->post_task_callback(engine_task, target_time_nanos,
+                             runner->user_data);
+}
+
+FLUTTER_STUB_EXPORT void
+FlutterEngineStubSetTaskCallback(FlutterEngineStubTaskCallback callback,
+                                 void *user_data) {
+  gTaskCallback = callback;
+  gTaskCallbackUserData = user_data;
+}
+
+FLUTTER_STUB_EXPORT void FlutterEngineStubDispatchPlatformMessage(
+    const char *channel, const uint8_t *message, size_t message_size,
+    bool expects_response) {
+  if (!gEngineRunning || gEngine.platform_message_callback == nullptr) {
+    return;
+  }
+  FlutterPlatformMessage platform_message = {};
+  platform_message.struct_size = sizeof(FlutterPlatformMessage);
+  platform_message.channel = channel;
+  platform_message.message = message;
+  platform_message.message_size = message_size;
+  // Responses from the embedder go nowhere.
+  if (expects_response) {
+    platform_message.response_handle =
+        new _FlutterPlatformMessageResponseHandle();
+  }
+  gEngine.platform_message_callback(&platform_message, gEngine.user_data);
+}
+
+FLUTTER_STUB_EXPORT bool
+FlutterEngineStubPopulateExternalTexture(int64_t texture_id,
+                                         FlutterOpenGLTexture *texture) {
+  if (!gEngineRunning || gEngine.config.type != kOpenGL ||
+      gEngine.config.open_gl.gl_external_texture_frame_callback == nullptr) {
+    return false;
+  }
+  return gEngine.config.open_gl.gl_external_texture_frame_callback(
+      gEngine.user_data, texture_id, 0, 0, texture);
+}
+
+FLUTTER_STUB_EXPORT size_t FlutterEngineStubGetPointerEventCount(void) {
+  return gPointerEventCount.load();
+}
+
+FLUTTER_STUB_EXPORT size_t FlutterEngineStubGetPointerEventCallCount(void) {
+  return gPointerEventCallCount.load();
+}
+
+FLUTTER_STUB_EXPORT size_t FlutterEngineStubGetVsyncCount(void) {
+  return gVsyncCount.load();
+}
+
+FLUTTER_STUB_EXPORT size_t FlutterEngineStubGetPlatformMessageCount(void) {
+  return gPlatformMessageCount.load();
+}
+
+FLUTTER_STUB_EXPORT size_t
+FlutterEngineStubGetPlatformMessageResponseCount(void) {
+  return gPlatformMessageResponseCount.load();
+}
+
+FLUTTER_STUB_EXPORT size_t FlutterEngineStubGetExternalTextureFrameCount(void) {
+  return gExternalTextureFrameCount.load();
+}
+
+FLUTTER_STUB_EXPORT void FlutterEngineStubResetCounters(void) {
+  gPointerEventCount = 0;
+  gPointerEventCallCount = 0;
+  gVsyncCount = 0;
+  gPlatformMessageCount = 0;
+  gPlatformMessageResponseCount = 0;
+  gExternalTextureFrameCount = 0;
+}
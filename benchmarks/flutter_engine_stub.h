@@ -0,0 +1,74 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+// A stand-in for libflutter_engine.so that implements the embedder API
+// entry points the embedder uses and records how they were called. It does
+// no rendering and runs no Dart code. These hooks let benchmarks drive the
+// callbacks the real engine would invoke.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*FlutterEngineStubTaskCallback)(uint64_t task, void *user_data);
+
+// The renderer config passed to the last successful |FlutterEngineRun|.
+const FlutterRendererConfig *FlutterEngineStubGetRendererConfig(void);
+
+// The platform task runner passed to the last successful |FlutterEngineRun| or
+// NULL if none was provided.
+const FlutterTaskRunnerDescription *
+FlutterEngineStubGetPlatformTaskRunner(void);
+
+// The vsync callback passed to the last successful |FlutterEngineRun|.
+VsyncCallback FlutterEngineStubGetVsyncCallback(void);
+
+// The user data passed to the last successful |FlutterEngineRun|.
+void *FlutterEngineStubGetUserData(void);
+
+// Posts a task to the platform task runner the way the engine would. The
+// |task| value is handed to the task callback when the embedder runs it.
+void FlutterEngineStubPostPlatformTask(uint64_t task,
+                                       uint64_t target_time_nanos);
+
+// Invoked from |FlutterEngineRunTask|.
+void FlutterEngineStubSetTaskCallback(FlutterEngineStubTaskCallback callback,
+                                      void *user_data);
+
+// Delivers a message to the platform message callback passed to the last
+// successful |FlutterEngineRun| as if it came from Dart code. Messages that
+// expect a response carry a handle the embedder must respond to.
+void FlutterEngineStubDispatchPlatformMessage(const char *channel,
+                                              const uint8_t *message,
+                                              size_t message_size,
+                                              bool expects_response);
+
+// Asks the embedder for the latest frame of an external texture the way the
+// engine does when drawing it. Returns false if there was none. The texture
+// is returned to the embedder through its destruction callback.
+bool FlutterEngineStubPopulateExternalTexture(int64_t texture_id,
+                                              FlutterOpenGLTexture *texture);
+
+// Counters. Reset by |FlutterEngineStubResetCounters|.
+size_t FlutterEngineStubGetPointerEventCount(void);
+
+size_t FlutterEngineStubGetPointerEventCallCount(void);
+
+size_t FlutterEngineStubGetVsyncCount(void);
+
+size_t FlutterEngineStubGetPlatformMessageCount(void);
+
+size_t FlutterEngineStubGetPlatformMessageResponseCount(void);
+
+size_t FlutterEngineStubGetExternalTextureFrameCount(void);
+
+void FlutterEngineStubResetCounters(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace flutter {
+
+Arena::Arena(size_t block_size) : block_size_(block_size) {}
+
+Arena::~Arena() = default;
+
+void *Arena::Allocate(size_t size, size_t alignment) {
+  while (current_block_ < blocks_.size()) {
+    auto &block = blocks_[current_block_];
+    const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+    const size_t aligned =
+        ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+    if (aligned + size <= block.size) {
+      offset_ = aligned + size;
+      return block.data.get() + aligned;
+    }
+    // Whatever is left in this block is wasted until the next reset.
+    current_block_++;
+    offset_ = 0;
+  }
+
+  Block block;
+  block.size = std::max(block_size_, size + alignment);
+  block.data.reset(new (std::nothrow) uint8_t[block.size]);
+  if (!block.data) {
+    return nullptr;
+  }
+  blocks_.push_back(std::move(block));
+  current_block_ = blocks_.size() - 1;
+  return Allocate(size, alignment);
+}
+
+void Arena::Reset() {
+  current_block_ = 0;
+  offset_ = 0;
+}
+
+} // namespace flutter
@@ -0,0 +1,54 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A bump allocator for short lived objects that are all freed at once. Blocks
+// are kept across resets so that a steady state workload doesn't touch the
+// heap. Destructors of objects placed in the arena are not run.
+class Arena {
+public:
+  explicit Arena(size_t block_size = 4096);
+
+  ~Arena();
+
+  // Returns null only if the system is out of memory.
+  void *Allocate(size_t size, size_t alignment);
+
+  // Also returns null if the array's size doesn't fit in a size_t.
+  template <typename T> T *AllocateArray(size_t count) {
+    if (count > SIZE_MAX / sizeof(T)) {
+      return nullptr;
+    }
+    return reinterpret_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  // Frees everything allocated so far.
+  void Reset();
+
+private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+  };
+
+  const size_t block_size_;
+  std::vector<Block> blocks_;
+  size_t current_block_ = 0;
+  size_t offset_ = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+} // namespace flutter
@@ -0,0 +1,87 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "asset_preloader.h"
+
+#include "utils.h"
+
+namespace flutter {
+
+// Files in the bundle that the engine reads before the first frame. Those that
+// don't exist (AOT snapshots in a JIT bundle and vice versa) are skipped by
+// the worker that looks for them.
+static const char *kBundleFileNames[] = {
+    kKernelBlobFileName,
+    kVMSnapshotDataFileName,
+    kVMSnapshotInstructionsFileName,
+    kIsolateSnapshotDataFileName,
+    kIsolateSnapshotInstructionsFileName,
+    kAppELFFileName,
+    "AssetManifest.json",
+    "FontManifest.json",
+};
+
+AssetPreloader::AssetPreloader(std::string bundle_path,
+                               std::string icu_data_path,
+                               StartupTimeline &timeline)
+    : timeline_(timeline) {
+  // Validation only touches directory entries but those may be cold too.
+  workers_.emplace_back([this, bundle_path]() {
+    const auto begin = GetMonotonicTimeNanos();
+    bundle_valid_ = FlutterAssetBundleIsValid(bundle_path);
+    timeline_.AddPhase("validate bundle", begin, GetMonotonicTimeNanos());
+  });
+
+  if (!icu_data_path.empty()) {
+    paths_.push_back(std::move(icu_data_path));
+  }
+  for (const auto name : kBundleFileNames) {
+    paths_.push_back(bundle_path + "/" + name);
+  }
+
+  // Each file is read by its own thread so that the storage device sees
+  // concurrent requests.
+  files_.resize(paths_.size());
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    workers_.emplace_back([this, i]() { Load(i); });
+  }
+}
+
+AssetPreloader::~AssetPreloader() { Wait(); }
+
+void AssetPreloader::Load(size_t index) {
+  const auto begin = GetMonotonicTimeNanos();
+  if (!FileExistsAtPath(paths_[index])) {
+    return;
+  }
+  auto file = std::make_unique<MappedFile>(paths_[index]);
+  if (!file->IsValid()) {
+    return;
+  }
+  file->Prefetch();
+  timeline_.AddPhase("load " + paths_[index] + " (" +
+                         std::to_string(file->GetSize() / 1024) + " KiB)",
+                     begin, GetMonotonicTimeNanos());
+  files_[index] = std::move(file);
+}
+
+bool AssetPreloader::Wait() {
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+  return bundle_valid_;
+}
+
+const MappedFile *AssetPreloader::GetMappedFile(
+    const std::string &path) const {
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    if (paths_[i] == path) {
+      return files_[i].get();
+    }
+  }
+  return nullptr;
+}
+
+} // namespace flutter
@@ -0,0 +1,52 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "macros.h"
+#include "mapped_file.h"
+#include "startup_timeline.h"
+
+namespace flutter {
+
+// Validates an asset bundle and maps the files the engine reads at launch on
+// background threads, faulting them into the page cache. This lets slow
+// storage be read while the display is brought up on the main thread, and
+// with more than one request in flight.
+class AssetPreloader {
+public:
+  // Work starts immediately. Each file is timed on |timeline|, which must
+  // outlive the preloader.
+  AssetPreloader(std::string bundle_path, std::string icu_data_path,
+                 StartupTimeline &timeline);
+
+  // Waits for outstanding work. Mappings are released.
+  ~AssetPreloader();
+
+  // Blocks until every file has been loaded. Returns whether the bundle was
+  // valid. Must be called on the thread that created the preloader.
+  bool Wait();
+
+  // The mapping of |path| if it was one of the files preloaded, or null. Only
+  // valid after |Wait|.
+  const MappedFile *GetMappedFile(const std::string &path) const;
+
+private:
+  StartupTimeline &timeline_;
+  std::vector<std::string> paths_;
+  std::vector<std::unique_ptr<MappedFile>> files_;
+  std::vector<std::thread> workers_;
+  bool bundle_valid_ = false;
+
+  void Load(size_t index);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(AssetPreloader);
+};
+
+} // namespace flutter
@@ -0,0 +1,111 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cursor.h"
+
+#include <math.h>
+
+#include <vector>
+
+#include "utils.h"
+
+namespace flutter {
+
+// An arrow with its hot spot at the top left. 'X' is the outline and '.' the
+// fill.
+static const char *const kArrow[] = {
+    "X           ", //
+    "XX          ", //
+    "X.X         ", //
+    "X..X        ", //
+    "X...X       ", //
+    "X....X      ", //
+    "X.....X     ", //
+    "X......X    ", //
+    "X.......X   ", //
+    "X........X  ", //
+    "X.........X ", //
+    "X..........X", //
+    "X......XXXXX", //
+    "X...X..X    ", //
+    "X..XX..X    ", //
+    "X.X  X..X   ", //
+    "XX   X..X   ", //
+    "X     X..X  ", //
+    "      X..X  ", //
+    "       XX   ", //
+};
+
+static const size_t kArrowWidth = 12;
+static const size_t kArrowHeight = sizeof(kArrow) / sizeof(kArrow[0]);
+
+Cursor::Cursor(PlaneAllocator &planes, double x, double y)
+    : planes_(planes), x_(x), y_(y) {
+  plane_ = planes_.AllocatePlane(PlaneKind::kCursor, kArrowWidth, kArrowHeight);
+  if (!plane_) {
+    FLWAY_ERROR << "Could not allocate a cursor plane." << std::endl;
+    return;
+  }
+
+  std::vector<uint8_t> pixels(kArrowWidth * kArrowHeight * 4);
+  for (size_t y = 0; y < kArrowHeight; ++y) {
+    for (size_t x = 0; x < kArrowWidth; ++x) {
+      const char pixel = kArrow[y][x];
+      if (pixel == ' ') {
+        continue;
+      }
+      const uint8_t value = pixel == '.' ? 255 : 0;
+      uint8_t *destination = pixels.data() + (y * kArrowWidth + x) * 4;
+      destination[0] = value;
+      destination[1] = value;
+      destination[2] = value;
+      destination[3] = 255;
+    }
+  }
+  if (!plane_->SetContents(pixels.data(), kArrowWidth * 4)) {
+    plane_.reset();
+  }
+}
+
+Cursor::~Cursor() = default;
+
+bool Cursor::IsValid() const { return plane_ != nullptr; }
+
+// |InputReader::Delegate|
+void Cursor::OnInputPointerEvents(const FlutterPointerEvent *events,
+                                  size_t count) {
+  if (!plane_) {
+    return;
+  }
+
+  // Only where the last event of a report left the pointer is shown.
+  int32_t x = position_x_;
+  int32_t y = position_y_;
+  bool visible = visible_;
+  for (size_t i = 0; i < count; ++i) {
+    const auto &event = events[i];
+    if (event.phase == kAdd || event.phase == kRemove) {
+      continue;
+    }
+    if (event.device_kind != kFlutterPointerDeviceKindMouse) {
+      visible = false;
+      continue;
+    }
+    visible = true;
+    x = ::lround(event.x - x_);
+    y = ::lround(event.y - y_);
+  }
+
+  if (x == position_x_ && y == position_y_ && visible == visible_) {
+    return;
+  }
+  position_x_ = x;
+  position_y_ = y;
+  visible_ = visible;
+  plane_->SetPosition(x, y);
+  plane_->SetVisible(visible);
+  planes_.Commit();
+}
+
+} // namespace flutter
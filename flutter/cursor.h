@@ -0,0 +1,44 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <memory>
+
+#include "input_reader.h"
+#include "macros.h"
+#include "planes.h"
+
+namespace flutter {
+
+// Draws the mouse pointer on a cursor plane as the input thread reads mouse
+// events, so that moving it costs the application no frame. Touches hide it.
+class Cursor : public InputReader::Delegate {
+public:
+  // |x|, |y| is where the display's area is in the space of the events.
+  Cursor(PlaneAllocator &planes, double x, double y);
+
+  ~Cursor() override;
+
+  bool IsValid() const;
+
+  // |InputReader::Delegate|
+  void OnInputPointerEvents(const FlutterPointerEvent *events,
+                            size_t count) override;
+
+private:
+  PlaneAllocator &planes_;
+  const double x_;
+  const double y_;
+  std::unique_ptr<Plane> plane_;
+  int32_t position_x_ = 0;
+  int32_t position_y_ = 0;
+  bool visible_ = false;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Cursor);
+};
+
+} // namespace flutter
@@ -0,0 +1,190 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "damage_tracker.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FLWAY_CHECKSUM_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FLWAY_CHECKSUM_SSE2 1
+#endif
+
+namespace flutter {
+
+// Swap chains are rarely deeper than this.
+static const size_t kMaxDamageHistory = 4;
+
+// std::min takes its arguments by reference.
+const size_t TileDamageTracker::kTileSize;
+
+DamageRect DamageRect::Union(const DamageRect &other) const {
+  if (IsEmpty()) {
+    return other;
+  }
+  if (other.IsEmpty()) {
+    return *this;
+  }
+  DamageRect result;
+  result.x = std::min(x, other.x);
+  result.y = std::min(y, other.y);
+  result.width = std::max(x + width, other.x + other.width) - result.x;
+  result.height = std::max(y + height, other.y + other.height) - result.y;
+  return result;
+}
+
+// A Fletcher style checksum over four 32 bit lanes. The second sum weighs each
+// word by its position, so unlike a plain sum it notices pixels that move.
+static uint64_t ChecksumTile(const uint8_t *origin, size_t row_bytes,
+                             size_t width, size_t height) {
+  uint32_t sum[4] = {1, 1, 1, 1};
+  uint32_t weighted[4] = {0, 0, 0, 0};
+
+  for (size_t y = 0; y < height; ++y) {
+    const uint8_t *row = origin + y * row_bytes;
+    size_t x = 0;
+#if FLWAY_CHECKSUM_NEON
+    uint32x4_t sum_lanes = vld1q_u32(sum);
+    uint32x4_t weighted_lanes = vld1q_u32(weighted);
+    for (; x + 4 <= width; x += 4) {
+      const uint32x4_t pixels = vreinterpretq_u32_u8(vld1q_u8(row + x * 4));
+      sum_lanes = vaddq_u32(sum_lanes, pixels);
+      weighted_lanes = vaddq_u32(weighted_lanes, sum_lanes);
+    }
+    vst1q_u32(sum, sum_lanes);
+    vst1q_u32(weighted, weighted_lanes);
+#elif FLWAY_CHECKSUM_SSE2
+    __m128i sum_lanes = _mm_loadu_si128(reinterpret_cast<__m128i *>(sum));
+    __m128i weighted_lanes =
+        _mm_loadu_si128(reinterpret_cast<__m128i *>(weighted));
+    for (; x + 4 <= width; x += 4) {
+      const __m128i pixels =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x * 4));
+      sum_lanes = _mm_add_epi32(sum_lanes, pixels);
+      weighted_lanes = _mm_add_epi32(weighted_lanes, sum_lanes);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sum), sum_lanes);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(weighted), weighted_lanes);
+#endif
+    for (; x < width; ++x) {
+      uint32_t pixel = 0;
+      memcpy(&pixel, row + x * 4, sizeof(pixel));
+      sum[x & 3] += pixel;
+      weighted[x & 3] += sum[x & 3];
+    }
+  }
+
+  // FNV-1a over the lanes.
+  uint64_t checksum = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < 4; ++i) {
+    checksum = (checksum ^ sum[i]) * 0x100000001b3ull;
+    checksum = (checksum ^ weighted[i]) * 0x100000001b3ull;
+  }
+  return checksum;
+}
+
+TileDamageTracker::TileDamageTracker() = default;
+
+TileDamageTracker::~TileDamageTracker() = default;
+
+const std::vector<DamageRect> &
+TileDamageTracker::Update(const void *pixels, size_t row_bytes, size_t width,
+                          size_t height) {
+  const size_t columns = (width + kTileSize - 1) / kTileSize;
+  const size_t rows = (height + kTileSize - 1) / kTileSize;
+
+  if (width != width_ || height != height_) {
+    width_ = width;
+    height_ = height;
+    checksums_.assign(columns * rows, 0);
+    invalidated_ = true;
+  }
+
+  damage_.clear();
+  damaged_tile_count_ = 0;
+
+  auto origin = reinterpret_cast<const uint8_t *>(pixels);
+  for (size_t row = 0; row < rows; ++row) {
+    const size_t y = row * kTileSize;
+    const size_t tile_height = std::min(kTileSize, height - y);
+
+    // The first column of the current run of damaged tiles.
+    size_t run_start = columns;
+    for (size_t column = 0; column <= columns; ++column) {
+      bool damaged = false;
+      if (column < columns) {
+        const size_t x = column * kTileSize;
+        const auto checksum =
+            ChecksumTile(origin + y * row_bytes + x * 4, row_bytes,
+                         std::min(kTileSize, width - x), tile_height);
+        auto &last_checksum = checksums_[row * columns + column];
+        damaged = invalidated_ || checksum != last_checksum;
+        last_checksum = checksum;
+      }
+
+      if (damaged) {
+        damaged_tile_count_++;
+        if (run_start == columns) {
+          run_start = column;
+        }
+      } else if (run_start != columns) {
+        DamageRect rect;
+        rect.x = run_start * kTileSize;
+        rect.y = y;
+        rect.width = std::min(column * kTileSize, width) - rect.x;
+        rect.height = tile_height;
+        damage_.push_back(rect);
+        run_start = columns;
+      }
+    }
+  }
+
+  invalidated_ = false;
+  return damage_;
+}
+
+void TileDamageTracker::Invalidate() { invalidated_ = true; }
+
+size_t TileDamageTracker::GetTileCount() const { return checksums_.size(); }
+
+size_t TileDamageTracker::GetDamagedTileCount() const {
+  return damaged_tile_count_;
+}
+
+DamageHistory::DamageHistory() = default;
+
+DamageHistory::~DamageHistory() = default;
+
+void DamageHistory::Push(const DamageRect &damage) {
+  frames_.push_front(damage);
+  if (frames_.size() > kMaxDamageHistory) {
+    frames_.pop_back();
+  }
+}
+
+DamageRect DamageHistory::GetBufferDamage(size_t age, size_t width,
+                                          size_t height) const {
+  DamageRect full;
+  full.width = width;
+  full.height = height;
+
+  // A buffer of age N was presented N frames ago. Everything damaged in the
+  // N - 1 frames presented since is out of date in it.
+  if (age == 0 || age - 1 > frames_.size()) {
+    return full;
+  }
+
+  DamageRect damage;
+  for (size_t i = 0; i + 1 < age; ++i) {
+    damage = damage.Union(frames_[i]);
+  }
+  return damage;
+}
+
+} // namespace flutter
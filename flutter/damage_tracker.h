@@ -0,0 +1,89 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A rectangle in pixels with a top left origin.
+struct DamageRect {
+  size_t x = 0;
+  size_t y = 0;
+  size_t width = 0;
+  size_t height = 0;
+
+  bool IsEmpty() const { return width == 0 || height == 0; }
+
+  // The smallest rectangle containing both.
+  DamageRect Union(const DamageRect &other) const;
+};
+
+// Finds the parts of successive 32 bits per pixel frames that changed by
+// comparing checksums of fixed size tiles. Only the checksums are kept, not
+// the frames.
+class TileDamageTracker {
+public:
+  static const size_t kTileSize = 64;
+
+  TileDamageTracker();
+
+  ~TileDamageTracker();
+
+  // Returns rectangles covering the tiles that differ from the last frame.
+  // Runs of changed tiles in a row of tiles are merged. All of the frame is
+  // damaged the first time and whenever the size changes.
+  const std::vector<DamageRect> &Update(const void *pixels, size_t row_bytes,
+                                        size_t width, size_t height);
+
+  // Forgets the last frame so that all of the next one is damaged.
+  void Invalidate();
+
+  size_t GetTileCount() const;
+
+  // The number of tiles damaged by the last update.
+  size_t GetDamagedTileCount() const;
+
+private:
+  size_t width_ = 0;
+  size_t height_ = 0;
+  bool invalidated_ = true;
+  std::vector<uint64_t> checksums_;
+  std::vector<DamageRect> damage_;
+  size_t damaged_tile_count_ = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(TileDamageTracker);
+};
+
+// Remembers the damage of recently presented frames so that the out of date
+// area of a buffer last presented some number of frames ago can be found. Used
+// with EGL_EXT_buffer_age.
+class DamageHistory {
+public:
+  DamageHistory();
+
+  ~DamageHistory();
+
+  // Records the damage of a frame as it is presented.
+  void Push(const DamageRect &damage);
+
+  // The area of a buffer with the given age that is out of date. Buffers with
+  // an age of zero have undefined contents. The full surface is returned for
+  // those and for buffers older than the history.
+  DamageRect GetBufferDamage(size_t age, size_t width, size_t height) const;
+
+private:
+  std::deque<DamageRect> frames_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(DamageHistory);
+};
+
+} // namespace flutter
@@ -0,0 +1,38 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include "flutter_application.h"
+
+namespace flutter {
+
+class FrameCapture;
+class PlaneAllocator;
+
+// A render delegate backed by an output surface of a known size.
+class Display : public FlutterApplication::RenderDelegate {
+public:
+  virtual ~Display() = default;
+
+  virtual bool IsValid() const = 0;
+
+  virtual size_t GetWidth() const = 0;
+
+  virtual size_t GetHeight() const = 0;
+
+  // Hands each presented frame to |capture| until it stops taking them.
+  // Must be called before the first frame. Returns false if the display can't
+  // read its frames back.
+  virtual bool SetFrameCapture(FrameCapture *capture) { return false; }
+
+  // Planes shown with the application's frames, or null if the display has
+  // none. Must first be called before the first frame. The allocator lives as
+  // long as the display.
+  virtual PlaneAllocator *GetPlaneAllocator() { return nullptr; }
+};
+
+} // namespace flutter
@@ -0,0 +1,305 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "dispmanx_plane_allocator.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "utils.h"
+
+namespace flutter {
+
+// ELEMENT_CHANGE_DEST_RECT. Not in the public headers.
+static const uint32_t kChangeDestinationRect = 1 << 2;
+
+// Video Core transfers rows of resources 32 bytes aligned.
+static const size_t kPitchAlignment = 32;
+
+// Relative to the application's layer.
+static int32_t GetLayerOffset(PlaneKind kind) {
+  switch (kind) {
+  case PlaneKind::kBackground:
+    return -2;
+  case PlaneKind::kVideo:
+    return -1;
+  case PlaneKind::kCursor:
+    return 1;
+  }
+  return 0;
+}
+
+class DispmanxPlaneAllocator::DispmanxPlane : public Plane {
+public:
+  DispmanxPlane(DispmanxPlaneAllocator &allocator, PlaneKind kind,
+                size_t width, size_t height)
+      : allocator_(allocator),
+        layer_(allocator.layer_ + GetLayerOffset(kind)), width_(width),
+        height_(height),
+        pitch_((width * 4 + kPitchAlignment - 1) / kPitchAlignment *
+               kPitchAlignment) {
+    for (auto &resource : resources_) {
+      uint32_t image_handle = 0;
+      resource = ::vc_dispmanx_resource_create(VC_IMAGE_ARGB8888, width_,
+                                               height_, &image_handle);
+      if (resource == DISPMANX_NO_HANDLE) {
+        FLWAY_ERROR << "Could not create a " << width_ << " x " << height_
+                    << " plane resource." << std::endl;
+        return;
+      }
+    }
+    valid_ = true;
+  }
+
+  ~DispmanxPlane() override {
+    {
+      // Updates already submitted may still refer to the element.
+      std::unique_lock<std::mutex> lock(allocator_.mutex_);
+      auto &planes = allocator_.planes_;
+      planes.erase(std::remove(planes.begin(), planes.end(), this),
+                   planes.end());
+      allocator_.WaitForUpdateLocked(lock, allocator_.submitted_count_);
+    }
+
+    if (element_ != DISPMANX_NO_HANDLE) {
+      auto update = ::vc_dispmanx_update_start(0);
+      ::vc_dispmanx_element_remove(update, element_);
+      ::vc_dispmanx_update_submit_sync(update);
+    }
+
+    for (auto resource : resources_) {
+      if (resource != DISPMANX_NO_HANDLE) {
+        ::vc_dispmanx_resource_delete(resource);
+      }
+    }
+  }
+
+  bool IsValid() const { return valid_; }
+
+  // |Plane|
+  bool SetContents(const void *pixels, size_t row_bytes) override {
+    if (row_bytes < width_ * 4) {
+      FLWAY_ERROR << "Plane contents are narrower than the plane."
+                  << std::endl;
+      return false;
+    }
+
+    // Contents come from one thread at a time, so the staging buffer and
+    // the back resource are only guarded by the order of things.
+    const uint8_t *source = static_cast<const uint8_t *>(pixels);
+    if (row_bytes != pitch_) {
+      staging_.resize(pitch_ * height_);
+      for (size_t y = 0; y < height_; ++y) {
+        ::memcpy(staging_.data() + y * pitch_, source + y * row_bytes,
+                 width_ * 4);
+      }
+      source = staging_.data();
+    }
+
+    size_t back = 0;
+    {
+      // The back resource is scanned out until the update that made it so
+      // has been applied. Contents that weren't committed yet are replaced.
+      std::unique_lock<std::mutex> lock(allocator_.mutex_);
+      allocator_.WaitForUpdateLocked(lock, flip_update_);
+      contents_changed_ = false;
+      back = 1 - front_;
+    }
+
+    // Not under the lock, so that cursor moves don't wait on the transfer.
+    const VC_RECT_T rect = {0, 0, static_cast<int32_t>(width_),
+                            static_cast<int32_t>(height_)};
+    const bool written =
+        ::vc_dispmanx_resource_write_data(
+            resources_[back], VC_IMAGE_ARGB8888, pitch_,
+            const_cast<uint8_t *>(source), &rect) == 0;
+    if (!written) {
+      FLWAY_ERROR << "Could not write the contents of a plane." << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(allocator_.mutex_);
+    contents_changed_ = written;
+    return written;
+  }
+
+  // |Plane|
+  void SetPosition(int32_t x, int32_t y) override {
+    std::lock_guard<std::mutex> lock(allocator_.mutex_);
+    pending_x_ = x;
+    pending_y_ = y;
+  }
+
+  // |Plane|
+  void SetVisible(bool visible) override {
+    std::lock_guard<std::mutex> lock(allocator_.mutex_);
+    pending_visible_ = visible;
+  }
+
+private:
+  friend class DispmanxPlaneAllocator;
+
+  DispmanxPlaneAllocator &allocator_;
+  const int32_t layer_;
+  const size_t width_;
+  const size_t height_;
+  const size_t pitch_;
+  DISPMANX_RESOURCE_HANDLE_T resources_[2] = {DISPMANX_NO_HANDLE,
+                                              DISPMANX_NO_HANDLE};
+  std::vector<uint8_t> staging_;
+  bool valid_ = false;
+
+  // Guarded by the allocator's lock.
+  size_t front_ = 0;
+  bool contents_changed_ = false;
+  // The update that last swapped the resources.
+  uint64_t flip_update_ = 0;
+  int32_t pending_x_ = 0;
+  int32_t pending_y_ = 0;
+  bool pending_visible_ = false;
+  int32_t x_ = 0;
+  int32_t y_ = 0;
+  // Only exists while the plane is visible.
+  DISPMANX_ELEMENT_HANDLE_T element_ = DISPMANX_NO_HANDLE;
+
+  bool IsDirtyLocked() const {
+    return contents_changed_ || pending_x_ != x_ || pending_y_ != y_ ||
+           pending_visible_ != (element_ != DISPMANX_NO_HANDLE);
+  }
+
+  void ApplyLocked(DISPMANX_UPDATE_HANDLE_T update, uint64_t sequence) {
+    if (contents_changed_) {
+      front_ = 1 - front_;
+      contents_changed_ = false;
+      flip_update_ = sequence;
+      if (element_ != DISPMANX_NO_HANDLE) {
+        ::vc_dispmanx_element_change_source(update, element_,
+                                            resources_[front_]);
+      }
+    }
+
+    const VC_RECT_T destination = {
+        .x = allocator_.x_ + pending_x_,
+        .y = allocator_.y_ + pending_y_,
+        .width = static_cast<int32_t>(width_),
+        .height = static_cast<int32_t>(height_),
+    };
+    if (pending_visible_ && element_ == DISPMANX_NO_HANDLE) {
+      const VC_RECT_T source = {
+          .x = 0,
+          .y = 0,
+          .width = static_cast<int32_t>(width_ << 16),
+          .height = static_cast<int32_t>(height_ << 16),
+      };
+      VC_DISPMANX_ALPHA_T alpha = {
+          static_cast<DISPMANX_FLAGS_ALPHA_T>(
+              DISPMANX_FLAGS_ALPHA_FROM_SOURCE | DISPMANX_FLAGS_ALPHA_PREMULT),
+          255, 0};
+      element_ = ::vc_dispmanx_element_add(
+          update, allocator_.display_, layer_, &destination,
+          resources_[front_], &source, DISPMANX_PROTECTION_NONE, &alpha,
+          nullptr, DISPMANX_NO_ROTATE);
+    } else if (!pending_visible_ && element_ != DISPMANX_NO_HANDLE) {
+      ::vc_dispmanx_element_remove(update, element_);
+      element_ = DISPMANX_NO_HANDLE;
+    } else if (element_ != DISPMANX_NO_HANDLE &&
+               (pending_x_ != x_ || pending_y_ != y_)) {
+      ::vc_dispmanx_element_change_attributes(
+          update, element_, kChangeDestinationRect, 0, 0, &destination,
+          nullptr, DISPMANX_NO_HANDLE, DISPMANX_NO_ROTATE);
+    }
+    x_ = pending_x_;
+    y_ = pending_y_;
+  }
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(DispmanxPlane);
+};
+
+DispmanxPlaneAllocator::DispmanxPlaneAllocator(
+    DISPMANX_DISPLAY_HANDLE_T display, int32_t layer, int32_t x, int32_t y)
+    : display_(display), layer_(layer), x_(x), y_(y) {}
+
+DispmanxPlaneAllocator::~DispmanxPlaneAllocator() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  commit_pending_ = false;
+  WaitForUpdateLocked(lock, submitted_count_);
+  if (!planes_.empty()) {
+    FLWAY_ERROR << "Planes outlived their allocator." << std::endl;
+  }
+}
+
+// |PlaneAllocator|
+std::unique_ptr<Plane> DispmanxPlaneAllocator::AllocatePlane(PlaneKind kind,
+                                                             size_t width,
+                                                             size_t height) {
+  if (width == 0 || height == 0) {
+    return nullptr;
+  }
+  auto plane = std::make_unique<DispmanxPlane>(*this, kind, width, height);
+  if (!plane->IsValid()) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  planes_.push_back(plane.get());
+  return plane;
+}
+
+// |PlaneAllocator|
+void DispmanxPlaneAllocator::Commit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (applied_count_ != submitted_count_) {
+    commit_pending_ = true;
+    return;
+  }
+  SubmitLocked();
+}
+
+void DispmanxPlaneAllocator::SubmitLocked() {
+  if (std::none_of(
+          planes_.begin(), planes_.end(),
+          [](const DispmanxPlane *plane) { return plane->IsDirtyLocked(); })) {
+    return;
+  }
+
+  auto update = ::vc_dispmanx_update_start(0);
+  if (update == DISPMANX_NO_HANDLE) {
+    FLWAY_ERROR << "Could not start a dispmanx update." << std::endl;
+    return;
+  }
+
+  const auto sequence = ++submitted_count_;
+  for (auto plane : planes_) {
+    plane->ApplyLocked(update, sequence);
+  }
+
+  // Submitted without waiting so that a moving cursor never holds up the
+  // input thread for a vsync.
+  if (::vc_dispmanx_update_submit(update, &OnUpdateApplied, this) != 0) {
+    FLWAY_ERROR << "Could not submit a dispmanx update." << std::endl;
+    applied_count_ = sequence;
+    update_applied_.notify_all();
+  }
+}
+
+void DispmanxPlaneAllocator::WaitForUpdateLocked(
+    std::unique_lock<std::mutex> &lock, uint64_t update) {
+  update_applied_.wait(lock,
+                       [this, update]() { return applied_count_ >= update; });
+}
+
+// Called on the Video Core thread that delivers callbacks. Replies to
+// requests arrive on another one, so starting the next update here is safe.
+void DispmanxPlaneAllocator::OnUpdateApplied(DISPMANX_UPDATE_HANDLE_T update,
+                                             void *arg) {
+  auto allocator = reinterpret_cast<DispmanxPlaneAllocator *>(arg);
+  std::lock_guard<std::mutex> lock(allocator->mutex_);
+  allocator->applied_count_++;
+  allocator->update_applied_.notify_all();
+  if (allocator->commit_pending_) {
+    allocator->commit_pending_ = false;
+    allocator->SubmitLocked();
+  }
+}
+
+} // namespace flutter
@@ -0,0 +1,66 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <bcm_host.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+#include "planes.h"
+
+namespace flutter {
+
+// Shows planes as dispmanx elements, which the hardware composites with the
+// application's element as it scans out. Backgrounds and video go on the two
+// layers below the application's and cursors on the one above it. Contents
+// are double buffered in Video Core resources.
+class DispmanxPlaneAllocator : public PlaneAllocator {
+public:
+  // |x|, |y| is where the application's element is on |display|.
+  DispmanxPlaneAllocator(DISPMANX_DISPLAY_HANDLE_T display, int32_t layer,
+                         int32_t x, int32_t y);
+
+  // Waits for the last update to be applied.
+  ~DispmanxPlaneAllocator() override;
+
+  // |PlaneAllocator|
+  std::unique_ptr<Plane> AllocatePlane(PlaneKind kind, size_t width,
+                                       size_t height) override;
+
+  // |PlaneAllocator|
+  void Commit() override;
+
+private:
+  class DispmanxPlane;
+
+  const DISPMANX_DISPLAY_HANDLE_T display_;
+  const int32_t layer_;
+  const int32_t x_;
+  const int32_t y_;
+
+  std::mutex mutex_;
+  std::vector<DispmanxPlane *> planes_;
+  // Updates are numbered in the order they are submitted. Only one is in
+  // flight at a time. Commits made meanwhile are merged into the next one,
+  // which is submitted once the one in flight has been applied.
+  uint64_t submitted_count_ = 0;
+  uint64_t applied_count_ = 0;
+  bool commit_pending_ = false;
+  std::condition_variable update_applied_;
+
+  void SubmitLocked();
+
+  void WaitForUpdateLocked(std::unique_lock<std::mutex> &lock,
+                           uint64_t update);
+
+  static void OnUpdateApplied(DISPMANX_UPDATE_HANDLE_T update, void *arg);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(DispmanxPlaneAllocator);
+};
+
+} // namespace flutter
@@ -0,0 +1,199 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "event_loop.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+EventLoop::EventLoop() : thread_id_(std::this_thread::get_id()) {
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the event loop epoll instance."
+                << std::endl;
+    return;
+  }
+
+  timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (timer_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the event loop timer." << std::endl;
+    return;
+  }
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = &timer_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event) == -1) {
+    FLWAY_ERROR << "Could not watch the event loop timer." << std::endl;
+    ::close(timer_fd_);
+    timer_fd_ = -1;
+    return;
+  }
+}
+
+EventLoop::~EventLoop() {
+  if (timer_fd_ != -1) {
+    ::close(timer_fd_);
+  }
+
+  if (epoll_fd_ != -1) {
+    ::close(epoll_fd_);
+  }
+}
+
+bool EventLoop::IsValid() const { return epoll_fd_ != -1 && timer_fd_ != -1; }
+
+bool EventLoop::RunsTasksOnCurrentThread() const {
+  return std::this_thread::get_id() == thread_id_;
+}
+
+void EventLoop::Run() {
+  if (!IsValid()) {
+    FLWAY_ERROR << "Cannot run an invalid event loop." << std::endl;
+    return;
+  }
+
+  if (!RunsTasksOnCurrentThread()) {
+    FLWAY_ERROR << "The event loop must be run on the thread that created it."
+                << std::endl;
+    return;
+  }
+
+  terminated_ = false;
+  epoll_event events[32];
+  while (!terminated_) {
+    const auto wait_begin = GetMonotonicTimeNanos();
+    const int count = ::epoll_wait(epoll_fd_, events, 32, -1 /* timeout */);
+    stats_.idle_nanos += GetMonotonicTimeNanos() - wait_begin;
+    ++stats_.wakeups;
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      FLWAY_ERROR << "Could not wait on the event loop: " << strerror(errno)
+                  << std::endl;
+      return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.ptr == &timer_fd_) {
+        uint64_t expirations = 0;
+        (void)::read(timer_fd_, &expirations, sizeof(expirations));
+        RunExpiredTasks();
+        continue;
+      }
+
+      auto watch = reinterpret_cast<Watch *>(events[i].data.ptr);
+      if (watch->fd != -1) {
+        watch->handler(events[i].events);
+      }
+    }
+
+    removed_watches_.clear();
+  }
+}
+
+EventLoop::Stats EventLoop::TakeStats() {
+  Stats stats = stats_;
+  stats_ = {};
+  return stats;
+}
+
+void EventLoop::Terminate() {
+  PostTask([this]() { terminated_ = true; });
+}
+
+void EventLoop::PostTask(Task task, uint64_t target_time_nanos) {
+  std::lock_guard<std::mutex> lock(tasks_mutex_);
+  PendingTask pending;
+  pending.target_time = target_time_nanos;
+  pending.order = task_order_++;
+  pending.task = std::move(task);
+  tasks_.push(std::move(pending));
+  // The timer only needs to move if this task is due before the current one.
+  if (armed_time_ == 0 || target_time_nanos < armed_time_) {
+    ArmTimerLocked(target_time_nanos);
+  }
+}
+
+void EventLoop::ArmTimerLocked(uint64_t target_time) {
+  // A zero value would disarm the timer. Any time in the past fires
+  // immediately.
+  const uint64_t time = target_time == 0 ? 1 : target_time;
+  itimerspec spec = {};
+  spec.it_value.tv_sec = time / 1000000000ull;
+  spec.it_value.tv_nsec = time % 1000000000ull;
+  armed_time_ = time;
+  if (::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+    FLWAY_ERROR << "Could not arm the event loop timer." << std::endl;
+  }
+}
+
+void EventLoop::RunExpiredTasks() {
+  {
+    const auto now = GetMonotonicTimeNanos();
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    while (!tasks_.empty() && tasks_.top().target_time <= now) {
+      // The queue only hands out const references. The task is about to be
+      // popped so moving out of it is safe.
+      expired_tasks_.emplace_back(
+          std::move(const_cast<PendingTask &>(tasks_.top()).task));
+      tasks_.pop();
+    }
+    // The timer is one-shot and has already fired.
+    armed_time_ = 0;
+    if (!tasks_.empty()) {
+      ArmTimerLocked(tasks_.top().target_time);
+    }
+  }
+
+  for (auto &task : expired_tasks_) {
+    task();
+  }
+  expired_tasks_.clear();
+}
+
+bool EventLoop::AddFD(int fd, uint32_t epoll_events, FDHandler handler) {
+  if (fd < 0 || !handler || watches_.count(fd) != 0) {
+    return false;
+  }
+
+  auto watch = std::make_unique<Watch>();
+  watch->fd = fd;
+  watch->handler = std::move(handler);
+
+  epoll_event event = {};
+  event.events = epoll_events;
+  event.data.ptr = watch.get();
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+    FLWAY_ERROR << "Could not add a file descriptor to the event loop."
+                << std::endl;
+    return false;
+  }
+
+  watches_[fd] = std::move(watch);
+  return true;
+}
+
+bool EventLoop::RemoveFD(int fd) {
+  auto found = watches_.find(fd);
+  if (found == watches_.end()) {
+    return false;
+  }
+
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  found->second->fd = -1;
+  removed_watches_.emplace_back(std::move(found->second));
+  watches_.erase(found);
+  return true;
+}
+
+} // namespace flutter
@@ -0,0 +1,114 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A single threaded event loop built on epoll. File descriptor readiness and
+// timed tasks are serviced from one wait so that the thread never busy-waits.
+// Tasks are kept in a priority queue keyed by their target time, and a timerfd
+// is armed for the earliest one.
+class EventLoop {
+public:
+  using Task = std::function<void()>;
+  using FDHandler = std::function<void(uint32_t epoll_events)>;
+
+  struct Stats {
+    // The number of times the thread woke up to service the loop.
+    uint64_t wakeups = 0;
+    // Time spent asleep waiting for a file descriptor or task.
+    uint64_t idle_nanos = 0;
+  };
+
+  // The loop belongs to the thread it is created on. |Run| must be called on
+  // that thread.
+  EventLoop();
+
+  ~EventLoop();
+
+  bool IsValid() const;
+
+  // Services file descriptors and tasks until |Terminate| is called.
+  void Run();
+
+  // Makes |Run| return after the current iteration. May be called on any
+  // thread.
+  void Terminate();
+
+  bool RunsTasksOnCurrentThread() const;
+
+  // Runs |task| on the loop thread once the monotonic clock reaches
+  // |target_time_nanos|. Tasks with the same target time run in the order they
+  // were posted. May be called on any thread.
+  void PostTask(Task task, uint64_t target_time_nanos = 0);
+
+  // Calls |handler| on the loop thread whenever |fd| reports one of the
+  // |epoll_events|. Must be called on the loop thread.
+  bool AddFD(int fd, uint32_t epoll_events, FDHandler handler);
+
+  // Must be called on the loop thread. Safe to call from inside a handler.
+  bool RemoveFD(int fd);
+
+  // Returns the stats accumulated since the last call. Must be called on the
+  // loop thread.
+  Stats TakeStats();
+
+private:
+  struct PendingTask {
+    uint64_t target_time = 0;
+    uint64_t order = 0;
+    Task task;
+
+    bool operator>(const PendingTask &other) const {
+      return target_time == other.target_time ? order > other.order
+                                              : target_time > other.target_time;
+    }
+  };
+
+  struct Watch {
+    int fd = -1;
+    FDHandler handler;
+  };
+
+  using TaskQueue = std::priority_queue<PendingTask, std::vector<PendingTask>,
+                                        std::greater<PendingTask>>;
+
+  const std::thread::id thread_id_;
+  int epoll_fd_ = -1;
+  int timer_fd_ = -1;
+  bool terminated_ = false;
+  Stats stats_;
+  std::map<int, std::unique_ptr<Watch>> watches_;
+  // Removed watches are kept alive until the end of the current iteration
+  // since a pending epoll event may still refer to them.
+  std::vector<std::unique_ptr<Watch>> removed_watches_;
+
+  std::mutex tasks_mutex_;
+  TaskQueue tasks_;
+  uint64_t task_order_ = 0;
+  // The time the timer is armed for. Zero when disarmed.
+  uint64_t armed_time_ = 0;
+  std::vector<Task> expired_tasks_;
+
+  void ArmTimerLocked(uint64_t target_time);
+
+  void RunExpiredTasks();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(EventLoop);
+};
+
+} // namespace flutter
@@ -0,0 +1,521 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "external_texture.h"
+
+#include <sys/mman.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+static constexpr uint32_t FourCC(char a, char b, char c, char d) {
+  return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+         (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+// R, G, B and A (or padding) bytes in memory order, the layout GL_RGBA
+// uploads expect.
+static const uint32_t kFourCCABGR8888 = FourCC('A', 'B', '2', '4');
+static const uint32_t kFourCCXBGR8888 = FourCC('X', 'B', '2', '4');
+// B, G, R and A (or padding). Importable but not uploadable.
+static const uint32_t kFourCCARGB8888 = FourCC('A', 'R', '2', '4');
+static const uint32_t kFourCCXRGB8888 = FourCC('X', 'R', '2', '4');
+
+static bool IsRGBFourCC(uint32_t fourcc) {
+  return fourcc == kFourCCABGR8888 || fourcc == kFourCCXBGR8888 ||
+         fourcc == kFourCCARGB8888 || fourcc == kFourCCXRGB8888;
+}
+
+static bool IsUploadableFourCC(uint32_t fourcc) {
+  return fourcc == kFourCCABGR8888 || fourcc == kFourCCXBGR8888;
+}
+
+template <typename T>
+static bool ResolveProc(const std::function<void *(const char *)> &resolver,
+                        const char *name, T &proc) {
+  proc = reinterpret_cast<T>(resolver(name));
+  return proc != nullptr;
+}
+
+bool ExternalTextureProcs::Resolve(
+    const std::function<void *(const char *)> &resolver) {
+  ResolveProc(resolver, "eglGetCurrentDisplay", GetCurrentDisplay);
+  ResolveProc(resolver, "eglQueryString", QueryString);
+  ResolveProc(resolver, "eglCreateImageKHR", CreateImageKHR);
+  ResolveProc(resolver, "eglDestroyImageKHR", DestroyImageKHR);
+  ResolveProc(resolver, "glEGLImageTargetTexture2DOES",
+              EGLImageTargetTexture2DOES);
+
+  return ResolveProc(resolver, "glGenTextures", GenTextures) &&
+         ResolveProc(resolver, "glDeleteTextures", DeleteTextures) &&
+         ResolveProc(resolver, "glBindTexture", BindTexture) &&
+         ResolveProc(resolver, "glTexParameteri", TexParameteri) &&
+         ResolveProc(resolver, "glTexImage2D", TexImage2D) &&
+         ResolveProc(resolver, "glTexSubImage2D", TexSubImage2D) &&
+         ResolveProc(resolver, "glPixelStorei", PixelStorei);
+}
+
+ExternalTexture::ExternalTexture(
+    int64_t id, FlutterEngine engine, const Config &config,
+    std::shared_ptr<const ExternalTextureProcs> procs)
+    : id_(id), engine_(engine), config_(config), procs_(std::move(procs)) {
+  if (config_.width == 0 || config_.height == 0) {
+    FLWAY_ERROR << "Invalid external texture size: " << config_.width << " x "
+                << config_.height << std::endl;
+    return;
+  }
+
+  const bool uses_dmabufs = !config_.dmabufs.empty();
+  const size_t count =
+      uses_dmabufs ? config_.dmabufs.size() : config_.buffer_count;
+  if (count == 0) {
+    FLWAY_ERROR << "An external texture needs at least one buffer."
+                << std::endl;
+    return;
+  }
+
+  buffers_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto &entry = buffers_[i];
+    entry.buffer.index = i;
+    if (uses_dmabufs) {
+      entry.dmabuf = config_.dmabufs[i];
+      entry.buffer.row_bytes = entry.dmabuf.stride;
+    } else {
+      entry.buffer.row_bytes = config_.width * 4;
+      entry.memory.reset(new uint8_t[entry.buffer.row_bytes * config_.height]);
+      entry.buffer.pixels = entry.memory.get();
+    }
+  }
+
+  // Each dmabuf is bound to its own GL texture once imported.
+  if (uses_dmabufs) {
+    for (size_t i = 0; i < count; ++i) {
+      auto slot = std::make_unique<Slot>();
+      slot->owner = this;
+      slot->index = i;
+      slots_.push_back(std::move(slot));
+    }
+  }
+
+  valid_ = true;
+}
+
+ExternalTexture::~ExternalTexture() {
+  for (auto &entry : buffers_) {
+    if (entry.mapping != nullptr) {
+      ::munmap(entry.mapping, entry.mapping_size);
+    }
+  }
+}
+
+bool ExternalTexture::IsValid() const { return valid_; }
+
+int64_t ExternalTexture::GetID() const { return id_; }
+
+ExternalTexture::Buffer *ExternalTexture::AcquireBuffer() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (retired_) {
+    return nullptr;
+  }
+  for (auto &entry : buffers_) {
+    if (entry.state == BufferState::kFree) {
+      entry.state = BufferState::kAcquired;
+      return &entry.buffer;
+    }
+  }
+  return nullptr;
+}
+
+bool ExternalTexture::SubmitBuffer(Buffer *buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &entry = buffers_[buffer->index];
+  if (retired_) {
+    entry.state = BufferState::kFree;
+    return false;
+  }
+  entry.state = BufferState::kQueued;
+  queued_.push_back(buffer->index);
+
+  // Under the lock, so that once |Retire| returns the engine may shut down.
+  return FlutterEngineMarkExternalTextureFrameAvailable(engine_, id_) ==
+         kSuccess;
+}
+
+bool ExternalTexture::Populate(FlutterOpenGLTexture &texture) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!valid_ || retired_) {
+    return false;
+  }
+
+  // Only the latest frame is worth showing.
+  if (!queued_.empty()) {
+    const size_t latest = queued_.back();
+    for (size_t i = 0; i + 1 < queued_.size(); ++i) {
+      buffers_[queued_[i]].state = BufferState::kFree;
+    }
+    queued_.clear();
+
+    if (!config_.dmabufs.empty() && ImportDmaBufLocked(latest)) {
+      // The GPU reads the dmabuf directly, so the buffer stays out of the
+      // pool until a newer frame replaces it and the engine lets go of it.
+      buffers_[latest].state = BufferState::kDisplayed;
+      SetCurrentSlotLocked(static_cast<int>(latest));
+    } else {
+      auto slot = GetUploadSlotLocked();
+      // GL has copied the pixels.
+      buffers_[latest].state = BufferState::kFree;
+      if (UploadLocked(latest, *slot)) {
+        SetCurrentSlotLocked(static_cast<int>(slot->index));
+      }
+    }
+  }
+
+  // Without a new frame the engine gets the current one again.
+  if (current_slot_ < 0) {
+    return false;
+  }
+
+  auto &slot = *slots_[current_slot_];
+  slot.references++;
+  if (outstanding_references_++ == 0) {
+    self_ = shared_from_this();
+  }
+
+  texture.target = slot.target;
+  texture.name = slot.name;
+  texture.format = GL_RGBA8_OES;
+  texture.user_data = &slot;
+  texture.destruction_callback = &ExternalTexture::OnTextureReleased;
+  texture.width = config_.width;
+  texture.height = config_.height;
+  return true;
+}
+
+void ExternalTexture::Retire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  retired_ = true;
+  for (const auto index : queued_) {
+    buffers_[index].state = BufferState::kFree;
+  }
+  queued_.clear();
+}
+
+void ExternalTexture::ReleaseGLResources() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (outstanding_references_ == 0) {
+    ReleaseGLResourcesLocked();
+  }
+}
+
+void ExternalTexture::SetCurrentSlotLocked(int index) {
+  const int previous = current_slot_;
+  current_slot_ = index;
+  // An imported dmabuf stays displayed while it is the current frame. It is
+  // also replaced by uploads once importing fails.
+  if (previous >= 0 && previous != index &&
+      static_cast<size_t>(previous) < buffers_.size() &&
+      slots_[previous]->references == 0 &&
+      buffers_[previous].state == BufferState::kDisplayed) {
+    buffers_[previous].state = BufferState::kFree;
+  }
+}
+
+void ExternalTexture::OnTextureReleased(void *user_data) {
+  auto &slot = *reinterpret_cast<Slot *>(user_data);
+  auto &texture = *slot.owner;
+
+  // Dropped after unlocking since it may be the last reference.
+  std::shared_ptr<ExternalTexture> self;
+  {
+    std::lock_guard<std::mutex> lock(texture.mutex_);
+    slot.references--;
+    if (slot.references == 0 && slot.index < texture.buffers_.size() &&
+        static_cast<int>(slot.index) != texture.current_slot_ &&
+        texture.buffers_[slot.index].state == BufferState::kDisplayed) {
+      texture.buffers_[slot.index].state = BufferState::kFree;
+    }
+    if (--texture.outstanding_references_ == 0) {
+      // The engine releases textures on the raster thread, where the context
+      // is current.
+      if (texture.retired_) {
+        texture.ReleaseGLResourcesLocked();
+      }
+      self = std::move(texture.self_);
+    }
+  }
+}
+
+bool ExternalTexture::ImportDmaBufLocked(size_t index) {
+  if (!import_checked_) {
+    import_checked_ = true;
+    const auto &procs = *procs_;
+    if (procs.GetCurrentDisplay != nullptr && procs.QueryString != nullptr &&
+        procs.CreateImageKHR != nullptr && procs.DestroyImageKHR != nullptr &&
+        procs.EGLImageTargetTexture2DOES != nullptr) {
+      can_import_ =
+          HasExtension(procs.QueryString(procs.GetCurrentDisplay(),
+                                         EGL_EXTENSIONS),
+                       "EGL_EXT_image_dma_buf_import");
+    }
+    if (!can_import_) {
+      FLWAY_LOG << "dmabufs can't be imported. External texture frames will "
+                   "be uploaded from memory."
+                << std::endl;
+    }
+  }
+
+  if (!can_import_) {
+    return false;
+  }
+
+  auto &slot = *slots_[index];
+  if (slot.image != EGL_NO_IMAGE_KHR) {
+    return true;
+  }
+
+  const auto &dmabuf = buffers_[index].dmabuf;
+  const EGLint attributes[] = {
+      EGL_WIDTH,                     static_cast<EGLint>(config_.width),  //
+      EGL_HEIGHT,                    static_cast<EGLint>(config_.height), //
+      EGL_LINUX_DRM_FOURCC_EXT,      static_cast<EGLint>(dmabuf.fourcc),  //
+      EGL_DMA_BUF_PLANE0_FD_EXT,     dmabuf.fd,                           //
+      EGL_DMA_BUF_PLANE0_OFFSET_EXT, static_cast<EGLint>(dmabuf.offset),  //
+      EGL_DMA_BUF_PLANE0_PITCH_EXT,  static_cast<EGLint>(dmabuf.stride),  //
+      EGL_NONE                                                            //
+  };
+  auto image = procs_->CreateImageKHR(procs_->GetCurrentDisplay(),
+                                      EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT,
+                                      nullptr, attributes);
+  if (image == EGL_NO_IMAGE_KHR) {
+    FLWAY_ERROR << "Could not import a dmabuf. External texture frames will "
+                   "be uploaded from memory."
+                << std::endl;
+    can_import_ = false;
+    return false;
+  }
+
+  CreateTextureLocked(slot, IsRGBFourCC(dmabuf.fourcc)
+                                ? GL_TEXTURE_2D
+                                : GL_TEXTURE_EXTERNAL_OES);
+  slot.image = image;
+  procs_->EGLImageTargetTexture2DOES(slot.target, image);
+  procs_->BindTexture(slot.target, 0);
+  return true;
+}
+
+ExternalTexture::Slot *ExternalTexture::GetUploadSlotLocked() {
+  Slot *slot = nullptr;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    // Uploading into an imported texture would write to its dmabuf.
+    if (slots_[i]->references == 0 && static_cast<int>(i) != current_slot_ &&
+        slots_[i]->image == EGL_NO_IMAGE_KHR) {
+      slot = slots_[i].get();
+      break;
+    }
+  }
+
+  // The engine holds on to every texture so far.
+  if (slot == nullptr) {
+    auto new_slot = std::make_unique<Slot>();
+    new_slot->owner = this;
+    new_slot->index = slots_.size();
+    slot = new_slot.get();
+    slots_.push_back(std::move(new_slot));
+  }
+
+  // Slots of dmabufs that couldn't be imported have no texture yet.
+  if (slot->name == 0) {
+    CreateTextureLocked(*slot, GL_TEXTURE_2D);
+    procs_->TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, config_.width,
+                       config_.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    procs_->BindTexture(GL_TEXTURE_2D, 0);
+  }
+  return slot;
+}
+
+bool ExternalTexture::UploadLocked(size_t index, const Slot &slot) {
+  auto &entry = buffers_[index];
+  const uint8_t *pixels = entry.buffer.pixels;
+  size_t row_bytes = entry.buffer.row_bytes;
+
+  if (pixels == nullptr) {
+    if (!IsUploadableFourCC(entry.dmabuf.fourcc)) {
+      FLWAY_ERROR << "Cannot upload external texture frames of this format."
+                  << std::endl;
+      return false;
+    }
+    if (entry.mapping == nullptr) {
+      const size_t size =
+          entry.dmabuf.offset + entry.dmabuf.stride * config_.height;
+      auto mapping =
+          ::mmap(nullptr, size, PROT_READ, MAP_SHARED, entry.dmabuf.fd, 0);
+      if (mapping == MAP_FAILED) {
+        FLWAY_ERROR << "Could not map a dmabuf." << std::endl;
+        return false;
+      }
+      entry.mapping = mapping;
+      entry.mapping_size = size;
+    }
+    pixels = static_cast<const uint8_t *>(entry.mapping) + entry.dmabuf.offset;
+  }
+
+  procs_->BindTexture(GL_TEXTURE_2D, slot.name);
+  procs_->PixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  if (row_bytes == config_.width * 4) {
+    procs_->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, config_.width,
+                          config_.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  } else {
+    // OpenGL ES 2 can't upload rows with padding in one go.
+    for (size_t row = 0; row < config_.height; ++row) {
+      procs_->TexSubImage2D(GL_TEXTURE_2D, 0, 0, row, config_.width, 1,
+                            GL_RGBA, GL_UNSIGNED_BYTE,
+                            pixels + row * row_bytes);
+    }
+  }
+  procs_->BindTexture(GL_TEXTURE_2D, 0);
+  return true;
+}
+
+void ExternalTexture::CreateTextureLocked(Slot &slot, GLenum target) {
+  slot.target = target;
+  procs_->GenTextures(1, &slot.name);
+  procs_->BindTexture(target, slot.name);
+  procs_->TexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  procs_->TexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // Required for textures that aren't a power of two in size.
+  procs_->TexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  procs_->TexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void ExternalTexture::ReleaseGLResourcesLocked() {
+  const auto display = procs_->GetCurrentDisplay != nullptr
+                           ? procs_->GetCurrentDisplay()
+                           : EGL_NO_DISPLAY;
+  for (auto &slot : slots_) {
+    if (slot->name != 0) {
+      procs_->DeleteTextures(1, &slot->name);
+      slot->name = 0;
+    }
+    if (slot->image != EGL_NO_IMAGE_KHR && display != EGL_NO_DISPLAY) {
+      procs_->DestroyImageKHR(display, slot->image);
+      slot->image = EGL_NO_IMAGE_KHR;
+    }
+  }
+}
+
+ExternalTextureRegistry::ExternalTextureRegistry(const ProcResolver &resolver)
+    : procs_(std::make_shared<ExternalTextureProcs>()) {
+  valid_ = procs_->Resolve(resolver);
+}
+
+ExternalTextureRegistry::~ExternalTextureRegistry() = default;
+
+bool ExternalTextureRegistry::IsValid() const { return valid_; }
+
+void ExternalTextureRegistry::SetEngine(FlutterEngine engine) {
+  engine_ = engine;
+}
+
+std::shared_ptr<ExternalTexture> ExternalTextureRegistry::RegisterTexture(
+    const ExternalTexture::Config &config) {
+  if (!valid_ || engine_ == nullptr) {
+    FLWAY_ERROR << "External textures are not available." << std::endl;
+    return nullptr;
+  }
+
+  const auto id = next_id_++;
+  auto texture = std::make_shared<ExternalTexture>(id, engine_, config, procs_);
+  if (!texture->IsValid()) {
+    return nullptr;
+  }
+
+  if (FlutterEngineRegisterExternalTexture(engine_, id) != kSuccess) {
+    FLWAY_ERROR << "Could not register an external texture." << std::endl;
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  textures_[id] = texture;
+  return texture;
+}
+
+bool ExternalTextureRegistry::UnregisterTexture(int64_t id) {
+  std::shared_ptr<ExternalTexture> texture;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = textures_.find(id);
+    if (found == textures_.end()) {
+      return false;
+    }
+    texture = std::move(found->second);
+    textures_.erase(found);
+  }
+
+  texture->Retire();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.push_back(std::move(texture));
+    has_retired_ = true;
+  }
+  return FlutterEngineUnregisterExternalTexture(engine_, id) == kSuccess;
+}
+
+bool ExternalTextureRegistry::PopulateTexture(int64_t id,
+                                              FlutterOpenGLTexture &texture) {
+  std::shared_ptr<ExternalTexture> external_texture;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = textures_.find(id);
+    if (found == textures_.end()) {
+      return false;
+    }
+    external_texture = found->second;
+  }
+  return external_texture->Populate(texture);
+}
+
+void ExternalTextureRegistry::CollectRetiredTextures() {
+  if (!has_retired_.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  std::vector<std::shared_ptr<ExternalTexture>> retired;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired.swap(retired_);
+    has_retired_ = false;
+  }
+  for (const auto &texture : retired) {
+    texture->ReleaseGLResources();
+  }
+}
+
+void ExternalTextureRegistry::RetireTextures() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &texture : textures_) {
+    texture.second->Retire();
+  }
+}
+
+void ExternalTextureRegistry::Shutdown() {
+  std::vector<std::shared_ptr<ExternalTexture>> textures;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    textures.swap(retired_);
+    has_retired_ = false;
+    for (auto &texture : textures_) {
+      textures.push_back(std::move(texture.second));
+    }
+    textures_.clear();
+  }
+  // Retired before the engine shut down, which returned every texture it
+  // held meanwhile.
+  for (const auto &texture : textures) {
+    texture->ReleaseGLResources();
+  }
+}
+
+} // namespace flutter
@@ -0,0 +1,233 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <flutter_embedder.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// The GL and EGL entry points external textures use, resolved through the
+// render delegate so that the embedder doesn't link against a GL library.
+struct ExternalTextureProcs {
+  decltype(&::glGenTextures) GenTextures = nullptr;
+  decltype(&::glDeleteTextures) DeleteTextures = nullptr;
+  decltype(&::glBindTexture) BindTexture = nullptr;
+  decltype(&::glTexParameteri) TexParameteri = nullptr;
+  decltype(&::glTexImage2D) TexImage2D = nullptr;
+  decltype(&::glTexSubImage2D) TexSubImage2D = nullptr;
+  decltype(&::glPixelStorei) PixelStorei = nullptr;
+  // Optional. Without these frames are always uploaded from memory.
+  decltype(&::eglGetCurrentDisplay) GetCurrentDisplay = nullptr;
+  decltype(&::eglQueryString) QueryString = nullptr;
+  PFNEGLCREATEIMAGEKHRPROC CreateImageKHR = nullptr;
+  PFNEGLDESTROYIMAGEKHRPROC DestroyImageKHR = nullptr;
+  PFNGLEGLIMAGETARGETTEXTURE2DOESPROC EGLImageTargetTexture2DOES = nullptr;
+
+  // Returns false if a required entry point is missing.
+  bool Resolve(const std::function<void *(const char *)> &resolver);
+};
+
+// A texture Dart code shows with a |Texture| widget, fed by a producer such as
+// a camera or video decoder on its own thread. Producers fill buffers from a
+// small pool and submit them. The engine is handed GL textures from a second
+// pool when it draws, and always gets the latest frame. Older frames that it
+// never asked for are dropped.
+//
+// Buffers are either dmabufs supplied by the producer, which are imported
+// through EGLImage so that frames are never copied by the CPU, or memory
+// allocated by the texture that is uploaded with glTexSubImage2D. dmabufs are
+// mapped and uploaded the same way if the driver can't import them.
+class ExternalTexture : public std::enable_shared_from_this<ExternalTexture> {
+public:
+  struct DmaBuf {
+    int fd = -1;
+    // A DRM fourcc such as 'AB24'. Formats other than RGB with 8 bit
+    // channels are sampled as GL_TEXTURE_EXTERNAL_OES and can't be uploaded.
+    uint32_t fourcc = 0;
+    uint32_t offset = 0;
+    uint32_t stride = 0;
+  };
+
+  struct Config {
+    size_t width = 0;
+    size_t height = 0;
+    // Producer owned dmabufs, one per buffer. The texture doesn't close them.
+    std::vector<DmaBuf> dmabufs;
+    // The number of buffers to allocate in memory when there are no dmabufs.
+    size_t buffer_count = 3;
+  };
+
+  struct Buffer {
+    // Indexes |Config::dmabufs| for dmabuf backed textures.
+    size_t index = 0;
+    // Tightly packed RGBA pixels. Null for dmabufs.
+    uint8_t *pixels = nullptr;
+    size_t row_bytes = 0;
+  };
+
+  ExternalTexture(int64_t id, FlutterEngine engine, const Config &config,
+                  std::shared_ptr<const ExternalTextureProcs> procs);
+
+  ~ExternalTexture();
+
+  bool IsValid() const;
+
+  int64_t GetID() const;
+
+  // Returns a buffer to draw the next frame into, or null if every buffer is
+  // queued or being displayed, in which case the frame should be skipped.
+  // May be called on any thread, but by one producer at a time.
+  Buffer *AcquireBuffer();
+
+  // Queues an acquired buffer for display and tells the engine a new frame is
+  // available. Returns false once the texture has been retired, after which
+  // the engine is never called.
+  bool SubmitBuffer(Buffer *buffer);
+
+  // Called from the engine's external texture callback on the raster thread
+  // with the onscreen context current.
+  bool Populate(FlutterOpenGLTexture &texture);
+
+  // Called when the texture is unregistered. Producers may keep submitting,
+  // and the frames are ignored.
+  void Retire();
+
+  // Deletes the GL textures and EGLImages of a retired texture. If the engine
+  // still holds one of them, they are deleted on the raster thread once it
+  // returns the last. Must be called with a context sharing the onscreen
+  // context's objects current.
+  void ReleaseGLResources();
+
+private:
+  enum class BufferState { kFree, kAcquired, kQueued, kDisplayed };
+
+  struct BufferEntry {
+    Buffer buffer;
+    BufferState state = BufferState::kFree;
+    std::unique_ptr<uint8_t[]> memory;
+    DmaBuf dmabuf;
+    // The read only mapping of a dmabuf that couldn't be imported.
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+  };
+
+  struct Slot {
+    ExternalTexture *owner = nullptr;
+    // The position in |slots_|. Also the buffer imported into the slot.
+    size_t index = 0;
+    GLuint name = 0;
+    GLenum target = GL_TEXTURE_2D;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    // Handed to the engine this many times without being returned.
+    size_t references = 0;
+  };
+
+  const int64_t id_;
+  const FlutterEngine engine_;
+  const Config config_;
+  const std::shared_ptr<const ExternalTextureProcs> procs_;
+  bool valid_ = false;
+
+  std::mutex mutex_;
+  std::vector<BufferEntry> buffers_;
+  // Oldest first.
+  std::vector<size_t> queued_;
+  // Slots are never reallocated since the engine holds pointers to them.
+  std::vector<std::unique_ptr<Slot>> slots_;
+  // The slot with the latest frame or -1 before the first one.
+  int current_slot_ = -1;
+  size_t outstanding_references_ = 0;
+  // Keeps the texture alive while the engine holds any of its GL textures.
+  std::shared_ptr<ExternalTexture> self_;
+  bool retired_ = false;
+  // Decided on the raster thread the first time a frame is imported.
+  bool import_checked_ = false;
+  bool can_import_ = false;
+
+  bool ImportDmaBufLocked(size_t index);
+
+  bool UploadLocked(size_t index, const Slot &slot);
+
+  Slot *GetUploadSlotLocked();
+
+  void SetCurrentSlotLocked(int index);
+
+  void CreateTextureLocked(Slot &slot, GLenum target);
+
+  void ReleaseGLResourcesLocked();
+
+  static void OnTextureReleased(void *user_data);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ExternalTexture);
+};
+
+// Hands out texture IDs and routes the engine's frame requests to the
+// textures registered with it.
+class ExternalTextureRegistry {
+public:
+  using ProcResolver = std::function<void *(const char *)>;
+
+  explicit ExternalTextureRegistry(const ProcResolver &resolver);
+
+  ~ExternalTextureRegistry();
+
+  // False if the render delegate doesn't provide the required GL entry points.
+  bool IsValid() const;
+
+  void SetEngine(FlutterEngine engine);
+
+  // Must be called on the platform thread.
+  std::shared_ptr<ExternalTexture>
+  RegisterTexture(const ExternalTexture::Config &config);
+
+  // Must be called on the platform thread. Producers may keep submitting to
+  // the texture, which ignores the frames.
+  bool UnregisterTexture(int64_t id);
+
+  // Called on the raster thread.
+  bool PopulateTexture(int64_t id, FlutterOpenGLTexture &texture);
+
+  // Releases the GL resources of textures unregistered since the last call.
+  // Called on the raster thread with the onscreen context current.
+  void CollectRetiredTextures();
+
+  // Retires every texture so that producers that outlive the engine stop
+  // calling into it. Called before the engine shuts down.
+  void RetireTextures();
+
+  // Releases the GL resources of every texture. Called once the engine has
+  // shut down, with a context sharing the onscreen context's objects current.
+  void Shutdown();
+
+private:
+  std::shared_ptr<ExternalTextureProcs> procs_;
+  bool valid_ = false;
+  FlutterEngine engine_ = nullptr;
+  int64_t next_id_ = 1;
+  std::mutex mutex_;
+  std::map<int64_t, std::shared_ptr<ExternalTexture>> textures_;
+  // Unregistered textures whose GL resources haven't been released. The
+  // resource context outlives relaunches, so they would otherwise leak.
+  std::vector<std::shared_ptr<ExternalTexture>> retired_;
+  // Lets the raster thread skip the lock on frames with nothing to collect.
+  std::atomic<bool> has_retired_{false};
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ExternalTextureRegistry);
+};
+
+} // namespace flutter
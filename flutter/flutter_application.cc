@@ -4,79 +4,146 @@
 
 #include "flutter_application.h"
 
+#include <sys/epoll.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#include <chrono>
-#include <climits>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include "input_reader.h"
+#include "key_event_queue.h"
+#include "pointer_event_queue.h"
+#include "shader_cache.h"
+#include "thread_policy.h"
 #include "utils.h"
+#include "vsync_waiter.h"
 
 namespace flutter {
 
 static_assert(FLUTTER_ENGINE_VERSION == 1, "");
 
-static const char *kICUDataFileName = "icudtl.dat";
+// The refresh rate assumed for displays that don't report vsync.
+static const double kDefaultRefreshRate = 60.0;
 
-static std::string GetICUDataPath() {
-  auto exe_dir = GetExecutableDirectory();
-  if (exe_dir == "") {
-    return "";
-  }
-  std::stringstream stream;
-  stream << exe_dir << kICUDataFileName;
-
-  auto icu_path = stream.str();
-
-  if (!FileExistsAtPath(icu_path.c_str())) {
-    FLWAY_ERROR << "Could not find " << icu_path << std::endl;
-    return "";
-  }
-
-  return icu_path;
-}
+// Pointer moves and hovers are coalesced to at most one per device in this
+// interval.
+static const uint64_t kPointerFrameIntervalNanos =
+    1000000000ull / kDefaultRefreshRate;
 
 FlutterApplication::FlutterApplication(
     std::string bundle_path, const std::vector<std::string> &command_line_args,
-    RenderDelegate &render_delegate)
-    : render_delegate_(render_delegate) {
+    RenderDelegate &render_delegate, EventLoop &event_loop,
+    const ShaderCache *shader_cache)
+    : render_delegate_(render_delegate), event_loop_(event_loop) {
   if (!FlutterAssetBundleIsValid(bundle_path)) {
     FLWAY_ERROR << "Flutter asset bundle was not valid." << std::endl;
     return;
   }
 
   FlutterRendererConfig config = {};
-  config.type = kOpenGL;
-  config.open_gl.struct_size = sizeof(config.open_gl);
-  config.open_gl.make_current = [](void *userdata) -> bool {
-    return reinterpret_cast<FlutterApplication *>(userdata)
-        ->render_delegate_.OnApplicationContextMakeCurrent();
-  };
-  config.open_gl.clear_current = [](void *userdata) -> bool {
-    return reinterpret_cast<FlutterApplication *>(userdata)
-        ->render_delegate_.OnApplicationContextClearCurrent();
-  };
-  config.open_gl.present = [](void *userdata) -> bool {
-    return reinterpret_cast<FlutterApplication *>(userdata)
-        ->render_delegate_.OnApplicationPresent();
-  };
-  config.open_gl.fbo_callback = [](void *userdata) -> uint32_t {
-    return reinterpret_cast<FlutterApplication *>(userdata)
-        ->render_delegate_.OnApplicationGetOnscreenFBO();
-  };
-  config.open_gl.gl_proc_resolver = [](void *userdata,
-                                       const char *name) -> void * {
-    return reinterpret_cast<FlutterApplication *>(userdata)
-        ->render_delegate_.GetProcAddress(name);
-  };
+  config.type = render_delegate_.GetRendererType();
+  switch (config.type) {
+  case kOpenGL:
+    config.open_gl.struct_size = sizeof(config.open_gl);
+    config.open_gl.make_current = [](void *userdata) -> bool {
+      ApplyThreadPolicyOnce(ThreadRole::kRaster);
+      auto application = reinterpret_cast<FlutterApplication *>(userdata);
+      const auto begin = GetMonotonicTimeNanos();
+      const auto result =
+          application->render_delegate_.OnApplicationContextMakeCurrent();
+      application->frame_stats_.RecordMakeCurrent(begin,
+                                                  GetMonotonicTimeNanos());
+      return result;
+    };
+    config.open_gl.clear_current = [](void *userdata) -> bool {
+      return reinterpret_cast<FlutterApplication *>(userdata)
+          ->render_delegate_.OnApplicationContextClearCurrent();
+    };
+    config.open_gl.make_resource_current = [](void *userdata) -> bool {
+      ApplyThreadPolicyOnce(ThreadRole::kIO);
+      return reinterpret_cast<FlutterApplication *>(userdata)
+          ->render_delegate_.OnApplicationMakeResourceCurrent();
+    };
+    if (render_delegate_.SupportsPartialPresent()) {
+      config.open_gl.present_with_info =
+          [](void *userdata, const FlutterPresentInfo *info) -> bool {
+        auto application = reinterpret_cast<FlutterApplication *>(userdata);
+        application->CollectRetiredTextures();
+        const auto begin = GetMonotonicTimeNanos();
+        const auto result =
+            application->render_delegate_.OnApplicationPresentWithDamage(
+                info->frame_damage);
+        application->frame_stats_.RecordPresent(begin,
+                                                GetMonotonicTimeNanos());
+        return result;
+      };
+      config.open_gl.populate_existing_damage =
+          [](void *userdata, intptr_t fbo_id, FlutterDamage *damage) {
+            reinterpret_cast<FlutterApplication *>(userdata)
+                ->render_delegate_.OnApplicationGetBufferDamage(*damage);
+          };
+    } else {
+      config.open_gl.present = [](void *userdata) -> bool {
+        auto application = reinterpret_cast<FlutterApplication *>(userdata);
+        application->CollectRetiredTextures();
+        const auto begin = GetMonotonicTimeNanos();
+        const auto result =
+            application->render_delegate_.OnApplicationPresent();
+        application->frame_stats_.RecordPresent(begin,
+                                                GetMonotonicTimeNanos());
+        return result;
+      };
+    }
+    config.open_gl.fbo_callback = [](void *userdata) -> uint32_t {
+      return reinterpret_cast<FlutterApplication *>(userdata)
+          ->render_delegate_.OnApplicationGetOnscreenFBO();
+    };
+    config.open_gl.gl_proc_resolver = [](void *userdata,
+                                         const char *name) -> void * {
+      return reinterpret_cast<FlutterApplication *>(userdata)
+          ->render_delegate_.GetProcAddress(name);
+    };
+    external_textures_ = std::make_unique<ExternalTextureRegistry>(
+        [this](const char *name) {
+          return render_delegate_.GetProcAddress(name);
+        });
+    if (external_textures_->IsValid()) {
+      config.open_gl.gl_external_texture_frame_callback =
+          [](void *userdata, int64_t texture_id, size_t width, size_t height,
+             FlutterOpenGLTexture *texture) -> bool {
+        return reinterpret_cast<FlutterApplication *>(userdata)
+            ->external_textures_->PopulateTexture(texture_id, *texture);
+      };
+    } else {
+      FLWAY_DLOG << "External textures are not supported by the display."
+                 << std::endl;
+      external_textures_.reset();
+    }
+    break;
+  case kSoftware:
+    config.software.struct_size = sizeof(config.software);
+    config.software.surface_present_callback =
+        [](void *userdata, const void *allocation, size_t row_bytes,
+           size_t height) -> bool {
+      ApplyThreadPolicyOnce(ThreadRole::kRaster);
+      auto application = reinterpret_cast<FlutterApplication *>(userdata);
+      const auto begin = GetMonotonicTimeNanos();
+      const auto result =
+          application->render_delegate_.OnApplicationSoftwarePresent(
+              allocation, row_bytes, height);
+      application->frame_stats_.RecordPresent(begin, GetMonotonicTimeNanos());
+      return result;
+    };
+    break;
+  }
 
-  auto icu_data_path = GetICUDataPath();
+  auto icu_data_path = GetICUDataPath(bundle_path);
 
   if (icu_data_path == "") {
     FLWAY_ERROR << "Could not find ICU data. It should be placed next to the "
-                   "executable but it wasn't there."
+                   "executable or in the bundle but it wasn't there."
                 << std::endl;
     return;
   }
@@ -87,15 +154,88 @@ FlutterApplication::FlutterApplication(
     command_line_args_c.push_back(arg.c_str());
   }
 
-  FlutterProjectArgs args = {
-      .struct_size = sizeof(FlutterProjectArgs),
-      .assets_path = bundle_path.c_str(),
-      .icu_data_path = icu_data_path.c_str(),
-      .command_line_argc = static_cast<int>(command_line_args_c.size()),
-      .command_line_argv = command_line_args_c.data(),
+  // Platform tasks are run on the event loop instead of being pumped.
+  FlutterTaskRunnerDescription platform_task_runner = {};
+  platform_task_runner.struct_size = sizeof(FlutterTaskRunnerDescription);
+  platform_task_runner.user_data = this;
+  platform_task_runner.runs_task_on_current_thread_callback =
+      [](void *userdata) -> bool {
+    return reinterpret_cast<FlutterApplication *>(userdata)
+        ->event_loop_.RunsTasksOnCurrentThread();
+  };
+  task_token_ = std::make_shared<bool>(true);
+  platform_task_runner.post_task_callback =
+      [](FlutterTask task, uint64_t target_time_nanos, void *userdata) {
+        auto application = reinterpret_cast<FlutterApplication *>(userdata);
+        std::weak_ptr<bool> token = application->task_token_;
+        application->event_loop_.PostTask(
+            [application, token, task]() {
+              if (token.expired()) {
+                return;
+              }
+              if (FlutterEngineRunTask(application->engine_, &task) !=
+                  kSuccess) {
+                FLWAY_ERROR << "Could not run an engine task." << std::endl;
+              }
+            },
+            target_time_nanos);
+      };
+
+  FlutterCustomTaskRunners custom_task_runners = {};
+  custom_task_runners.struct_size = sizeof(FlutterCustomTaskRunners);
+  custom_task_runners.platform_task_runner = &platform_task_runner;
+
+  FlutterProjectArgs args = {};
+  args.struct_size = sizeof(FlutterProjectArgs);
+  args.assets_path = bundle_path.c_str();
+  args.icu_data_path = icu_data_path.c_str();
+  args.command_line_argc = static_cast<int>(command_line_args_c.size());
+  args.command_line_argv = command_line_args_c.data();
+  args.custom_task_runners = &custom_task_runners;
+  args.platform_message_callback = [](const FlutterPlatformMessage *message,
+                                      void *userdata) {
+    reinterpret_cast<FlutterApplication *>(userdata)
+        ->platform_message_dispatcher_.Dispatch(*message);
   };
 
-  FlutterEngine engine = nullptr;
+  if (shader_cache != nullptr) {
+    args.persistent_cache_path = shader_cache->GetPath().c_str();
+    args.is_persistent_cache_read_only = shader_cache->IsReadOnly();
+  }
+
+  if (!LoadDartCode(bundle_path, args)) {
+    return;
+  }
+
+  vsync_waiter_ = render_delegate_.GetVsyncWaiter();
+  if (vsync_waiter_ == nullptr) {
+    timer_vsync_waiter_ =
+        std::make_unique<TimerVsyncWaiter>(event_loop_, kDefaultRefreshRate);
+    if (timer_vsync_waiter_->IsValid()) {
+      vsync_waiter_ = timer_vsync_waiter_.get();
+    }
+  }
+
+  // Without a waiter the engine falls back to its own frame timer.
+  if (vsync_waiter_ != nullptr) {
+    args.vsync_callback = [](void *userdata, intptr_t baton) {
+      ApplyThreadPolicyOnce(ThreadRole::kUI);
+      auto application = reinterpret_cast<FlutterApplication *>(userdata);
+      std::lock_guard<std::mutex> lock(application->vsync_mutex_);
+      if (application->vsync_stopped_) {
+        return;
+      }
+      application->vsync_waiter_->AwaitVsync(
+          [application, baton](uint64_t frame_start, uint64_t frame_target) {
+            if (FlutterEngineOnVsync(application->engine_, baton, frame_start,
+                                     frame_target) != kSuccess) {
+              FLWAY_ERROR << "Could not notify the engine of vsync."
+                          << std::endl;
+            }
+          });
+    };
+  }
+
   auto result = FlutterEngineRun(FLUTTER_ENGINE_VERSION, &config, &args,
                                  this /* userdata */, &engine_);
 
@@ -104,24 +244,197 @@ FlutterApplication::FlutterApplication(
     return;
   }
 
+  // Messages are delivered by platform tasks, none of which have run yet.
+  platform_message_dispatcher_.SetEngine(engine_);
+  if (external_textures_) {
+    external_textures_->SetEngine(engine_);
+  }
+
   valid_ = true;
 }
 
 FlutterApplication::~FlutterApplication() {
-  if (engine_ == nullptr) {
-    return;
+  StopReadingInputEvents();
+
+  // The waiter may belong to the render delegate, which can outlive the
+  // engine. Its callbacks must not reach the engine while it shuts down.
+  {
+    std::lock_guard<std::mutex> lock(vsync_mutex_);
+    vsync_stopped_ = true;
+  }
+  if (vsync_waiter_ != nullptr) {
+    vsync_waiter_->CancelVsync();
   }
 
-  auto result = FlutterEngineShutdown(engine_);
+  if (engine_ != nullptr) {
+    // Responses answered and frames submitted from other threads are dropped
+    // from now on.
+    platform_message_dispatcher_.SetEngine(nullptr);
+    if (external_textures_) {
+      external_textures_->RetireTextures();
+    }
+    if (FlutterEngineShutdown(engine_) != kSuccess) {
+      FLWAY_ERROR << "Could not shutdown the Flutter engine." << std::endl;
+    }
+    render_delegate_.OnApplicationShutdown();
+    ReleaseExternalTextures();
+  }
 
-  if (result != kSuccess) {
-    FLWAY_ERROR << "Could not shutdown the Flutter engine." << std::endl;
+  // Tasks the engine posted but never got to run.
+  task_token_.reset();
+
+  if (aot_data_ != nullptr) {
+    FlutterEngineCollectAOTData(aot_data_);
+  }
+}
+
+bool FlutterApplication::LoadDartCode(const std::string &bundle_path,
+                                      FlutterProjectArgs &args) {
+  // Debug and profile engines run the kernel blob from the assets path.
+  if (!FlutterEngineRunsAOTCompiledDartCode()) {
+    if (!FileExistsAtPath(bundle_path + "/" + kKernelBlobFileName)) {
+      FLWAY_ERROR << "The engine runs Dart code in JIT mode but the bundle "
+                     "has no kernel blob."
+                  << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  switch (GetBundleCodeType(bundle_path)) {
+  case BundleCodeType::kAOTELF: {
+    const auto elf_path = bundle_path + "/" + kAppELFFileName;
+    FlutterEngineAOTDataSource source = {};
+    source.type = kFlutterEngineAOTDataSourceTypeElfPath;
+    source.elf_path = elf_path.c_str();
+    if (FlutterEngineCreateAOTData(&source, &aot_data_) != kSuccess) {
+      FLWAY_ERROR << "Could not load AOT data from " << elf_path << std::endl;
+      return false;
+    }
+    args.aot_data = aot_data_;
+    return true;
   }
+  case BundleCodeType::kAOTSnapshots:
+    break;
+  case BundleCodeType::kKernel:
+  case BundleCodeType::kNone:
+    FLWAY_ERROR << "The engine runs AOT compiled Dart code but the bundle has "
+                   "no AOT snapshots."
+                << std::endl;
+    return false;
+  }
+
+  // The blobs are mapped in place rather than copied. Instructions are mapped
+  // executable because the engine runs them from the mapping.
+  struct Snapshot {
+    const char *file_name;
+    bool executable;
+    const uint8_t **mapping;
+    size_t *size;
+  } snapshots[] = {
+      {kVMSnapshotDataFileName, false, &args.vm_snapshot_data,
+       &args.vm_snapshot_data_size},
+      {kVMSnapshotInstructionsFileName, true, &args.vm_snapshot_instructions,
+       &args.vm_snapshot_instructions_size},
+      {kIsolateSnapshotDataFileName, false, &args.isolate_snapshot_data,
+       &args.isolate_snapshot_data_size},
+      {kIsolateSnapshotInstructionsFileName, true,
+       &args.isolate_snapshot_instructions,
+       &args.isolate_snapshot_instructions_size},
+  };
+
+  for (const auto &snapshot : snapshots) {
+    auto file = std::make_unique<MappedFile>(
+        bundle_path + "/" + snapshot.file_name, snapshot.executable);
+    if (!file->IsValid() || file->GetSize() == 0) {
+      FLWAY_ERROR << "Could not map the AOT snapshot " << snapshot.file_name
+                  << std::endl;
+      return false;
+    }
+    *snapshot.mapping = file->GetMapping();
+    *snapshot.size = file->GetSize();
+    snapshot_mappings_.push_back(std::move(file));
+  }
+
+  return true;
 }
 
 bool FlutterApplication::IsValid() const { return valid_; }
 
+FrameStats &FlutterApplication::GetFrameStats() { return frame_stats_; }
+
+PlatformMessageDispatcher &FlutterApplication::GetPlatformMessageDispatcher() {
+  return platform_message_dispatcher_;
+}
+
+std::shared_ptr<ExternalTexture> FlutterApplication::RegisterExternalTexture(
+    const ExternalTexture::Config &config) {
+  if (!valid_ || !external_textures_) {
+    FLWAY_ERROR << "External textures are not available." << std::endl;
+    return nullptr;
+  }
+  return external_textures_->RegisterTexture(config);
+}
+
+bool FlutterApplication::UnregisterExternalTexture(int64_t texture_id) {
+  return external_textures_ &&
+         external_textures_->UnregisterTexture(texture_id);
+}
+
+void FlutterApplication::CollectRetiredTextures() {
+  if (external_textures_) {
+    external_textures_->CollectRetiredTextures();
+  }
+}
+
+void FlutterApplication::ReleaseExternalTextures() {
+  if (!external_textures_) {
+    return;
+  }
+  // The raster thread is gone. The resource context shares the textures and
+  // was just replaced, so it isn't current on any other thread.
+  if (!render_delegate_.OnApplicationMakeResourceCurrent() &&
+      !render_delegate_.OnApplicationContextMakeCurrent()) {
+    FLWAY_ERROR << "Could not release the external textures." << std::endl;
+    return;
+  }
+  external_textures_->Shutdown();
+  render_delegate_.OnApplicationContextClearCurrent();
+}
+
+bool FlutterApplication::NotifyMemoryPressure() {
+  if (!valid_) {
+    return false;
+  }
+  // flutter/system uses the JSON message codec.
+  static const char kMessage[] = R"({"type":"memoryPressure"})";
+  frame_stats_.RecordMemoryPressure();
+  return platform_message_dispatcher_.Send(
+      "flutter/system", reinterpret_cast<const uint8_t *>(kMessage),
+      sizeof(kMessage) - 1);
+}
+
+bool FlutterApplication::PushRoute(const std::string &route) {
+  if (!valid_) {
+    return false;
+  }
+  // flutter/navigation uses the JSON method codec.
+  std::string message = R"({"method":"pushRoute","args":")";
+  for (const char c : route) {
+    if (c == '"' || c == '\\') {
+      message += '\\';
+    }
+    message += c;
+  }
+  message += "\"}";
+  return platform_message_dispatcher_.Send(
+      "flutter/navigation", reinterpret_cast<const uint8_t *>(message.data()),
+      message.size());
+}
+
 bool FlutterApplication::SetWindowSize(size_t width, size_t height) {
+  window_width_ = width;
+  window_height_ = height;
   FlutterWindowMetricsEvent event = {};
   event.struct_size = sizeof(event);
   event.width = width;
@@ -130,53 +443,205 @@ bool FlutterApplication::SetWindowSize(size_t width, size_t height) {
   return FlutterEngineSendWindowMetricsEvent(engine_, &event) == kSuccess;
 }
 
-void FlutterApplication::ProcessEvents() {
-  __FlutterEngineFlushPendingTasksNow();
+void FlutterApplication::SetInputRecordingPath(std::string path) {
+  input_recording_path_ = std::move(path);
 }
 
-bool FlutterApplication::SendPointerEvent(int button, int x, int y) {
-  if (!valid_) {
-    FLWAY_ERROR << "Pointer events on an invalid application." << std::endl;
+std::unique_ptr<PointerEventQueue> FlutterApplication::CreatePointerQueue() {
+  auto queue = std::make_unique<PointerEventQueue>(
+      kPointerFrameIntervalNanos,
+      [this](const FlutterPointerEvent *events, size_t count,
+             uint64_t oldest_timestamp) {
+        DispatchPointerEvents(events, count, oldest_timestamp);
+      });
+  if (!queue->IsValid()) {
+    return nullptr;
+  }
+
+  if (!event_loop_.AddFD(queue->GetWakeupFD(), EPOLLIN,
+                         [this](uint32_t) { DrainPointerQueue(); })) {
+    return nullptr;
+  }
+  return queue;
+}
+
+InputReader::Delegate *FlutterApplication::AcceptInputEvents() {
+  if (pointer_queue_) {
+    FLWAY_ERROR << "Input is already being read." << std::endl;
+    return nullptr;
+  }
+
+  auto queue = CreatePointerQueue();
+  if (!queue) {
+    FLWAY_ERROR << "Could not setup the input reader." << std::endl;
+    return nullptr;
+  }
+
+  InputReader::Delegate *delegate = queue.get();
+  std::unique_ptr<InputRecorder> recorder;
+  if (!input_recording_path_.empty()) {
+    recorder = std::make_unique<InputRecorder>(
+        *queue, input_recording_path_, window_width_, window_height_);
+    if (!recorder->IsValid()) {
+      FLWAY_ERROR << "Could not setup the input recorder." << std::endl;
+      event_loop_.RemoveFD(queue->GetWakeupFD());
+      return nullptr;
+    }
+    delegate = recorder.get();
+  }
+
+  pointer_queue_ = std::move(queue);
+  input_recorder_ = std::move(recorder);
+  return delegate;
+}
+
+InputReader::Delegate *FlutterApplication::AcceptKeyEvents() {
+  if (key_queue_) {
+    FLWAY_ERROR << "Key events are already being read." << std::endl;
+    return nullptr;
+  }
+
+  auto queue = std::make_unique<KeyEventQueue>(
+      event_loop_,
+      [this](const uint8_t *message, size_t size, uint64_t timestamp) {
+        if (!valid_) {
+          return;
+        }
+        frame_stats_.RecordInputEvent(timestamp);
+        platform_message_dispatcher_.Send("flutter/keyevent", message, size);
+      });
+  if (!queue->IsValid()) {
+    FLWAY_ERROR << "Could not setup the key event queue." << std::endl;
+    return nullptr;
+  }
+
+  key_queue_ = std::move(queue);
+  return key_queue_.get();
+}
+
+bool FlutterApplication::ReadInputEvents() {
+  if (input_thread_.joinable()) {
+    return input_reader_ != nullptr;
+  }
+
+  auto delegate = AcceptInputEvents();
+  if (delegate == nullptr) {
     return false;
   }
 
-  // Simple hover event. Nothing to do.
-  if (last_button_ == 0 && button == 0) {
-    return true;
+  auto reader =
+      std::make_unique<InputReader>(*delegate, window_width_, window_height_);
+  if (!reader->IsValid()) {
+    FLWAY_ERROR << "Could not setup the input reader." << std::endl;
+    StopReadingInputEvents();
+    return false;
   }
 
-  FlutterPointerPhase phase = kCancel;
+  input_reader_ = std::move(reader);
+  input_thread_ = std::thread([this]() {
+    ApplyThreadPolicyOnce(ThreadRole::kInput);
+    input_reader_->Run();
+  });
+  return true;
+}
 
-  if (last_button_ == 0 && button != 0) {
-    phase = kDown;
-  } else if (last_button_ == button) {
-    phase = kMove;
-  } else {
-    phase = kUp;
+bool FlutterApplication::ReplayInputEvents(const std::string &path,
+                                           bool real_time,
+                                           std::function<void()> on_done) {
+  if (pointer_queue_) {
+    FLWAY_ERROR << "Input is already being read." << std::endl;
+    return false;
+  }
+
+  auto queue = CreatePointerQueue();
+  if (!queue) {
+    FLWAY_ERROR << "Could not setup the input replay." << std::endl;
+    return false;
   }
 
-  last_button_ = button;
-  return SendFlutterPointerEvent(phase, x, y);
+  auto replayer = std::make_unique<InputReplayer>(
+      *queue, path, window_width_, window_height_, real_time);
+  if (!replayer->IsValid()) {
+    event_loop_.RemoveFD(queue->GetWakeupFD());
+    return false;
+  }
+
+  pointer_queue_ = std::move(queue);
+  input_replayer_ = std::move(replayer);
+  std::weak_ptr<bool> token = task_token_;
+  input_thread_ = std::thread([this, token, on_done]() {
+    ApplyThreadPolicyOnce(ThreadRole::kInput);
+    if (input_replayer_->Run() && on_done) {
+      event_loop_.PostTask([token, on_done]() {
+        if (!token.expired()) {
+          on_done();
+        }
+      });
+    }
+  });
+  return true;
 }
 
-bool FlutterApplication::SendFlutterPointerEvent(FlutterPointerPhase phase,
-                                                 double x, double y) {
-  FlutterPointerEvent event = {};
-  event.struct_size = sizeof(event);
-  event.phase = phase;
-  event.x = x;
-  event.y = y;
-  event.timestamp =
-      std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::high_resolution_clock::now().time_since_epoch())
-          .count();
-  return FlutterEngineSendPointerEvent(engine_, &event, 1) == kSuccess;
-}
-
-void FlutterApplication::ReadInputEvents() {
-  // TODO(chinmaygarde): Fill this in for touch screen and not just devices that
-  // fake mice.
-  ::sleep(INT_MAX);
+void FlutterApplication::StopReadingInputEvents() {
+  if (input_thread_.joinable()) {
+    if (input_reader_) {
+      input_reader_->Terminate();
+    }
+    if (input_replayer_) {
+      input_replayer_->Terminate();
+    }
+    input_thread_.join();
+  }
+
+  key_queue_.reset();
+
+  if (!pointer_queue_) {
+    return;
+  }
+  event_loop_.RemoveFD(pointer_queue_->GetWakeupFD());
+  input_reader_.reset();
+  input_recorder_.reset();
+  input_replayer_.reset();
+  pointer_queue_.reset();
+}
+
+void FlutterApplication::DrainPointerQueue() {
+  if (!pointer_queue_) {
+    return;
+  }
+
+  const auto deadline = pointer_queue_->Dispatch();
+
+  // Coalesced moves become due later. Come back for them unless a wakeup is
+  // already scheduled.
+  if (deadline != 0 && !pointer_dispatch_scheduled_) {
+    pointer_dispatch_scheduled_ = true;
+    std::weak_ptr<bool> token = task_token_;
+    event_loop_.PostTask(
+        [this, token]() {
+          if (token.expired()) {
+            return;
+          }
+          pointer_dispatch_scheduled_ = false;
+          DrainPointerQueue();
+        },
+        deadline);
+  }
+}
+
+void FlutterApplication::DispatchPointerEvents(
+    const FlutterPointerEvent *events, size_t count,
+    uint64_t oldest_timestamp) {
+  if (!valid_) {
+    FLWAY_ERROR << "Pointer events on an invalid application." << std::endl;
+    return;
+  }
+
+  frame_stats_.RecordInputEvent(oldest_timestamp);
+
+  if (FlutterEngineSendPointerEvent(engine_, events, count) != kSuccess) {
+    FLWAY_ERROR << "Could not send pointer events to the engine." << std::endl;
+  }
 }
 
 } // namespace flutter
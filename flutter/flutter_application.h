@@ -7,50 +7,194 @@
 #include <flutter_embedder.h>
 
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "event_loop.h"
+#include "external_texture.h"
+#include "frame_stats.h"
+#include "input_reader.h"
+#include "input_recording.h"
 #include "macros.h"
+#include "mapped_file.h"
+#include "platform_message_dispatcher.h"
 
 namespace flutter {
 
+class KeyEventQueue;
+class PointerEventQueue;
+class ShaderCache;
+class TimerVsyncWaiter;
+class VsyncWaiter;
+
 class FlutterApplication {
 public:
   class RenderDelegate {
   public:
-    virtual bool OnApplicationContextMakeCurrent() = 0;
+    virtual ~RenderDelegate() = default;
+
+    // Delegates that render with OpenGL implement the context and FBO
+    // callbacks. Software delegates return |kSoftware| and only implement
+    // |OnApplicationSoftwarePresent|.
+    virtual FlutterRendererType GetRendererType() const { return kOpenGL; }
+
+    virtual bool OnApplicationContextMakeCurrent() { return false; }
+
+    virtual bool OnApplicationContextClearCurrent() { return false; }
+
+    // Makes a context that shares resources with the onscreen one current on
+    // the calling thread, which is the engine's IO thread. Delegates without
+    // one return false and the engine uploads textures on the raster thread.
+    virtual bool OnApplicationMakeResourceCurrent() { return false; }
+
+    virtual bool OnApplicationPresent() { return false; }
 
-    virtual bool OnApplicationContextClearCurrent() = 0;
+    virtual uint32_t OnApplicationGetOnscreenFBO() { return 0; }
 
-    virtual bool OnApplicationPresent() = 0;
+    virtual void *GetProcAddress(const char *) { return nullptr; }
 
-    virtual uint32_t OnApplicationGetOnscreenFBO() = 0;
+    // OpenGL delegates that can present partial updates return true. The
+    // engine then reports which parts of each frame changed and asks which
+    // parts of the buffer it is about to render into are out of date.
+    virtual bool SupportsPartialPresent() const { return false; }
 
-    virtual void *GetProcAddress(const char *) = 0;
+    // Called instead of |OnApplicationPresent| when partial present is
+    // supported. Rects have a top left origin.
+    virtual bool OnApplicationPresentWithDamage(const FlutterDamage &damage) {
+      return false;
+    }
+
+    // Sets |damage| to the area of the next buffer that must be repainted.
+    // The rects must remain valid until the next present.
+    virtual void OnApplicationGetBufferDamage(FlutterDamage &damage) {}
+
+    virtual bool OnApplicationSoftwarePresent(const void *allocation,
+                                              size_t row_bytes, size_t height) {
+      return false;
+    }
+
+    // Delegates that know when their display refreshes return a waiter for
+    // it. Otherwise vsync is emulated with a timer.
+    virtual VsyncWaiter *GetVsyncWaiter() { return nullptr; }
+
+    // Called on the platform thread once the engine has shut down. Delegates
+    // that are handed to another application afterwards replace whatever the
+    // engine's threads left current, since those threads exited without
+    // releasing it.
+    virtual void OnApplicationShutdown() {}
   };
 
+  // The engine's platform tasks are run on |event_loop|, which must have been
+  // created on the calling thread. Compiled shaders are kept in
+  // |shader_cache|, if any, which must outlive the application.
   FlutterApplication(std::string bundle_path,
                      const std::vector<std::string> &args,
-                     RenderDelegate &render_delegate);
+                     RenderDelegate &render_delegate, EventLoop &event_loop,
+                     const ShaderCache *shader_cache = nullptr);
 
   ~FlutterApplication();
 
   bool IsValid() const;
 
-  void ProcessEvents();
-
   bool SetWindowSize(size_t width, size_t height);
 
-  bool SendPointerEvent(int button, int x, int y);
+  FrameStats &GetFrameStats();
 
-  void ReadInputEvents();
+  // Channels for talking to Dart code. Handlers run on the event loop.
+  PlatformMessageDispatcher &GetPlatformMessageDispatcher();
+
+  // Registers a texture that Dart code can show with a |Texture| widget using
+  // the returned texture's ID. Only OpenGL render delegates support external
+  // textures. Must be called on the event loop.
+  std::shared_ptr<ExternalTexture>
+  RegisterExternalTexture(const ExternalTexture::Config &config);
+
+  // Must be called on the event loop.
+  bool UnregisterExternalTexture(int64_t texture_id);
+
+  // Tells Dart code the system is low on memory so that the framework drops
+  // its image and font caches. Must be called on the event loop.
+  bool NotifyMemoryPressure();
+
+  // Asks the application's navigator to show the named route. Must be called
+  // on the event loop.
+  bool PushRoute(const std::string &route);
+
+  // Makes |ReadInputEvents| record the input it reads to |path| for
+  // |ReplayInputEvents|. Must be called before |ReadInputEvents|.
+  void SetInputRecordingPath(std::string path);
+
+  // Starts reading touch and mouse input from evdev devices on a background
+  // thread. Events are forwarded to the engine from the event loop.
+  bool ReadInputEvents();
+
+  // Forwards pointer events from a reader that isn't the application's own,
+  // such as one shared by several applications, to the engine from the event
+  // loop. Returns the delegate the reader should hand events to on its
+  // thread, or null. The reader must be stopped before the application is
+  // destroyed.
+  InputReader::Delegate *AcceptInputEvents();
+
+  // Sends key events from such a reader to Dart code as flutter/keyevent
+  // messages from the event loop, repeating held keys. Returns the delegate
+  // the reader should hand key events to on its thread, or null. The reader
+  // must be stopped before the application is destroyed.
+  InputReader::Delegate *AcceptKeyEvents();
+
+  // Feeds a recording to the engine instead of reading input devices, either
+  // with the original timing or as fast as the embedder takes it. |on_done|
+  // is invoked on the event loop after the last event has been queued.
+  bool ReplayInputEvents(const std::string &path, bool real_time,
+                         std::function<void()> on_done);
 
 private:
-  bool valid_;
+  bool valid_ = false;
   RenderDelegate &render_delegate_;
+  EventLoop &event_loop_;
   FlutterEngine engine_ = nullptr;
-  int last_button_ = 0;
-
-  bool SendFlutterPointerEvent(FlutterPointerPhase phase, double x, double y);
+  size_t window_width_ = 0;
+  size_t window_height_ = 0;
+  std::unique_ptr<PointerEventQueue> pointer_queue_;
+  std::unique_ptr<KeyEventQueue> key_queue_;
+  std::unique_ptr<InputReader> input_reader_;
+  std::string input_recording_path_;
+  std::unique_ptr<InputRecorder> input_recorder_;
+  std::unique_ptr<InputReplayer> input_replayer_;
+  std::thread input_thread_;
+  bool pointer_dispatch_scheduled_ = false;
+  std::unique_ptr<TimerVsyncWaiter> timer_vsync_waiter_;
+  VsyncWaiter *vsync_waiter_ = nullptr;
+  // Keeps the engine from asking for vsync once shutdown has begun.
+  std::mutex vsync_mutex_;
+  bool vsync_stopped_ = false;
+  // Tasks posted to the event loop are dropped once this is gone, since the
+  // loop outlives the application when the engine is restarted.
+  std::shared_ptr<bool> task_token_;
+  FrameStats frame_stats_;
+  PlatformMessageDispatcher platform_message_dispatcher_;
+  std::unique_ptr<ExternalTextureRegistry> external_textures_;
+  // AOT code the engine refers to until it is shut down.
+  std::vector<std::unique_ptr<MappedFile>> snapshot_mappings_;
+  FlutterEngineAOTData aot_data_ = nullptr;
+
+  bool LoadDartCode(const std::string &bundle_path, FlutterProjectArgs &args);
+
+  void DispatchPointerEvents(const FlutterPointerEvent *events, size_t count,
+                             uint64_t oldest_timestamp);
+
+  std::unique_ptr<PointerEventQueue> CreatePointerQueue();
+
+  void DrainPointerQueue();
+
+  void StopReadingInputEvents();
+
+  // Called on the raster thread before presenting.
+  void CollectRetiredTextures();
+
+  // Called once the engine has shut down.
+  void ReleaseExternalTextures();
 
   FLWAY_DISALLOW_COPY_AND_ASSIGN(FlutterApplication);
 };
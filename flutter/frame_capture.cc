@@ -0,0 +1,336 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "frame_capture.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+// One buffer is read into while another is encoded and a third waits.
+static const size_t kFrameBufferCount = 3;
+
+FrameCapture::FrameCapture(const std::string &path, size_t max_frames)
+    : path_(path), max_frames_(max_frames), entries_(kFrameBufferCount) {
+  file_ = ::fopen(path_.c_str(), "we");
+  if (file_ == nullptr) {
+    FLWAY_ERROR << "Could not open " << path_
+                << " for frame capture: " << strerror(errno) << std::endl;
+    return;
+  }
+
+  worker_ = std::thread([this]() { Work(); });
+}
+
+FrameCapture::~FrameCapture() {
+  if (worker_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminated_ = true;
+    }
+    queued_condition_.notify_one();
+    worker_.join();
+  }
+
+  if (file_ != nullptr) {
+    ::fclose(file_);
+    FLWAY_LOG << "Captured " << written_count_ << " frames to " << path_
+              << ". Skipped " << skipped_count_ << "." << std::endl;
+  }
+}
+
+bool FrameCapture::IsValid() const { return file_ != nullptr; }
+
+FrameCapture::Frame *FrameCapture::AcquireFrame(size_t width, size_t height,
+                                                PixelFormat format,
+                                                bool bottom_up) {
+  if (BytesPerPixel(format) != 4 || width == 0 || height == 0) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_ == nullptr || terminated_ ||
+      (max_frames_ != 0 && accepted_count_ >= max_frames_)) {
+    return nullptr;
+  }
+
+  for (auto &entry : entries_) {
+    if (entry.state != State::kFree) {
+      continue;
+    }
+    // Buffers only grow, and only when the surface does.
+    const size_t size = width * height * 4;
+    if (entry.capacity < size) {
+      entry.storage.reset(new uint8_t[size]);
+      entry.capacity = size;
+    }
+    entry.state = State::kAcquired;
+    entry.frame.pixels = entry.storage.get();
+    entry.frame.width = width;
+    entry.frame.height = height;
+    entry.frame.format = format;
+    entry.frame.bottom_up = bottom_up;
+    accepted_count_++;
+    entry.frame.last = max_frames_ != 0 && accepted_count_ == max_frames_;
+    return &entry.frame;
+  }
+
+  skipped_count_++;
+  return nullptr;
+}
+
+FrameCapture::Entry *FrameCapture::FindEntryLocked(Frame *frame) {
+  for (auto &entry : entries_) {
+    if (&entry.frame == frame && entry.state == State::kAcquired) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void FrameCapture::SubmitFrame(Frame *frame) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = FindEntryLocked(frame);
+    if (entry == nullptr) {
+      return;
+    }
+    entry->state = State::kQueued;
+    queue_.push_back(entry);
+  }
+  queued_condition_.notify_one();
+}
+
+void FrameCapture::CancelFrame(Frame *frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto entry = FindEntryLocked(frame)) {
+    entry->state = State::kFree;
+    accepted_count_--;
+  }
+}
+
+void FrameCapture::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queued_condition_.wait(lock,
+                           [this]() { return terminated_ || !queue_.empty(); });
+    // Frames already queued are written before exiting.
+    if (queue_.empty()) {
+      return;
+    }
+
+    auto entry = queue_.front();
+    queue_.pop_front();
+
+    lock.unlock();
+    const bool written = Write(entry->frame);
+    lock.lock();
+
+    entry->state = State::kFree;
+    if (!written) {
+      // Keep the frames written so far. Nothing more is accepted.
+      terminated_ = true;
+      queue_.clear();
+      return;
+    }
+  }
+}
+
+bool FrameCapture::Write(const Frame &frame) {
+  const size_t size = EncodeQOI(frame, encoded_);
+  if (::fwrite(encoded_.data(), 1, size, file_) != size ||
+      ::fflush(file_) != 0) {
+    FLWAY_ERROR << "Could not write a captured frame: " << strerror(errno)
+                << std::endl;
+    return false;
+  }
+  written_count_++;
+  return true;
+}
+
+static uint32_t ReadBigEndian32(const uint8_t *input) {
+  return static_cast<uint32_t>(input[0]) << 24 | input[1] << 16 |
+         input[2] << 8 | input[3];
+}
+
+static uint8_t *WriteBigEndian32(uint8_t *output, uint32_t value) {
+  output[0] = value >> 24;
+  output[1] = value >> 16;
+  output[2] = value >> 8;
+  output[3] = value;
+  return output + 4;
+}
+
+// See https://qoiformat.org/qoi-specification.pdf. Captured frames are opaque
+// so only the three channel operations are used.
+size_t EncodeQOI(const FrameCapture::Frame &frame,
+                 std::vector<uint8_t> &output) {
+  const size_t pixel_count = frame.width * frame.height;
+  // The header, four bytes per pixel at worst and the end marker. The buffer
+  // is reused and never shrinks.
+  const size_t max_size = 14 + pixel_count * 4 + 8;
+  if (output.size() < max_size) {
+    output.resize(max_size);
+  }
+
+  uint8_t *out = output.data();
+  ::memcpy(out, "qoif", 4);
+  out = WriteBigEndian32(out + 4, frame.width);
+  out = WriteBigEndian32(out, frame.height);
+  *out++ = 3; // Channels.
+  *out++ = 0; // sRGB with linear alpha.
+
+  const bool bgra = frame.format == PixelFormat::kBGRA8888;
+  const size_t red = bgra ? 2 : 0;
+  const size_t blue = bgra ? 0 : 2;
+  const size_t row_bytes = frame.width * 4;
+
+  uint32_t index[64] = {};
+  uint8_t previous[3] = {0, 0, 0};
+  size_t run = 0;
+
+  for (size_t y = 0; y < frame.height; ++y) {
+    const size_t row = frame.bottom_up ? frame.height - 1 - y : y;
+    const uint8_t *pixel = frame.pixels + row * row_bytes;
+    for (size_t x = 0; x < frame.width; ++x, pixel += 4) {
+      const uint8_t r = pixel[red];
+      const uint8_t g = pixel[1];
+      const uint8_t b = pixel[blue];
+
+      if (r == previous[0] && g == previous[1] && b == previous[2]) {
+        if (++run == 62) {
+          *out++ = 0xc0 | (run - 1);
+          run = 0;
+        }
+        continue;
+      }
+
+      if (run > 0) {
+        *out++ = 0xc0 | (run - 1);
+        run = 0;
+      }
+
+      const uint32_t packed =
+          static_cast<uint32_t>(r) << 24 | g << 16 | b << 8 | 0xff;
+      const size_t hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+      if (index[hash] == packed) {
+        *out++ = hash;
+      } else {
+        index[hash] = packed;
+        const int dr = static_cast<int8_t>(r - previous[0]);
+        const int dg = static_cast<int8_t>(g - previous[1]);
+        const int db = static_cast<int8_t>(b - previous[2]);
+        const int dr_dg = dr - dg;
+        const int db_dg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1) {
+          *out++ = 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+        } else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 &&
+                   db_dg >= -8 && db_dg <= 7) {
+          *out++ = 0x80 | (dg + 32);
+          *out++ = (dr_dg + 8) << 4 | (db_dg + 8);
+        } else {
+          *out++ = 0xfe;
+          *out++ = r;
+          *out++ = g;
+          *out++ = b;
+        }
+      }
+
+      previous[0] = r;
+      previous[1] = g;
+      previous[2] = b;
+    }
+  }
+
+  if (run > 0) {
+    *out++ = 0xc0 | (run - 1);
+  }
+
+  static const uint8_t kEndMarker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  ::memcpy(out, kEndMarker, sizeof(kEndMarker));
+  out += sizeof(kEndMarker);
+  return out - output.data();
+}
+
+bool DecodeQOI(const uint8_t *data, size_t size, std::vector<uint8_t> &pixels,
+               size_t *width, size_t *height) {
+  static const size_t kHeaderSize = 14;
+  static const size_t kEndMarkerSize = 8;
+  if (size < kHeaderSize + kEndMarkerSize || ::memcmp(data, "qoif", 4) != 0) {
+    return false;
+  }
+  const size_t image_width = ReadBigEndian32(data + 4);
+  const size_t image_height = ReadBigEndian32(data + 8);
+  // Far beyond any display, and small enough not to overflow.
+  if (image_width == 0 || image_height == 0 || image_width > 16384 ||
+      image_height > 16384) {
+    return false;
+  }
+
+  const size_t pixel_count = image_width * image_height;
+  pixels.resize(pixel_count * 4);
+
+  const uint8_t *in = data + kHeaderSize;
+  const uint8_t *const end = data + size - kEndMarkerSize;
+  uint8_t index[64][4] = {};
+  uint8_t pixel[4] = {0, 0, 0, 255};
+  size_t run = 0;
+
+  for (size_t i = 0; i < pixel_count; ++i) {
+    if (run > 0) {
+      run--;
+    } else {
+      if (in >= end) {
+        return false;
+      }
+      const uint8_t op = *in++;
+      if (op == 0xfe || op == 0xff) {
+        const size_t channels = op == 0xfe ? 3 : 4;
+        if (end - in < static_cast<ptrdiff_t>(channels)) {
+          return false;
+        }
+        ::memcpy(pixel, in, channels);
+        in += channels;
+      } else if ((op & 0xc0) == 0x00) {
+        ::memcpy(pixel, index[op], 4);
+      } else if ((op & 0xc0) == 0x40) {
+        pixel[0] += ((op >> 4) & 0x03) - 2;
+        pixel[1] += ((op >> 2) & 0x03) - 2;
+        pixel[2] += (op & 0x03) - 2;
+      } else if ((op & 0xc0) == 0x80) {
+        if (in >= end) {
+          return false;
+        }
+        const int dg = (op & 0x3f) - 32;
+        const uint8_t second = *in++;
+        pixel[0] += dg + ((second >> 4) & 0x0f) - 8;
+        pixel[1] += dg;
+        pixel[2] += dg + (second & 0x0f) - 8;
+      } else {
+        run = op & 0x3f;
+      }
+      ::memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 +
+                      pixel[3] * 11) %
+                     64],
+               pixel, 4);
+    }
+
+    uint8_t *out = pixels.data() + i * 4;
+    const uint32_t alpha = pixel[3];
+    out[0] = (pixel[2] * alpha + 127) / 255;
+    out[1] = (pixel[1] * alpha + 127) / 255;
+    out[2] = (pixel[0] * alpha + 127) / 255;
+    out[3] = alpha;
+  }
+
+  *width = image_width;
+  *height = image_height;
+  return true;
+}
+
+} // namespace flutter
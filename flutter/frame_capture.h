@@ -0,0 +1,109 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "macros.h"
+#include "pixel_converter.h"
+
+namespace flutter {
+
+// Compresses presented frames on a worker thread and writes them one after
+// another as QOI images to a file or FIFO. Frames are copied into a small pool
+// of buffers so that the raster thread never waits on the encoder or the disk.
+// Frames that arrive while every buffer is busy are skipped.
+class FrameCapture {
+public:
+  struct Frame {
+    // Tightly packed rows. Only 32 bit formats are supported.
+    uint8_t *pixels = nullptr;
+    size_t width = 0;
+    size_t height = 0;
+    PixelFormat format = PixelFormat::kRGBA8888;
+    // GL reads rows bottom up.
+    bool bottom_up = false;
+    // Set on the last frame the capture takes. Readers that deliver frames
+    // late should deliver this one right away.
+    bool last = false;
+  };
+
+  // Stops after |max_frames| frames, or never if zero. One frame makes a
+  // screenshot.
+  FrameCapture(const std::string &path, size_t max_frames);
+
+  ~FrameCapture();
+
+  bool IsValid() const;
+
+  // Returns a buffer to read a frame of this size into, or null if the frame
+  // should be skipped. Called on the raster thread.
+  Frame *AcquireFrame(size_t width, size_t height, PixelFormat format,
+                      bool bottom_up);
+
+  // Queues an acquired frame for encoding.
+  void SubmitFrame(Frame *frame);
+
+  // Returns an acquired frame unused.
+  void CancelFrame(Frame *frame);
+
+private:
+  enum class State { kFree, kAcquired, kQueued };
+
+  struct Entry {
+    Frame frame;
+    State state = State::kFree;
+    std::unique_ptr<uint8_t[]> storage;
+    size_t capacity = 0;
+  };
+
+  const std::string path_;
+  const size_t max_frames_;
+  FILE *file_ = nullptr;
+  std::thread worker_;
+
+  std::mutex mutex_;
+  std::condition_variable queued_condition_;
+  std::vector<Entry> entries_;
+  std::deque<Entry *> queue_;
+  // Frames accepted for encoding. Compared against |max_frames_|.
+  size_t accepted_count_ = 0;
+  size_t skipped_count_ = 0;
+  bool terminated_ = false;
+
+  // Only touched by the worker.
+  std::vector<uint8_t> encoded_;
+  size_t written_count_ = 0;
+
+  void Work();
+
+  bool Write(const Frame &frame);
+
+  Entry *FindEntryLocked(Frame *frame);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FrameCapture);
+};
+
+// Encodes |frame| as a QOI image with three channels into the start of
+// |output|, growing it if needed, and returns the encoded size. Exposed for
+// benchmarking.
+size_t EncodeQOI(const FrameCapture::Frame &frame,
+                 std::vector<uint8_t> &output);
+
+// Decodes a QOI image into tightly packed, premultiplied B, G, R, A pixels,
+// the layout of planes. Returns false if |data| is not a valid image.
+bool DecodeQOI(const uint8_t *data, size_t size, std::vector<uint8_t> &pixels,
+               size_t *width, size_t *height);
+
+} // namespace flutter
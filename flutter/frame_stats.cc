@@ -0,0 +1,224 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "frame_stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <sstream>
+
+#include "utils.h"
+
+namespace flutter {
+
+static const char *kSocketPrefix = "unix:";
+
+FrameStats::FrameStats() = default;
+
+FrameStats::~FrameStats() {
+  if (export_fd_ != -1) {
+    ::close(export_fd_);
+  }
+}
+
+void FrameStats::RecordMakeCurrent(uint64_t begin, uint64_t end) {
+  make_current_.Record((end - begin) / 1000);
+}
+
+void FrameStats::RecordPresent(uint64_t begin, uint64_t end) {
+  present_.Record((end - begin) / 1000);
+  frame_count_.fetch_add(1, std::memory_order_relaxed);
+
+  const auto last_end = last_present_end_.exchange(end);
+  if (last_end != 0) {
+    frame_interval_.Record((end - last_end) / 1000);
+  } else if (first_present_callback_) {
+    first_present_callback_(end);
+  }
+
+  const auto input = oldest_pending_input_micros_.exchange(0);
+  const auto end_micros = end / 1000;
+  if (input != 0 && end_micros > input) {
+    input_latency_.Record(end_micros - input);
+  }
+}
+
+void FrameStats::RecordInputEvent(uint64_t timestamp_micros) {
+  // Only the first event since the last present matters. It has waited the
+  // longest.
+  uint64_t expected = 0;
+  oldest_pending_input_micros_.compare_exchange_strong(expected,
+                                                       timestamp_micros);
+}
+
+void FrameStats::RecordMemoryPressure() {
+  memory_pressure_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameStats::SetFirstPresentCallback(
+    std::function<void(uint64_t end)> callback) {
+  first_present_callback_ = std::move(callback);
+}
+
+bool FrameStats::StartReporting(EventLoop &loop, double interval_seconds,
+                                std::string export_path) {
+  if (interval_seconds <= 0.0) {
+    FLWAY_ERROR << "Invalid frame stats interval." << std::endl;
+    return false;
+  }
+
+  loop_ = &loop;
+  report_token_ = std::make_shared<bool>(true);
+  interval_nanos_ = interval_seconds * 1e9;
+  export_path_ = std::move(export_path);
+
+  if (!export_path_.empty() && !OpenExport()) {
+    return false;
+  }
+
+  // Whatever the loop did before now isn't part of the first interval.
+  loop_->TakeStats();
+  last_report_time_ = GetMonotonicTimeNanos();
+  ScheduleReport(last_report_time_ + interval_nanos_);
+  return true;
+}
+
+void FrameStats::ReportNow() {
+  if (loop_ != nullptr) {
+    Report();
+  }
+}
+
+void FrameStats::ScheduleReport(uint64_t target_time) {
+  std::weak_ptr<bool> token = report_token_;
+  loop_->PostTask(
+      [this, token, target_time]() {
+        if (token.expired()) {
+          return;
+        }
+        Report();
+        ScheduleReport(target_time + interval_nanos_);
+      },
+      target_time);
+}
+
+bool FrameStats::OpenExport() {
+  if (export_path_.compare(0, strlen(kSocketPrefix), kSocketPrefix) != 0) {
+    export_fd_ = ::open(export_path_.c_str(),
+                        O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (export_fd_ == -1) {
+      FLWAY_ERROR << "Could not open " << export_path_
+                  << " for frame stats: " << strerror(errno) << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  const auto socket_path = export_path_.substr(strlen(kSocketPrefix));
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+    FLWAY_ERROR << "Invalid frame stats socket path." << std::endl;
+    return false;
+  }
+  ::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path));
+
+  export_fd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (export_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the frame stats socket." << std::endl;
+    return false;
+  }
+  export_to_socket_ = true;
+
+  // The listener may come and go. Failures here are retried on each send.
+  ::connect(export_fd_, reinterpret_cast<const sockaddr *>(&address),
+            sizeof(address));
+  return true;
+}
+
+void FrameStats::Export(const std::string &line) {
+  if (export_fd_ == -1) {
+    return;
+  }
+
+  if (export_to_socket_) {
+    // Datagrams are dropped if nobody is listening. Never block the loop.
+    ::send(export_fd_, line.data(), line.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    return;
+  }
+
+  if (::write(export_fd_, line.data(), line.size()) !=
+      static_cast<ssize_t>(line.size())) {
+    FLWAY_ERROR << "Could not write frame stats." << std::endl;
+  }
+}
+
+static void WriteSummary(std::ostream &stream, const char *name,
+                         const Histogram::Summary &summary) {
+  stream << "\"" << name << "\":{\"count\":" << summary.count
+         << ",\"p50\":" << summary.p50 << ",\"p95\":" << summary.p95
+         << ",\"p99\":" << summary.p99 << ",\"max\":" << summary.max << "}";
+}
+
+void FrameStats::Report() {
+  const auto frames = frame_count_.exchange(0);
+  const auto make_current = make_current_.TakeSummary();
+  const auto present = present_.TakeSummary();
+  const auto frame_interval = frame_interval_.TakeSummary();
+  const auto input_latency = input_latency_.TakeSummary();
+  const auto memory_pressure = memory_pressure_count_.exchange(0);
+
+  const auto now = GetMonotonicTimeNanos();
+  const auto loop_stats = loop_->TakeStats();
+  const double elapsed_seconds = (now - last_report_time_) / 1e9;
+  last_report_time_ = now;
+  // Rounded to a tenth.
+  const double wakeups_per_second =
+      std::round(loop_stats.wakeups * 10.0 / elapsed_seconds) / 10.0;
+  const double idle_percent =
+      std::round(loop_stats.idle_nanos / 1e6 / elapsed_seconds) / 10.0;
+
+  if (frames == 0 && input_latency.count == 0 && memory_pressure == 0) {
+    FLWAY_LOG << "Idle. Wakeups: " << wakeups_per_second
+              << "/s Asleep: " << idle_percent << "%" << std::endl;
+  } else {
+    FLWAY_LOG << "Frames: " << frames << " Interval p50/p95/p99: "
+              << frame_interval.p50 << "/" << frame_interval.p95 << "/"
+              << frame_interval.p99 << " us Present: " << present.p50 << "/"
+              << present.p95 << "/" << present.p99
+              << " us Input to present: " << input_latency.p50 << "/"
+              << input_latency.p95 << "/" << input_latency.p99 << " us"
+              << " Memory pressure: " << memory_pressure
+              << " Wakeups: " << wakeups_per_second << "/s Asleep: "
+              << idle_percent << "%" << std::endl;
+  }
+
+  if (export_fd_ == -1) {
+    return;
+  }
+
+  // Idle intervals are exported too. They are what power use is judged by.
+  std::stringstream stream;
+  stream << "{\"timestamp_us\":" << now / 1000 << ",\"frames\":" << frames
+         << ",";
+  WriteSummary(stream, "make_current_us", make_current);
+  stream << ",";
+  WriteSummary(stream, "present_us", present);
+  stream << ",";
+  WriteSummary(stream, "frame_interval_us", frame_interval);
+  stream << ",";
+  WriteSummary(stream, "input_to_present_us", input_latency);
+  stream << ",\"memory_pressure_events\":" << memory_pressure
+         << ",\"wakeups_per_second\":" << wakeups_per_second
+         << ",\"idle_percent\":" << idle_percent << "}\n";
+  Export(stream.str());
+}
+
+} // namespace flutter
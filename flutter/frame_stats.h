@@ -0,0 +1,91 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "event_loop.h"
+#include "histogram.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Per-frame timings collected on the raster thread and input latencies
+// collected as pointer events are sent to the engine. Recording is lock-free
+// and cheap enough to always be on. Summaries are produced on the event loop.
+class FrameStats {
+public:
+  FrameStats();
+
+  ~FrameStats();
+
+  // Called on the raster thread around the render delegate callbacks. Times
+  // are monotonic nanoseconds.
+  void RecordMakeCurrent(uint64_t begin, uint64_t end);
+
+  void RecordPresent(uint64_t begin, uint64_t end);
+
+  // Called as pointer events are handed to the engine. |timestamp_micros| is
+  // the time the event was generated. The latency recorded is from the oldest
+  // event not yet on screen to the end of the next present.
+  void RecordInputEvent(uint64_t timestamp_micros);
+
+  // Called each time the engine is told the system is low on memory.
+  void RecordMemoryPressure();
+
+  // Invoked on the raster thread at the end of the first present. Must be set
+  // before the engine can render, that is before the window size is set.
+  void SetFirstPresentCallback(std::function<void(uint64_t end)> callback);
+
+  // Logs a summary every |interval_seconds| on |loop|, along with how often
+  // the loop woke up and how long it slept. If |export_path| is not
+  // empty, each summary is also written as a line of JSON to that file, or to a
+  // Unix datagram socket if the path is of the form "unix:<path>".
+  bool StartReporting(EventLoop &loop, double interval_seconds,
+                      std::string export_path);
+
+  // Reports what was recorded since the last summary without waiting for the
+  // interval to end. Does nothing unless reporting was started. Must be called
+  // on the loop.
+  void ReportNow();
+
+private:
+  Histogram make_current_;
+  Histogram present_;
+  Histogram frame_interval_;
+  Histogram input_latency_;
+  std::atomic<uint64_t> frame_count_{0};
+  std::atomic<uint64_t> last_present_end_{0};
+  std::atomic<uint64_t> oldest_pending_input_micros_{0};
+  std::atomic<uint64_t> memory_pressure_count_{0};
+  std::function<void(uint64_t end)> first_present_callback_;
+
+  EventLoop *loop_ = nullptr;
+  uint64_t interval_nanos_ = 0;
+  uint64_t last_report_time_ = 0;
+  std::string export_path_;
+  int export_fd_ = -1;
+  bool export_to_socket_ = false;
+  // Scheduled reports are dropped once this is gone. The loop may outlive the
+  // stats when the engine is restarted.
+  std::shared_ptr<bool> report_token_;
+
+  void ScheduleReport(uint64_t target_time);
+
+  void Report();
+
+  bool OpenExport();
+
+  void Export(const std::string &line);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FrameStats);
+};
+
+} // namespace flutter
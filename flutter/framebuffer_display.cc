@@ -0,0 +1,274 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "framebuffer_display.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "frame_capture.h"
+
+namespace flutter {
+
+// The software renderer hands us Skia N32 premultiplied pixels. On little
+// endian Linux these are laid out as B, G, R, A in memory.
+static const PixelFormat kSoftwareSurfaceFormat = PixelFormat::kBGRA8888;
+
+// Older sysroots don't have a libc wrapper for memfd_create.
+static int CreateMemoryFD(const char *name) {
+#if defined(__NR_memfd_create)
+  return ::syscall(__NR_memfd_create, name, 0 /* flags */);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+FramebufferDisplay::FramebufferDisplay(const std::string &device_path) {
+  fd_ = ::open(device_path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd_ == -1) {
+    FLWAY_ERROR << "Could not open framebuffer device " << device_path
+                << std::endl;
+    return;
+  }
+
+  fb_var_screeninfo var_info = {};
+  fb_fix_screeninfo fix_info = {};
+  if (::ioctl(fd_, FBIOGET_VSCREENINFO, &var_info) == -1 ||
+      ::ioctl(fd_, FBIOGET_FSCREENINFO, &fix_info) == -1) {
+    FLWAY_ERROR << "Could not query framebuffer screen info." << std::endl;
+    return;
+  }
+
+  switch (var_info.bits_per_pixel) {
+  case 16:
+    format_ = PixelFormat::kRGB565;
+    break;
+  case 32:
+    format_ = var_info.red.offset == 0 ? PixelFormat::kRGBA8888
+                                       : PixelFormat::kBGRA8888;
+    break;
+  default:
+    FLWAY_ERROR << "Unsupported framebuffer depth: "
+                << var_info.bits_per_pixel << std::endl;
+    return;
+  }
+
+  width_ = var_info.xres;
+  height_ = var_info.yres;
+  row_bytes_ = fix_info.line_length;
+  mapping_offset_ = var_info.yoffset * row_bytes_ +
+                    var_info.xoffset * BytesPerPixel(format_);
+
+  if (width_ == 0 || height_ == 0) {
+    FLWAY_ERROR << "Invalid framebuffer size: " << width_ << " x " << height_
+                << std::endl;
+    return;
+  }
+
+  if (!MapMemory(fix_info.smem_len)) {
+    return;
+  }
+
+  if (mapping_offset_ + row_bytes_ * height_ > mapping_size_) {
+    FLWAY_ERROR << "Framebuffer memory is smaller than the visible area."
+                << std::endl;
+    return;
+  }
+
+  FLWAY_LOG << "Framebuffer " << device_path << ": " << width_ << " x "
+            << height_ << " " << PixelFormatToString(format_) << std::endl;
+
+  valid_ = true;
+}
+
+FramebufferDisplay::FramebufferDisplay(size_t width, size_t height,
+                                       PixelFormat format)
+    : width_(width), height_(height),
+      row_bytes_(width * BytesPerPixel(format)), format_(format) {
+  if (width_ == 0 || height_ == 0) {
+    FLWAY_ERROR << "Invalid framebuffer size: " << width_ << " x " << height_
+                << std::endl;
+    return;
+  }
+
+  fd_ = CreateMemoryFD("flutter_framebuffer");
+  if (fd_ == -1) {
+    FLWAY_ERROR << "Could not create the shared memory framebuffer."
+                << std::endl;
+    return;
+  }
+
+  const size_t size = row_bytes_ * height_;
+  if (::ftruncate(fd_, size) == -1) {
+    FLWAY_ERROR << "Could not size the shared memory framebuffer."
+                << std::endl;
+    return;
+  }
+
+  if (!MapMemory(size)) {
+    return;
+  }
+
+  valid_ = true;
+}
+
+FramebufferDisplay::~FramebufferDisplay() {
+  if (frame_count_ > 0) {
+    const auto copied_percent =
+        copied_tile_count_ * 100 / std::max<size_t>(total_tile_count_, 1);
+    FLWAY_LOG << "Presented " << frame_count_ << " frames. Average blit: "
+              << total_blit_nanos_ / frame_count_ / 1000 << " us. Copied "
+              << copied_percent << "% of tiles." << std::endl;
+  }
+
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  }
+
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool FramebufferDisplay::MapMemory(size_t size) {
+  auto mapping =
+      ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    FLWAY_ERROR << "Could not map framebuffer memory." << std::endl;
+    return false;
+  }
+  mapping_ = reinterpret_cast<uint8_t *>(mapping);
+  mapping_size_ = size;
+  return true;
+}
+
+// |Display|
+bool FramebufferDisplay::IsValid() const { return valid_; }
+
+// |Display|
+size_t FramebufferDisplay::GetWidth() const { return width_; }
+
+// |Display|
+size_t FramebufferDisplay::GetHeight() const { return height_; }
+
+PixelFormat FramebufferDisplay::GetPixelFormat() const { return format_; }
+
+int FramebufferDisplay::GetMemoryFD() const { return fd_; }
+
+// |Display|
+bool FramebufferDisplay::SetFrameCapture(FrameCapture *capture) {
+  frame_capture_ = capture;
+  return true;
+}
+
+// |Display|
+PlaneAllocator *FramebufferDisplay::GetPlaneAllocator() {
+  if (!valid_) {
+    return nullptr;
+  }
+  if (!planes_) {
+    // Commits present from whichever thread made them. The allocator's lock
+    // keeps them from interleaving with frames.
+    planes_ = std::make_unique<SoftwarePlaneAllocator>(
+        width_, height_,
+        [this](const uint8_t *pixels, size_t row_bytes,
+               const DamageRect &area) { WriteRect(pixels, row_bytes, area); });
+  }
+  return planes_.get();
+}
+
+bool FramebufferDisplay::WriteRect(const uint8_t *pixels, size_t row_bytes,
+                                   const DamageRect &rect) {
+  auto destination = mapping_ + mapping_offset_ + rect.y * row_bytes_ +
+                     rect.x * BytesPerPixel(format_);
+  return ConvertPixels(pixels, row_bytes, kSoftwareSurfaceFormat, destination,
+                       row_bytes_, format_, rect.width, rect.height);
+}
+
+void FramebufferDisplay::CaptureFrame(const void *allocation,
+                                      size_t row_bytes, size_t width,
+                                      size_t height) {
+  // The engine's buffer is in memory already, so a copy is all it takes.
+  auto frame = frame_capture_->AcquireFrame(width, height,
+                                            kSoftwareSurfaceFormat, false);
+  if (frame == nullptr) {
+    return;
+  }
+  const size_t frame_row_bytes = width * BytesPerPixel(kSoftwareSurfaceFormat);
+  for (size_t row = 0; row < height; ++row) {
+    ::memcpy(frame->pixels + row * frame_row_bytes,
+             reinterpret_cast<const uint8_t *>(allocation) + row * row_bytes,
+             frame_row_bytes);
+  }
+  frame_capture_->SubmitFrame(frame);
+}
+
+// |FlutterApplication::RenderDelegate|
+FlutterRendererType FramebufferDisplay::GetRendererType() const {
+  return kSoftware;
+}
+
+// |FlutterApplication::RenderDelegate|
+bool FramebufferDisplay::OnApplicationSoftwarePresent(const void *allocation,
+                                                      size_t row_bytes,
+                                                      size_t height) {
+  if (!valid_) {
+    FLWAY_ERROR << "Cannot present an invalid display." << std::endl;
+    return false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  // The surface may lag behind a resize. Copy only what overlaps.
+  const size_t copy_width =
+      std::min(row_bytes / BytesPerPixel(kSoftwareSurfaceFormat), width_);
+  const size_t copy_height = std::min(height, height_);
+
+  // Reading the frame to find what changed is much cheaper than writing all of
+  // it to framebuffer memory, which is usually uncached.
+  const auto &damage = damage_tracker_.Update(allocation, row_bytes,
+                                              copy_width, copy_height);
+  const size_t source_pixel_bytes = BytesPerPixel(kSoftwareSurfaceFormat);
+  if (planes_) {
+    // Composited with the planes, which writes the result.
+    planes_->PresentApplicationFrame(allocation, row_bytes, damage);
+  } else {
+    for (const auto &rect : damage) {
+      auto source = reinterpret_cast<const uint8_t *>(allocation) +
+                    rect.y * row_bytes + rect.x * source_pixel_bytes;
+      if (!WriteRect(source, row_bytes, rect)) {
+        FLWAY_ERROR << "Could not convert the frame to the framebuffer format."
+                    << std::endl;
+        damage_tracker_.Invalidate();
+        return false;
+      }
+    }
+  }
+  if (frame_capture_ != nullptr) {
+    CaptureFrame(allocation, row_bytes, copy_width, copy_height);
+  }
+
+  total_tile_count_ += damage_tracker_.GetTileCount();
+  copied_tile_count_ += damage_tracker_.GetDamagedTileCount();
+
+  total_blit_nanos_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  frame_count_++;
+  return true;
+}
+
+} // namespace flutter
@@ -0,0 +1,94 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "damage_tracker.h"
+#include "display.h"
+#include "macros.h"
+#include "pixel_converter.h"
+#include "planes.h"
+
+namespace flutter {
+
+// A display that uses the software renderer and copies each frame into a
+// memory mapped framebuffer. This needs no GPU stack at all.
+class FramebufferDisplay : public Display {
+public:
+  // Presents to a Linux framebuffer device (usually "/dev/fb0"). The size and
+  // pixel format are those of the current video mode.
+  explicit FramebufferDisplay(const std::string &device_path);
+
+  // Presents to an anonymous shared memory framebuffer of the given size and
+  // format. Other processes may map the buffer via |GetMemoryFD|.
+  FramebufferDisplay(size_t width, size_t height, PixelFormat format);
+
+  ~FramebufferDisplay() override;
+
+  // |Display|
+  bool IsValid() const override;
+
+  // |Display|
+  size_t GetWidth() const override;
+
+  // |Display|
+  size_t GetHeight() const override;
+
+  // |Display|
+  bool SetFrameCapture(FrameCapture *capture) override;
+
+  // |Display|
+  PlaneAllocator *GetPlaneAllocator() override;
+
+  PixelFormat GetPixelFormat() const;
+
+  // The file descriptor of the framebuffer device or the shared memory file.
+  int GetMemoryFD() const;
+
+private:
+  int fd_ = -1;
+  uint8_t *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  // Offset of the first visible pixel into the mapping.
+  size_t mapping_offset_ = 0;
+  size_t width_ = 0;
+  size_t height_ = 0;
+  size_t row_bytes_ = 0;
+  PixelFormat format_ = PixelFormat::kBGRA8888;
+  TileDamageTracker damage_tracker_;
+  size_t frame_count_ = 0;
+  uint64_t total_blit_nanos_ = 0;
+  size_t total_tile_count_ = 0;
+  size_t copied_tile_count_ = 0;
+  FrameCapture *frame_capture_ = nullptr;
+  // Frames are composited with the planes once there is an allocator.
+  std::unique_ptr<SoftwarePlaneAllocator> planes_;
+  bool valid_ = false;
+
+  bool MapMemory(size_t size);
+
+  // Converts |rect| of software renderer pixels, starting at |pixels|, into
+  // the framebuffer.
+  bool WriteRect(const uint8_t *pixels, size_t row_bytes,
+                 const DamageRect &rect);
+
+  void CaptureFrame(const void *allocation, size_t row_bytes, size_t width,
+                    size_t height);
+
+  // |FlutterApplication::RenderDelegate|
+  FlutterRendererType GetRendererType() const override;
+
+  // |FlutterApplication::RenderDelegate|
+  bool OnApplicationSoftwarePresent(const void *allocation, size_t row_bytes,
+                                    size_t height) override;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FramebufferDisplay);
+};
+
+} // namespace flutter
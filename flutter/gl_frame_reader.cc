@@ -0,0 +1,180 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gl_frame_reader.h"
+
+#include <EGL/egl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+// OpenGL ES 3 names. The GLES2 headers some drivers ship don't have them.
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER_BINDING
+#define GL_PIXEL_PACK_BUFFER_BINDING 0x88ED
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+
+namespace flutter {
+
+GLFrameReader::GLFrameReader(FrameCapture &capture, size_t width,
+                             size_t height)
+    : capture_(capture), width_(width), height_(height) {}
+
+GLFrameReader::~GLFrameReader() {
+  for (auto &buffer : pixel_buffers_) {
+    if (buffer.frame != nullptr) {
+      capture_.CancelFrame(buffer.frame);
+    }
+  }
+}
+
+void GLFrameReader::Initialize() {
+  initialized_ = true;
+
+  // ES 2 contexts are often ES 3 underneath.
+  const auto version =
+      reinterpret_cast<const char *>(::glGetString(GL_VERSION));
+  const char *prefix = "OpenGL ES ";
+  if (version == nullptr || ::strncmp(version, prefix, strlen(prefix)) != 0 ||
+      ::atoi(version + strlen(prefix)) < 3) {
+    FLWAY_LOG << "Frames are captured synchronously without OpenGL ES 3."
+              << std::endl;
+    return;
+  }
+
+  map_buffer_range_ = reinterpret_cast<MapBufferRangeProc>(
+      ::eglGetProcAddress("glMapBufferRange"));
+  unmap_buffer_ =
+      reinterpret_cast<UnmapBufferProc>(::eglGetProcAddress("glUnmapBuffer"));
+  if (map_buffer_range_ == nullptr || unmap_buffer_ == nullptr) {
+    map_buffer_range_ = nullptr;
+    unmap_buffer_ = nullptr;
+    return;
+  }
+
+  GLint previous_buffer = 0;
+  ::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previous_buffer);
+  for (auto &buffer : pixel_buffers_) {
+    ::glGenBuffers(1, &buffer.name);
+    ::glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.name);
+    ::glBufferData(GL_PIXEL_PACK_BUFFER, width_ * height_ * 4, nullptr,
+                   GL_STREAM_READ);
+  }
+  ::glBindBuffer(GL_PIXEL_PACK_BUFFER, previous_buffer);
+}
+
+void GLFrameReader::FinishRead(PixelBuffer &buffer) {
+  auto frame = buffer.frame;
+  buffer.frame = nullptr;
+
+  ::glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.name);
+  const void *pixels = map_buffer_range_(GL_PIXEL_PACK_BUFFER, 0,
+                                         width_ * height_ * 4, GL_MAP_READ_BIT);
+  if (pixels == nullptr) {
+    capture_.CancelFrame(frame);
+    return;
+  }
+  ::memcpy(frame->pixels, pixels, width_ * height_ * 4);
+  unmap_buffer_(GL_PIXEL_PACK_BUFFER);
+  capture_.SubmitFrame(frame);
+}
+
+void GLFrameReader::DeletePixelBuffers() {
+  for (auto &buffer : pixel_buffers_) {
+    if (buffer.name != 0) {
+      ::glDeleteBuffers(1, &buffer.name);
+      buffer.name = 0;
+    }
+  }
+  next_pixel_buffer_ = 0;
+  initialized_ = false;
+}
+
+void GLFrameReader::Finish() {
+  if (map_buffer_range_ == nullptr) {
+    return;
+  }
+
+  GLint previous_buffer = 0;
+  ::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previous_buffer);
+  // The older frame first.
+  for (size_t i = 0; i < 2; ++i) {
+    auto &buffer = pixel_buffers_[(next_pixel_buffer_ + i) % 2];
+    if (buffer.frame != nullptr) {
+      FinishRead(buffer);
+    }
+  }
+  ::glBindBuffer(GL_PIXEL_PACK_BUFFER, previous_buffer);
+  DeletePixelBuffers();
+}
+
+void GLFrameReader::ReadFrame(GLuint fbo) {
+  if (stopped_) {
+    return;
+  }
+  if (!initialized_) {
+    Initialize();
+  }
+
+  // The engine caches GL state. Put back whatever is changed here.
+  GLint previous_fbo = 0;
+  GLint previous_alignment = 4;
+  GLint previous_buffer = 0;
+  ::glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_fbo);
+  ::glGetIntegerv(GL_PACK_ALIGNMENT, &previous_alignment);
+  if (map_buffer_range_ != nullptr) {
+    ::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previous_buffer);
+  }
+
+  ::glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  ::glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  // The frame read at the last present.
+  auto &last = pixel_buffers_[1 - next_pixel_buffer_];
+  if (last.frame != nullptr) {
+    FinishRead(last);
+  }
+
+  auto frame = capture_.AcquireFrame(width_, height_, PixelFormat::kRGBA8888,
+                                     true /* bottom up */);
+  if (frame != nullptr) {
+    if (map_buffer_range_ == nullptr || frame->last) {
+      if (map_buffer_range_ != nullptr) {
+        ::glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      }
+      ::glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE,
+                     frame->pixels);
+      stopped_ = frame->last;
+      capture_.SubmitFrame(frame);
+    } else {
+      auto &buffer = pixel_buffers_[next_pixel_buffer_];
+      ::glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.name);
+      ::glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+      buffer.frame = frame;
+      next_pixel_buffer_ = 1 - next_pixel_buffer_;
+    }
+  }
+
+  if (map_buffer_range_ != nullptr) {
+    ::glBindBuffer(GL_PIXEL_PACK_BUFFER, previous_buffer);
+    // The pending read was finished above.
+    if (stopped_) {
+      DeletePixelBuffers();
+    }
+  }
+  ::glPixelStorei(GL_PACK_ALIGNMENT, previous_alignment);
+  ::glBindFramebuffer(GL_FRAMEBUFFER, previous_fbo);
+}
+
+} // namespace flutter
@@ -0,0 +1,72 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+
+#include "frame_capture.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Reads presented frames back from an OpenGL ES framebuffer into a frame
+// capture. With OpenGL ES 3 each frame is read into one of two pixel pack
+// buffers and copied out at the next present, by which time the GPU is done
+// with it, so the raster thread never waits for the read. OpenGL ES 2 has no
+// pixel buffers and frames are read synchronously.
+//
+// A frame read into a pixel buffer is only copied out by the next present, so
+// once the screen stops changing the last one waits for |Finish|.
+class GLFrameReader {
+public:
+  // |capture| must outlive the reader.
+  GLFrameReader(FrameCapture &capture, size_t width, size_t height);
+
+  // Frames still being read are cancelled. Call |Finish| first to deliver
+  // them and delete the pixel buffers.
+  ~GLFrameReader();
+
+  // Called on the raster thread with the onscreen context current, after the
+  // frame is rendered to |fbo| and before it is swapped.
+  void ReadFrame(GLuint fbo);
+
+  // Delivers the frame still being read and deletes the pixel buffers. The
+  // next |ReadFrame| creates them again. Called once the engine has shut
+  // down, with a context sharing the onscreen context's objects current.
+  void Finish();
+
+private:
+  using MapBufferRangeProc = void *(*)(GLenum, GLintptr, GLsizeiptr,
+                                       GLbitfield);
+  using UnmapBufferProc = GLboolean (*)(GLenum);
+
+  struct PixelBuffer {
+    GLuint name = 0;
+    // The frame the buffer is being read for.
+    FrameCapture::Frame *frame = nullptr;
+  };
+
+  FrameCapture &capture_;
+  const size_t width_;
+  const size_t height_;
+  bool initialized_ = false;
+  MapBufferRangeProc map_buffer_range_ = nullptr;
+  UnmapBufferProc unmap_buffer_ = nullptr;
+  PixelBuffer pixel_buffers_[2];
+  size_t next_pixel_buffer_ = 0;
+  // Set once the capture has taken its last frame.
+  bool stopped_ = false;
+
+  void Initialize();
+
+  void FinishRead(PixelBuffer &buffer);
+
+  void DeletePixelBuffers();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(GLFrameReader);
+};
+
+} // namespace flutter
@@ -0,0 +1,437 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "headless_display.h"
+
+#include <EGL/eglext.h>
+#include <GLES2/gl2ext.h>
+#include <dlfcn.h>
+#include <string.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+static EGLDisplay GetHeadlessEGLDisplay() {
+#if defined(EGL_PLATFORM_SURFACELESS_MESA)
+  // Prefer the Mesa surfaceless platform so that no windowing system needs to
+  // be running.
+  if (HasExtension(::eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS),
+                   "EGL_MESA_platform_surfaceless")) {
+    auto get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            ::eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display != nullptr) {
+      auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                          EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+  }
+#endif
+  return ::eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+// EGL doesn't count initializations, so every headless display in the process
+// shares one and the last to go terminates it. Displays are only created and
+// destroyed on the main thread.
+static size_t gInitializedDisplayCount = 0;
+
+static const EGLint kContextAttributes[] = {
+    EGL_CONTEXT_CLIENT_VERSION, //
+    2,                          //
+    EGL_NONE                    //
+};
+
+static const EGLint kPbufferAttributes[] = {
+    EGL_WIDTH,  1, //
+    EGL_HEIGHT, 1, //
+    EGL_NONE       //
+};
+
+HeadlessDisplay::HeadlessDisplay(size_t width, size_t height,
+                                 std::string dump_path)
+    : width_(width), height_(height),
+      creation_time_(std::chrono::steady_clock::now()) {
+  if (width_ == 0 || height_ == 0) {
+    FLWAY_ERROR << "Invalid headless display size: " << width_ << " x "
+                << height_ << std::endl;
+    return;
+  }
+
+  // Setup the EGL Display.
+  {
+    auto display = GetHeadlessEGLDisplay();
+    if (display == EGL_NO_DISPLAY) {
+      FLWAY_ERROR << "Could not get the EGL display." << std::endl;
+      return;
+    }
+
+    if (::eglInitialize(display, nullptr, nullptr) != EGL_TRUE) {
+      FLWAY_ERROR << "Could not initialize the EGL display." << std::endl;
+      return;
+    }
+
+    display_ = display;
+    gInitializedDisplayCount++;
+  }
+
+  if (::eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not bind the OpenGL ES API." << std::endl;
+    return;
+  }
+
+  supports_surfaceless_ =
+      HasExtension(::eglQueryString(display_, EGL_EXTENSIONS),
+                   "EGL_KHR_surfaceless_context");
+
+  // Choose an EGL config. All rendering goes to an FBO so the pbuffer only
+  // exists to have something to make current where surfaceless contexts are
+  // not supported.
+  {
+    EGLint num_config = 0;
+    const EGLint attribute_list[] = {
+        EGL_RED_SIZE,        8,                                         //
+        EGL_GREEN_SIZE,      8,                                         //
+        EGL_BLUE_SIZE,       8,                                         //
+        EGL_ALPHA_SIZE,      8,                                         //
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,                        //
+        EGL_SURFACE_TYPE,    supports_surfaceless_ ? 0 : EGL_PBUFFER_BIT, //
+        EGL_NONE                                                        //
+    };
+
+    if (::eglChooseConfig(display_, attribute_list, &config_, 1, &num_config) !=
+            EGL_TRUE ||
+        num_config == 0) {
+      FLWAY_ERROR << "Could not choose an EGL config." << std::endl;
+      return;
+    }
+  }
+
+  // Create the EGL context.
+  {
+    auto context = ::eglCreateContext(display_, config_, EGL_NO_CONTEXT,
+                                      kContextAttributes);
+
+    if (context == EGL_NO_CONTEXT) {
+      FLWAY_ERROR << "Could not create the EGL context." << std::endl;
+      return;
+    }
+
+    context_ = context;
+  }
+
+  // Create the pbuffer surface.
+  if (!supports_surfaceless_) {
+    auto surface =
+        ::eglCreatePbufferSurface(display_, config_, kPbufferAttributes);
+    if (surface == EGL_NO_SURFACE) {
+      FLWAY_ERROR << "Could not create EGL pbuffer surface." << std::endl;
+      return;
+    }
+
+    surface_ = surface;
+  }
+
+  // Optional. The engine uploads textures on the raster thread without it.
+  SetupResourceContext();
+
+  if (::eglMakeCurrent(display_, surface_, surface_, context_) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not make the context current." << std::endl;
+    return;
+  }
+
+  const bool framebuffer_ready = SetupFramebuffer();
+
+  ::eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+  if (!framebuffer_ready) {
+    return;
+  }
+
+  if (!dump_path.empty()) {
+    dump_file_ = ::fopen(dump_path.c_str(), "wb");
+    if (dump_file_ == nullptr) {
+      FLWAY_ERROR << "Could not open " << dump_path << " for frame dumps."
+                  << std::endl;
+      return;
+    }
+    dump_buffer_.resize(width_ * height_ * 4);
+    FLWAY_LOG << "Dumping " << width_ << " x " << height_
+              << " RGBA frames to " << dump_path << std::endl;
+  }
+
+  valid_ = true;
+}
+
+HeadlessDisplay::~HeadlessDisplay() {
+  if (frame_count_ > 0) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto startup_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            first_frame_time_ - creation_time_)
+            .count();
+    const auto elapsed_seconds =
+        std::chrono::duration<double>(now - first_frame_time_).count();
+    FLWAY_LOG << "Presented " << frame_count_
+              << " frames. Time to first frame: " << startup_ms
+              << " ms. Frames per second: "
+              << (elapsed_seconds > 0.0 ? (frame_count_ - 1) / elapsed_seconds
+                                        : 0.0)
+              << std::endl;
+  }
+
+  if (dump_file_ != nullptr) {
+    ::fclose(dump_file_);
+    dump_file_ = nullptr;
+  }
+
+  if (context_ != EGL_NO_CONTEXT &&
+      ::eglMakeCurrent(display_, surface_, surface_, context_) == EGL_TRUE) {
+    if (fbo_ != 0) {
+      ::glDeleteFramebuffers(1, &fbo_);
+    }
+    if (color_renderbuffer_ != 0) {
+      ::glDeleteRenderbuffers(1, &color_renderbuffer_);
+    }
+    if (stencil_renderbuffer_ != 0) {
+      ::glDeleteRenderbuffers(1, &stencil_renderbuffer_);
+    }
+    ::eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+
+  if (resource_surface_ != EGL_NO_SURFACE) {
+    ::eglDestroySurface(display_, resource_surface_);
+    resource_surface_ = EGL_NO_SURFACE;
+  }
+
+  if (resource_context_ != EGL_NO_CONTEXT) {
+    ::eglDestroyContext(display_, resource_context_);
+    resource_context_ = EGL_NO_CONTEXT;
+  }
+
+  if (surface_ != EGL_NO_SURFACE) {
+    ::eglDestroySurface(display_, surface_);
+    surface_ = EGL_NO_SURFACE;
+  }
+
+  if (context_ != EGL_NO_CONTEXT) {
+    ::eglDestroyContext(display_, context_);
+    context_ = EGL_NO_CONTEXT;
+  }
+
+  if (display_ != EGL_NO_DISPLAY) {
+    if (--gInitializedDisplayCount == 0) {
+      ::eglTerminate(display_);
+    }
+    display_ = EGL_NO_DISPLAY;
+  }
+}
+
+void HeadlessDisplay::SetupResourceContext() {
+  resource_context_ =
+      ::eglCreateContext(display_, config_, context_, kContextAttributes);
+  if (resource_context_ == EGL_NO_CONTEXT) {
+    FLWAY_WARNING << "Could not create the resource context." << std::endl;
+    return;
+  }
+
+  // A surface may only be current on one thread at a time.
+  if (!supports_surfaceless_) {
+    resource_surface_ =
+        ::eglCreatePbufferSurface(display_, config_, kPbufferAttributes);
+    if (resource_surface_ == EGL_NO_SURFACE) {
+      FLWAY_WARNING << "Could not create the resource pbuffer." << std::endl;
+      ::eglDestroyContext(display_, resource_context_);
+      resource_context_ = EGL_NO_CONTEXT;
+    }
+  }
+}
+
+bool HeadlessDisplay::SetupFramebuffer() {
+  auto extensions =
+      reinterpret_cast<const char *>(::glGetString(GL_EXTENSIONS));
+
+  const GLenum color_format = HasExtension(extensions, "GL_OES_rgb8_rgba8")
+                                  ? GL_RGBA8_OES
+                                  : GL_RGBA4;
+  const bool packed_depth_stencil =
+      HasExtension(extensions, "GL_OES_packed_depth_stencil");
+
+  ::glGenRenderbuffers(1, &color_renderbuffer_);
+  ::glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer_);
+  ::glRenderbufferStorage(GL_RENDERBUFFER, color_format, width_, height_);
+
+  // The engine needs a stencil buffer for clips.
+  ::glGenRenderbuffers(1, &stencil_renderbuffer_);
+  ::glBindRenderbuffer(GL_RENDERBUFFER, stencil_renderbuffer_);
+  ::glRenderbufferStorage(GL_RENDERBUFFER,
+                          packed_depth_stencil ? GL_DEPTH24_STENCIL8_OES
+                                               : GL_STENCIL_INDEX8,
+                          width_, height_);
+
+  ::glGenFramebuffers(1, &fbo_);
+  ::glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  ::glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, color_renderbuffer_);
+  ::glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, stencil_renderbuffer_);
+  if (packed_depth_stencil) {
+    ::glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                GL_RENDERBUFFER, stencil_renderbuffer_);
+  }
+
+  const auto status = ::glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  ::glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  ::glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    FLWAY_ERROR << "Offscreen framebuffer was incomplete: 0x" << std::hex
+                << status << std::dec << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+void HeadlessDisplay::DumpFrame() {
+  ::glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  ::glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  ::glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE,
+                 dump_buffer_.data());
+
+  // GL rows are bottom up. Write them out top down.
+  const size_t row_bytes = width_ * 4;
+  for (size_t row = height_; row > 0; --row) {
+    ::fwrite(dump_buffer_.data() + (row - 1) * row_bytes, 1, row_bytes,
+             dump_file_);
+  }
+}
+
+// |Display|
+bool HeadlessDisplay::IsValid() const { return valid_; }
+
+// |Display|
+size_t HeadlessDisplay::GetWidth() const { return width_; }
+
+// |Display|
+size_t HeadlessDisplay::GetHeight() const { return height_; }
+
+// |Display|
+bool HeadlessDisplay::SetFrameCapture(FrameCapture *capture) {
+  frame_reader_.reset();
+  if (capture != nullptr) {
+    frame_reader_ = std::make_unique<GLFrameReader>(*capture, width_, height_);
+  }
+  return true;
+}
+
+// |FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationContextMakeCurrent() {
+  if (!valid_) {
+    FLWAY_ERROR << "Cannot make an invalid display current." << std::endl;
+    return false;
+  }
+  if (::eglMakeCurrent(display_, surface_, surface_, context_) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not make the context current." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// |FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationContextClearCurrent() {
+  if (!valid_) {
+    FLWAY_ERROR << "Cannot clear an invalid display." << std::endl;
+    return false;
+  }
+  if (::eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                       EGL_NO_CONTEXT) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not clear the current context." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// |FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationMakeResourceCurrent() {
+  if (!valid_ || resource_context_ == EGL_NO_CONTEXT) {
+    return false;
+  }
+  if (::eglMakeCurrent(display_, resource_surface_, resource_surface_,
+                       resource_context_) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not make the resource context current."
+                << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// |FlutterApplication::RenderDelegate|
+void HeadlessDisplay::OnApplicationShutdown() {
+  // The engine's IO thread exited with the resource context current. See
+  // |PiDisplay::OnApplicationShutdown|.
+  if (resource_context_ == EGL_NO_CONTEXT) {
+    return;
+  }
+  if (resource_surface_ != EGL_NO_SURFACE) {
+    ::eglDestroySurface(display_, resource_surface_);
+    resource_surface_ = EGL_NO_SURFACE;
+  }
+  ::eglDestroyContext(display_, resource_context_);
+  resource_context_ = EGL_NO_CONTEXT;
+  SetupResourceContext();
+
+  // The next engine may never present, so the frame still being read back
+  // is delivered now. It shares the pixel buffers with the new context.
+  if (frame_reader_ && OnApplicationMakeResourceCurrent()) {
+    frame_reader_->Finish();
+    ::eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+}
+
+// |FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationPresent() {
+  if (!valid_) {
+    FLWAY_ERROR << "Cannot present an invalid display." << std::endl;
+    return false;
+  }
+
+  if (frame_reader_) {
+    frame_reader_->ReadFrame(fbo_);
+  }
+
+  if (dump_file_ != nullptr) {
+    DumpFrame();
+  } else {
+    // Nothing is scanned out. Make sure the frame is actually rendered so the
+    // frame rate reflects real work.
+    ::glFinish();
+  }
+
+  if (frame_count_ == 0) {
+    first_frame_time_ = std::chrono::steady_clock::now();
+  }
+  frame_count_++;
+  return true;
+}
+
+// |FlutterApplication::RenderDelegate|
+uint32_t HeadlessDisplay::OnApplicationGetOnscreenFBO() { return fbo_; }
+
+// |FlutterApplication::RenderDelegate|
+void *HeadlessDisplay::GetProcAddress(const char *name) {
+  if (name == nullptr) {
+    return nullptr;
+  }
+
+  if (auto address = dlsym(RTLD_DEFAULT, name)) {
+    return address;
+  }
+
+  return reinterpret_cast<void *>(::eglGetProcAddress(name));
+}
+
+} // namespace flutter
@@ -0,0 +1,99 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "display.h"
+#include "gl_frame_reader.h"
+#include "macros.h"
+
+namespace flutter {
+
+// A display that renders into an offscreen framebuffer object. Works with any
+// EGL implementation that supports pbuffers (Mesa llvmpipe is fine) so that
+// the embedder can be run and benchmarked without a physical screen.
+class HeadlessDisplay : public Display {
+public:
+  // If |dump_path| is not empty, each presented frame is read back and
+  // appended to that file as raw RGBA pixels.
+  HeadlessDisplay(size_t width, size_t height, std::string dump_path);
+
+  ~HeadlessDisplay() override;
+
+  // |Display|
+  bool IsValid() const override;
+
+  // |Display|
+  size_t GetWidth() const override;
+
+  // |Display|
+  size_t GetHeight() const override;
+
+  // |Display|
+  bool SetFrameCapture(FrameCapture *capture) override;
+
+private:
+  const size_t width_;
+  const size_t height_;
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLContext context_ = EGL_NO_CONTEXT;
+  EGLSurface surface_ = EGL_NO_SURFACE;
+  EGLConfig config_ = {0};
+  bool supports_surfaceless_ = false;
+  // Shares resources with |context_| for texture uploads on the engine's IO
+  // thread. Gets its own pbuffer unless contexts can be surfaceless.
+  EGLContext resource_context_ = EGL_NO_CONTEXT;
+  EGLSurface resource_surface_ = EGL_NO_SURFACE;
+  GLuint fbo_ = 0;
+  GLuint color_renderbuffer_ = 0;
+  GLuint stencil_renderbuffer_ = 0;
+  FILE *dump_file_ = nullptr;
+  std::vector<uint8_t> dump_buffer_;
+  std::unique_ptr<GLFrameReader> frame_reader_;
+  const std::chrono::steady_clock::time_point creation_time_;
+  std::chrono::steady_clock::time_point first_frame_time_;
+  size_t frame_count_ = 0;
+  bool valid_ = false;
+
+  void SetupResourceContext();
+
+  bool SetupFramebuffer();
+
+  void DumpFrame();
+
+  // |FlutterApplication::RenderDelegate|
+  bool OnApplicationContextMakeCurrent() override;
+
+  // |FlutterApplication::RenderDelegate|
+  bool OnApplicationContextClearCurrent() override;
+
+  // |FlutterApplication::RenderDelegate|
+  bool OnApplicationMakeResourceCurrent() override;
+
+  // |FlutterApplication::RenderDelegate|
+  bool OnApplicationPresent() override;
+
+  // |FlutterApplication::RenderDelegate|
+  void OnApplicationShutdown() override;
+
+  // |FlutterApplication::RenderDelegate|
+  uint32_t OnApplicationGetOnscreenFBO() override;
+
+  // |FlutterApplication::RenderDelegate|
+  void *GetProcAddress(const char *) override;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(HeadlessDisplay);
+};
+
+} // namespace flutter
@@ -0,0 +1,94 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "histogram.h"
+
+#include <algorithm>
+
+namespace flutter {
+
+static size_t HighestBit(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+
+Histogram::Histogram() : max_(0) {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t Histogram::BucketForValue(uint64_t micros) {
+  if (micros < kLinearBuckets) {
+    return micros;
+  }
+  // Values from 2^e to 2^(e+1) are split into |kSubBuckets| buckets using the
+  // three bits below the highest one.
+  const size_t exponent = HighestBit(micros);
+  const size_t sub_bucket = (micros >> (exponent - 3)) & (kSubBuckets - 1);
+  const size_t bucket = kLinearBuckets + (exponent - 4) * kSubBuckets +
+                        sub_bucket;
+  return std::min(bucket, kBucketCount - 1);
+}
+
+uint64_t Histogram::UpperBoundOfBucket(size_t bucket) {
+  if (bucket < kLinearBuckets) {
+    return bucket;
+  }
+  const size_t exponent = (bucket - kLinearBuckets) / kSubBuckets + 4;
+  const size_t sub_bucket = (bucket - kLinearBuckets) % kSubBuckets;
+  return ((kSubBuckets + sub_bucket + 1) << (exponent - 3)) - 1;
+}
+
+void Histogram::Record(uint64_t micros) {
+  buckets_[BucketForValue(micros)].fetch_add(1, std::memory_order_relaxed);
+
+  auto max = max_.load(std::memory_order_relaxed);
+  while (micros > max &&
+         !max_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Summary Histogram::TakeSummary() {
+  uint32_t counts[kBucketCount];
+  Summary summary;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+    summary.count += counts[i];
+  }
+  summary.max = max_.exchange(0, std::memory_order_relaxed);
+
+  if (summary.count == 0) {
+    return summary;
+  }
+
+  const uint64_t p50_rank = (summary.count * 50 + 99) / 100;
+  const uint64_t p95_rank = (summary.count * 95 + 99) / 100;
+  const uint64_t p99_rank = (summary.count * 99 + 99) / 100;
+  bool found_p50 = false;
+  bool found_p95 = false;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    seen += counts[i];
+    // Percentiles never report more than the largest value actually seen.
+    const auto bound = std::min(UpperBoundOfBucket(i), summary.max);
+    if (!found_p50 && seen >= p50_rank) {
+      summary.p50 = bound;
+      found_p50 = true;
+    }
+    if (!found_p95 && seen >= p95_rank) {
+      summary.p95 = bound;
+      found_p95 = true;
+    }
+    if (seen >= p99_rank) {
+      summary.p99 = bound;
+      break;
+    }
+  }
+  return summary;
+}
+
+} // namespace flutter
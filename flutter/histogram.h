@@ -0,0 +1,55 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A lock-free histogram of durations in microseconds. Buckets are fixed and
+// log-linear (eight per power of two) so recording is a single relaxed atomic
+// increment and percentiles are accurate to within about 12%. Values up to
+// about sixteen seconds are tracked. Larger values land in the last bucket.
+class Histogram {
+public:
+  struct Summary {
+    uint64_t count = 0;
+    uint64_t p50 = 0;
+    uint64_t p95 = 0;
+    uint64_t p99 = 0;
+    uint64_t max = 0;
+  };
+
+  Histogram();
+
+  // May be called on any thread.
+  void Record(uint64_t micros);
+
+  // Collects the percentiles of the values recorded since the last call and
+  // resets the histogram. Values recorded concurrently end up in this summary
+  // or the next one.
+  Summary TakeSummary();
+
+private:
+  static const size_t kLinearBuckets = 16;
+  static const size_t kSubBuckets = 8;
+  static const size_t kBucketCount = kLinearBuckets + 20 * kSubBuckets;
+
+  std::atomic<uint32_t> buckets_[kBucketCount];
+  std::atomic<uint64_t> max_;
+
+  static size_t BucketForValue(uint64_t micros);
+
+  static uint64_t UpperBoundOfBucket(size_t bucket);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+} // namespace flutter
@@ -0,0 +1,771 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_reader.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "utils.h"
+
+namespace flutter {
+
+static const char *kInputDirectory = "/dev/input";
+
+// The number of multi-touch protocol B slots tracked per device.
+static const size_t kMaxSlots = 10;
+
+// Logical pixels scrolled per mouse wheel detent.
+static const double kScrollOffsetMultiplier = 20.0;
+
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+#define BIT_WORDS(count) (((count) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+static bool TestBit(const unsigned long *bits, size_t bit) {
+  return (bits[bit / BITS_PER_LONG] >> (bit % BITS_PER_LONG)) & 1;
+}
+
+struct AxisRange {
+  int32_t minimum = 0;
+  int32_t maximum = 0;
+
+  double Scale(int32_t value, size_t extent) const {
+    const double range = maximum - minimum + 1;
+    return range > 0 ? (value - minimum) * extent / range : value;
+  }
+};
+
+struct TouchSlot {
+  // The tracking ID reported by the device. -1 when no contact is present.
+  int32_t tracking_id = -1;
+  // The tracking ID of the contact the engine has seen go down. -1 when the
+  // engine believes the slot is up.
+  int32_t reported_tracking_id = -1;
+  int32_t x = 0;
+  int32_t y = 0;
+  bool dirty = false;
+  // Set once the engine has seen the slot's pointer, which it then tracks
+  // until the pointer is removed.
+  bool added = false;
+};
+
+struct InputReader::Device {
+  enum class Kind {
+    kTouch,
+    kMouse,
+    kKeyboard,
+  };
+
+  int fd = -1;
+  std::string path;
+  Kind kind = Kind::kMouse;
+  // Flutter device IDs are |device_id| + slot.
+  int32_t device_id = 0;
+  bool monotonic_timestamps = false;
+  // Set after SYN_DROPPED. Events are discarded until the next SYN_REPORT.
+  bool dropped = false;
+
+  // Touch state.
+  bool multi_touch = false;
+  AxisRange x_range;
+  AxisRange y_range;
+  TouchSlot slots[kMaxSlots];
+  size_t current_slot = 0;
+
+  // Mouse state.
+  double x = 0.0;
+  double y = 0.0;
+  int64_t buttons = 0;
+  int64_t reported_buttons = 0;
+  double scroll_x = 0.0;
+  double scroll_y = 0.0;
+  bool moved = false;
+  bool added = false;
+
+  // Keyboard state. The keys the delegate has seen go down.
+  unsigned long keys[BIT_WORDS(KEY_CNT)] = {};
+
+  const char *GetKindName() const {
+    switch (kind) {
+    case Kind::kTouch:
+      return "touch";
+    case Kind::kMouse:
+      return "mouse";
+    case Kind::kKeyboard:
+      return "keyboard";
+    }
+    return "unknown";
+  }
+
+  uint64_t GetTimestamp(const input_event &event) const {
+    return monotonic_timestamps
+               ? event.time.tv_sec * 1000000ull + event.time.tv_usec
+               : GetMonotonicTimeNanos() / 1000;
+  }
+};
+
+InputReader::InputReader(Delegate &delegate, size_t width, size_t height)
+    : delegate_(delegate), width_(width), height_(height) {
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the input epoll instance." << std::endl;
+    return;
+  }
+
+  wakeup_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wakeup_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the input wakeup event." << std::endl;
+    return;
+  }
+
+  epoll_event wakeup_event = {};
+  wakeup_event.events = EPOLLIN;
+  wakeup_event.data.ptr = &wakeup_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &wakeup_event) == -1) {
+    FLWAY_ERROR << "Could not watch the input wakeup event." << std::endl;
+    return;
+  }
+
+  // Hotplug is a nicety. Carry on without it. udev makes new nodes readable
+  // after they are created, so attribute changes are retried too.
+  inotify_fd_ = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if (inotify_fd_ != -1 &&
+      ::inotify_add_watch(inotify_fd_, kInputDirectory,
+                          IN_CREATE | IN_ATTRIB) != -1) {
+    epoll_event hotplug_event = {};
+    hotplug_event.events = EPOLLIN;
+    hotplug_event.data.ptr = &inotify_fd_;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, inotify_fd_, &hotplug_event);
+  } else {
+    FLWAY_ERROR << "Input device hotplug is unavailable." << std::endl;
+  }
+
+  pending_events_.reserve(kMaxSlots * 2);
+  // More than a report ever holds, so that keys never allocate.
+  pending_key_events_.reserve(64);
+
+  OpenDevices();
+
+  valid_ = true;
+}
+
+InputReader::~InputReader() {
+  while (!devices_.empty()) {
+    CloseDevice(devices_.back().get());
+  }
+
+  for (auto fd : {inotify_fd_, wakeup_fd_, epoll_fd_}) {
+    if (fd != -1) {
+      ::close(fd);
+    }
+  }
+}
+
+bool InputReader::IsValid() const { return valid_; }
+
+void InputReader::Run() {
+  if (!valid_) {
+    return;
+  }
+
+  epoll_event events[16];
+  while (true) {
+    const int count = ::epoll_wait(epoll_fd_, events, 16, -1 /* timeout */);
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      FLWAY_ERROR << "Could not wait for input events: " << strerror(errno)
+                  << std::endl;
+      return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      auto data = events[i].data.ptr;
+      if (data == &wakeup_fd_) {
+        return;
+      }
+      if (data == &inotify_fd_) {
+        ReadHotplugEvents();
+        continue;
+      }
+      ReadDevice(reinterpret_cast<Device *>(data));
+    }
+  }
+}
+
+void InputReader::Terminate() {
+  uint64_t value = 1;
+  if (::write(wakeup_fd_, &value, sizeof(value)) != sizeof(value)) {
+    FLWAY_ERROR << "Could not wake the input reader." << std::endl;
+  }
+}
+
+void InputReader::OpenDevices() {
+  auto directory = ::opendir(kInputDirectory);
+  if (directory == nullptr) {
+    FLWAY_ERROR << "Could not open " << kInputDirectory << std::endl;
+    return;
+  }
+
+  while (auto entry = ::readdir(directory)) {
+    if (::strncmp(entry->d_name, "event", 5) == 0) {
+      OpenDevice(std::string{kInputDirectory} + "/" + entry->d_name);
+    }
+  }
+
+  ::closedir(directory);
+}
+
+void InputReader::OpenDevice(const std::string &path) {
+  for (const auto &device : devices_) {
+    if (device->path == path) {
+      return;
+    }
+  }
+
+  const int fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+
+  unsigned long abs_bits[BIT_WORDS(ABS_CNT)] = {};
+  unsigned long rel_bits[BIT_WORDS(REL_CNT)] = {};
+  unsigned long key_bits[BIT_WORDS(KEY_CNT)] = {};
+  ::ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits);
+  ::ioctl(fd, EVIOCGBIT(EV_REL, sizeof(rel_bits)), rel_bits);
+  ::ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits);
+
+  auto device = std::make_unique<Device>();
+  device->fd = fd;
+  device->path = path;
+
+  if (TestBit(abs_bits, ABS_MT_SLOT) && TestBit(abs_bits, ABS_MT_POSITION_X) &&
+      TestBit(abs_bits, ABS_MT_POSITION_Y)) {
+    device->kind = Device::Kind::kTouch;
+    device->multi_touch = true;
+  } else if (TestBit(abs_bits, ABS_X) && TestBit(abs_bits, ABS_Y) &&
+             TestBit(key_bits, BTN_TOUCH)) {
+    device->kind = Device::Kind::kTouch;
+  } else if (TestBit(rel_bits, REL_X) && TestBit(rel_bits, REL_Y) &&
+             TestBit(key_bits, BTN_LEFT)) {
+    device->kind = Device::Kind::kMouse;
+    device->x = width_ / 2.0;
+    device->y = height_ / 2.0;
+  } else if (TestBit(key_bits, KEY_ENTER) &&
+             (TestBit(key_bits, KEY_A) || TestBit(key_bits, KEY_1))) {
+    // Barcode scanners that only type digits are keyboards too.
+    device->kind = Device::Kind::kKeyboard;
+  } else {
+    ::close(fd);
+    return;
+  }
+
+  if (device->kind == Device::Kind::kTouch) {
+    input_absinfo x_info = {};
+    input_absinfo y_info = {};
+    const auto x_axis = device->multi_touch ? ABS_MT_POSITION_X : ABS_X;
+    const auto y_axis = device->multi_touch ? ABS_MT_POSITION_Y : ABS_Y;
+    if (::ioctl(fd, EVIOCGABS(x_axis), &x_info) == -1 ||
+        ::ioctl(fd, EVIOCGABS(y_axis), &y_info) == -1) {
+      FLWAY_ERROR << "Could not query the axes of " << path << std::endl;
+      ::close(fd);
+      return;
+    }
+    device->x_range.minimum = x_info.minimum;
+    device->x_range.maximum = x_info.maximum;
+    device->y_range.minimum = y_info.minimum;
+    device->y_range.maximum = y_info.maximum;
+
+    if (device->multi_touch) {
+      input_absinfo slot_info = {};
+      if (::ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &slot_info) == 0 &&
+          slot_info.value >= 0) {
+        device->current_slot = slot_info.value;
+      }
+    }
+  }
+
+  // Ask for timestamps on the same clock the engine uses.
+  int clock_id = CLOCK_MONOTONIC;
+  device->monotonic_timestamps = ::ioctl(fd, EVIOCSCLOCKID, &clock_id) == 0;
+
+  device->device_id = next_device_id_;
+  next_device_id_ += kMaxSlots;
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = device.get();
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+    FLWAY_ERROR << "Could not watch " << path << std::endl;
+    ::close(fd);
+    return;
+  }
+
+  char name[256] = {};
+  ::ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+  FLWAY_LOG << "Using " << device->GetKindName() << " device " << path
+            << " (" << name << ")" << std::endl;
+
+  delegate_.OnInputDeviceAdded(device->device_id, kMaxSlots, path, name);
+  devices_.emplace_back(std::move(device));
+}
+
+void InputReader::CloseDevice(Device *device) {
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, device->fd, nullptr);
+  ::close(device->fd);
+
+  auto found = std::find_if(
+      devices_.begin(), devices_.end(),
+      [device](const std::unique_ptr<Device> &item) {
+        return item.get() == device;
+      });
+  if (found != devices_.end()) {
+    devices_.erase(found);
+  }
+}
+
+void InputReader::ReadHotplugEvents() {
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    const auto size = ::read(inotify_fd_, buffer, sizeof(buffer));
+    if (size <= 0) {
+      return;
+    }
+    for (ssize_t offset = 0; offset < size;) {
+      auto event = reinterpret_cast<const inotify_event *>(buffer + offset);
+      if (event->len > 0 && ::strncmp(event->name, "event", 5) == 0) {
+        OpenDevice(std::string{kInputDirectory} + "/" + event->name);
+      }
+      offset += sizeof(inotify_event) + event->len;
+    }
+  }
+}
+
+void InputReader::ReadDevice(Device *device) {
+  input_event events[64];
+  while (true) {
+    const auto size = ::read(device->fd, events, sizeof(events));
+    if (size == -1 && errno == EINTR) {
+      continue;
+    }
+    if (size == -1 && errno == EAGAIN) {
+      return;
+    }
+    if (size <= 0) {
+      FLWAY_LOG << "Input device " << device->path << " went away."
+                << std::endl;
+      ReleaseDevice(device, GetMonotonicTimeNanos() / 1000);
+      CloseDevice(device);
+      return;
+    }
+    const size_t count = size / sizeof(input_event);
+    for (size_t i = 0; i < count; ++i) {
+      ProcessEvent(device, events[i]);
+    }
+  }
+}
+
+void InputReader::ProcessEvent(Device *device, const input_event &event) {
+  if (event.type == EV_SYN) {
+    if (event.code == SYN_DROPPED) {
+      device->dropped = true;
+    } else if (event.code == SYN_REPORT) {
+      if (device->dropped) {
+        device->dropped = false;
+        SyncDevice(device, device->GetTimestamp(event));
+      }
+      FlushDevice(device, event);
+    }
+    return;
+  }
+
+  if (device->dropped) {
+    return;
+  }
+
+  TouchSlot &slot = device->slots[device->current_slot];
+
+  switch (event.type) {
+  case EV_ABS:
+    switch (event.code) {
+    case ABS_MT_SLOT:
+      if (event.value >= 0 && static_cast<size_t>(event.value) < kMaxSlots) {
+        device->current_slot = event.value;
+      }
+      break;
+    case ABS_MT_TRACKING_ID:
+      slot.tracking_id = event.value;
+      slot.dirty = true;
+      break;
+    case ABS_MT_POSITION_X:
+      slot.x = event.value;
+      slot.dirty = true;
+      break;
+    case ABS_MT_POSITION_Y:
+      slot.y = event.value;
+      slot.dirty = true;
+      break;
+    case ABS_X:
+      if (!device->multi_touch) {
+        device->slots[0].x = event.value;
+        device->slots[0].dirty = true;
+      }
+      break;
+    case ABS_Y:
+      if (!device->multi_touch) {
+        device->slots[0].y = event.value;
+        device->slots[0].dirty = true;
+      }
+      break;
+    }
+    break;
+  case EV_REL:
+    switch (event.code) {
+    case REL_X:
+      device->x = std::min<double>(std::max(device->x + event.value, 0.0),
+                                   width_ - 1.0);
+      device->moved = true;
+      break;
+    case REL_Y:
+      device->y = std::min<double>(std::max(device->y + event.value, 0.0),
+                                   height_ - 1.0);
+      device->moved = true;
+      break;
+    case REL_WHEEL:
+      device->scroll_y -= event.value * kScrollOffsetMultiplier;
+      break;
+    case REL_HWHEEL:
+      device->scroll_x += event.value * kScrollOffsetMultiplier;
+      break;
+    }
+    break;
+  case EV_KEY: {
+    if (device->kind == Device::Kind::kKeyboard) {
+      // Held keys are repeated by whoever handles them, not the kernel.
+      const bool pressed = event.value == 1;
+      if ((event.value == 0 || pressed) && event.code < KEY_CNT &&
+          TestBit(device->keys, event.code) != pressed) {
+        device->keys[event.code / BITS_PER_LONG] ^=
+            1ul << (event.code % BITS_PER_LONG);
+        InputKeyEvent key;
+        key.timestamp = device->GetTimestamp(event);
+        key.device = device->device_id;
+        key.code = event.code;
+        key.pressed = pressed;
+        pending_key_events_.push_back(key);
+      }
+      return;
+    }
+
+    int64_t button = 0;
+    switch (event.code) {
+    case BTN_TOUCH:
+      if (!device->multi_touch) {
+        device->slots[0].tracking_id = event.value ? 0 : -1;
+        device->slots[0].dirty = true;
+      }
+      return;
+    case BTN_LEFT:
+      button = kFlutterPointerButtonMousePrimary;
+      break;
+    case BTN_RIGHT:
+      button = kFlutterPointerButtonMouseSecondary;
+      break;
+    case BTN_MIDDLE:
+      button = kFlutterPointerButtonMouseMiddle;
+      break;
+    default:
+      return;
+    }
+    if (event.value) {
+      device->buttons |= button;
+    } else {
+      device->buttons &= ~button;
+    }
+    break;
+  }
+  }
+}
+
+// Presses, releases and contacts were lost. Catches up with the state of the
+// device now. Relative motion can't be recovered.
+void InputReader::SyncDevice(Device *device, uint64_t timestamp) {
+  if (device->kind == Device::Kind::kTouch) {
+    SyncTouchSlots(device);
+    return;
+  }
+
+  unsigned long held[BIT_WORDS(KEY_CNT)] = {};
+  if (::ioctl(device->fd, EVIOCGKEY(sizeof(held)), held) == -1) {
+    return;
+  }
+  switch (device->kind) {
+  case Device::Kind::kTouch:
+    break;
+  case Device::Kind::kMouse:
+    device->buttons =
+        (TestBit(held, BTN_LEFT) ? kFlutterPointerButtonMousePrimary : 0) |
+        (TestBit(held, BTN_RIGHT) ? kFlutterPointerButtonMouseSecondary : 0) |
+        (TestBit(held, BTN_MIDDLE) ? kFlutterPointerButtonMouseMiddle : 0);
+    break;
+  case Device::Kind::kKeyboard:
+    SyncKeys(device, held, timestamp);
+    break;
+  }
+}
+
+void InputReader::SyncTouchSlots(Device *device) {
+  bool synced = false;
+  if (device->multi_touch) {
+    // The layout EVIOCGMTSLOTS fills in.
+    struct {
+      uint32_t code;
+      int32_t values[kMaxSlots];
+    } tracking_ids, xs, ys;
+    tracking_ids.code = ABS_MT_TRACKING_ID;
+    xs.code = ABS_MT_POSITION_X;
+    ys.code = ABS_MT_POSITION_Y;
+    input_absinfo slot_info = {};
+    synced =
+        ::ioctl(device->fd, EVIOCGMTSLOTS(sizeof(tracking_ids)),
+                &tracking_ids) != -1 &&
+        ::ioctl(device->fd, EVIOCGMTSLOTS(sizeof(xs)), &xs) != -1 &&
+        ::ioctl(device->fd, EVIOCGMTSLOTS(sizeof(ys)), &ys) != -1 &&
+        ::ioctl(device->fd, EVIOCGABS(ABS_MT_SLOT), &slot_info) != -1;
+    if (synced) {
+      for (size_t i = 0; i < kMaxSlots; ++i) {
+        auto &slot = device->slots[i];
+        slot.tracking_id = tracking_ids.values[i];
+        slot.x = xs.values[i];
+        slot.y = ys.values[i];
+        slot.dirty = true;
+      }
+      if (slot_info.value >= 0 &&
+          static_cast<size_t>(slot_info.value) < kMaxSlots) {
+        device->current_slot = slot_info.value;
+      }
+    }
+  } else {
+    unsigned long held[BIT_WORDS(KEY_CNT)] = {};
+    input_absinfo x_info = {};
+    input_absinfo y_info = {};
+    synced = ::ioctl(device->fd, EVIOCGKEY(sizeof(held)), held) != -1 &&
+             ::ioctl(device->fd, EVIOCGABS(ABS_X), &x_info) != -1 &&
+             ::ioctl(device->fd, EVIOCGABS(ABS_Y), &y_info) != -1;
+    if (synced) {
+      auto &slot = device->slots[0];
+      slot.tracking_id = TestBit(held, BTN_TOUCH) ? 0 : -1;
+      slot.x = x_info.value;
+      slot.y = y_info.value;
+      slot.dirty = true;
+    }
+  }
+
+  // Without the current contacts, lift them all rather than leave them stuck.
+  if (!synced) {
+    for (auto &slot : device->slots) {
+      slot.tracking_id = -1;
+      slot.dirty = true;
+    }
+  }
+}
+
+void InputReader::FlushDevice(Device *device, const input_event &event) {
+  const uint64_t timestamp = device->GetTimestamp(event);
+
+  pending_events_.clear();
+
+  switch (device->kind) {
+  case Device::Kind::kTouch:
+    FlushTouchDevice(device, timestamp);
+    break;
+  case Device::Kind::kMouse:
+    FlushMouseDevice(device, timestamp);
+    break;
+  case Device::Kind::kKeyboard:
+    FlushKeys();
+    return;
+  }
+
+  if (!pending_events_.empty()) {
+    delegate_.OnInputPointerEvents(pending_events_.data(),
+                                   pending_events_.size());
+  }
+}
+
+static FlutterPointerEvent CreatePointerEvent(FlutterPointerPhase phase,
+                                              uint64_t timestamp, double x,
+                                              double y, int32_t device,
+                                              FlutterPointerDeviceKind kind) {
+  FlutterPointerEvent event = {};
+  event.struct_size = sizeof(event);
+  event.phase = phase;
+  // Wraps every 71 minutes where size_t has 32 bits. See |WidenTimestamp|.
+  event.timestamp = timestamp;
+  event.x = x;
+  event.y = y;
+  event.device = device;
+  event.device_kind = kind;
+  return event;
+}
+
+void InputReader::FlushTouchDevice(Device *device, uint64_t timestamp) {
+  for (size_t i = 0; i < kMaxSlots; ++i) {
+    TouchSlot &slot = device->slots[i];
+    if (!slot.dirty) {
+      continue;
+    }
+    slot.dirty = false;
+
+    const double x = device->x_range.Scale(slot.x, width_);
+    const double y = device->y_range.Scale(slot.y, height_);
+    const int32_t device_id = device->device_id + i;
+
+    // A contact may have been lifted and replaced within one report.
+    if (slot.reported_tracking_id != -1 &&
+        slot.reported_tracking_id != slot.tracking_id) {
+      pending_events_.push_back(CreatePointerEvent(
+          kUp, timestamp, x, y, device_id, kFlutterPointerDeviceKindTouch));
+      slot.reported_tracking_id = -1;
+    }
+
+    if (slot.tracking_id == -1) {
+      continue;
+    }
+
+    const auto phase = slot.reported_tracking_id == -1 ? kDown : kMove;
+    pending_events_.push_back(CreatePointerEvent(
+        phase, timestamp, x, y, device_id, kFlutterPointerDeviceKindTouch));
+    slot.reported_tracking_id = slot.tracking_id;
+    slot.added = true;
+  }
+}
+
+void InputReader::FlushMouseDevice(Device *device, uint64_t timestamp) {
+  const bool buttons_changed = device->buttons != device->reported_buttons;
+
+  if (device->moved || buttons_changed) {
+    FlutterPointerPhase phase = kHover;
+    if (device->reported_buttons == 0 && device->buttons != 0) {
+      phase = kDown;
+    } else if (device->reported_buttons != 0 && device->buttons == 0) {
+      phase = kUp;
+    } else if (device->buttons != 0) {
+      phase = kMove;
+    }
+
+    auto event =
+        CreatePointerEvent(phase, timestamp, device->x, device->y,
+                           device->device_id, kFlutterPointerDeviceKindMouse);
+    // Up events report the buttons that are still held.
+    event.buttons = device->buttons;
+    pending_events_.push_back(event);
+    device->reported_buttons = device->buttons;
+    device->moved = false;
+    device->added = true;
+  }
+
+  if (device->scroll_x != 0.0 || device->scroll_y != 0.0) {
+    auto event = CreatePointerEvent(
+        device->buttons == 0 ? kHover : kMove, timestamp, device->x, device->y,
+        device->device_id, kFlutterPointerDeviceKindMouse);
+    event.signal_kind = kFlutterPointerSignalKindScroll;
+    event.scroll_delta_x = device->scroll_x;
+    event.scroll_delta_y = device->scroll_y;
+    event.buttons = device->buttons;
+    pending_events_.push_back(event);
+    device->scroll_x = 0.0;
+    device->scroll_y = 0.0;
+    device->added = true;
+  }
+}
+
+void InputReader::ReleaseDevice(Device *device, uint64_t timestamp) {
+  pending_events_.clear();
+
+  switch (device->kind) {
+  case Device::Kind::kTouch:
+    for (size_t i = 0; i < kMaxSlots; ++i) {
+      auto &slot = device->slots[i];
+      const double x = device->x_range.Scale(slot.x, width_);
+      const double y = device->y_range.Scale(slot.y, height_);
+      const int32_t device_id = device->device_id + i;
+      // The contact wasn't lifted, so it mustn't count as a tap.
+      if (slot.reported_tracking_id != -1) {
+        pending_events_.push_back(CreatePointerEvent(
+            kCancel, timestamp, x, y, device_id,
+            kFlutterPointerDeviceKindTouch));
+      }
+      if (slot.added) {
+        pending_events_.push_back(CreatePointerEvent(
+            kRemove, timestamp, x, y, device_id,
+            kFlutterPointerDeviceKindTouch));
+      }
+    }
+    break;
+  case Device::Kind::kMouse:
+    if (device->reported_buttons != 0) {
+      pending_events_.push_back(
+          CreatePointerEvent(kCancel, timestamp, device->x, device->y,
+                             device->device_id,
+                             kFlutterPointerDeviceKindMouse));
+    }
+    if (device->added) {
+      pending_events_.push_back(
+          CreatePointerEvent(kRemove, timestamp, device->x, device->y,
+                             device->device_id,
+                             kFlutterPointerDeviceKindMouse));
+    }
+    break;
+  case Device::Kind::kKeyboard: {
+    const unsigned long released[BIT_WORDS(KEY_CNT)] = {};
+    SyncKeys(device, released, timestamp);
+    FlushKeys();
+    return;
+  }
+  }
+
+  if (!pending_events_.empty()) {
+    delegate_.OnInputPointerEvents(pending_events_.data(),
+                                   pending_events_.size());
+  }
+}
+
+void InputReader::SyncKeys(Device *device, const unsigned long *key_state,
+                           uint64_t timestamp) {
+  for (uint16_t code = 0; code < KEY_CNT; ++code) {
+    const bool pressed = TestBit(key_state, code);
+    if (TestBit(device->keys, code) == pressed) {
+      continue;
+    }
+    device->keys[code / BITS_PER_LONG] ^= 1ul << (code % BITS_PER_LONG);
+    InputKeyEvent key;
+    key.timestamp = timestamp;
+    key.device = device->device_id;
+    key.code = code;
+    key.pressed = pressed;
+    pending_key_events_.push_back(key);
+  }
+}
+
+void InputReader::FlushKeys() {
+  if (!pending_key_events_.empty()) {
+    delegate_.OnInputKeyEvents(pending_key_events_.data(),
+                               pending_key_events_.size());
+    pending_key_events_.clear();
+  }
+}
+
+} // namespace flutter
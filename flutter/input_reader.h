@@ -0,0 +1,115 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+#include <linux/input.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A key of a keyboard going down or up. Held keys aren't repeated.
+struct InputKeyEvent {
+  // In microseconds, like pointer events.
+  uint64_t timestamp = 0;
+  int32_t device = 0;
+  // A Linux key code from <linux/input.h>.
+  uint16_t code = 0;
+  bool pressed = false;
+};
+
+// Reads touch screens, mice and keyboards from evdev devices in /dev/input.
+// Devices are discovered at startup and as they are plugged in. All the
+// changes described by one SYN_REPORT are delivered to the delegate as a
+// single batch. Contacts and buttons still down when a device goes away are
+// cancelled, and its pointers removed.
+class InputReader {
+public:
+  class Delegate {
+  public:
+    virtual ~Delegate() = default;
+
+    virtual void OnInputPointerEvents(const FlutterPointerEvent *events,
+                                      size_t count) = 0;
+
+    // Keys still held when a keyboard goes away are released first.
+    virtual void OnInputKeyEvents(const InputKeyEvent *events, size_t count) {
+    }
+
+    // Called when a device is opened, before any of its events. The device's
+    // events carry Flutter device IDs from |first_device| up to but not
+    // including |first_device| + |device_count|. IDs are never reused.
+    virtual void OnInputDeviceAdded(int32_t first_device, size_t device_count,
+                                    const std::string &path,
+                                    const std::string &name) {}
+  };
+
+  // Absolute device coordinates are scaled to |width| x |height|.
+  InputReader(Delegate &delegate, size_t width, size_t height);
+
+  ~InputReader();
+
+  bool IsValid() const;
+
+  // Reads and dispatches input events on the calling thread until |Terminate|
+  // is called.
+  void Run();
+
+  // Makes |Run| return. May be called on any thread.
+  void Terminate();
+
+private:
+  struct Device;
+
+  Delegate &delegate_;
+  const size_t width_;
+  const size_t height_;
+  int epoll_fd_ = -1;
+  int wakeup_fd_ = -1;
+  int inotify_fd_ = -1;
+  int32_t next_device_id_ = 0;
+  std::vector<std::unique_ptr<Device>> devices_;
+  std::vector<FlutterPointerEvent> pending_events_;
+  std::vector<InputKeyEvent> pending_key_events_;
+  bool valid_ = false;
+
+  void OpenDevices();
+
+  void OpenDevice(const std::string &path);
+
+  void CloseDevice(Device *device);
+
+  void ReadDevice(Device *device);
+
+  void ReleaseDevice(Device *device, uint64_t timestamp);
+
+  void ReadHotplugEvents();
+
+  void ProcessEvent(Device *device, const input_event &event);
+
+  void FlushDevice(Device *device, const input_event &event);
+
+  void SyncDevice(Device *device, uint64_t timestamp);
+
+  void SyncTouchSlots(Device *device);
+
+  void FlushTouchDevice(Device *device, uint64_t timestamp);
+
+  void FlushMouseDevice(Device *device, uint64_t timestamp);
+
+  void SyncKeys(Device *device, const unsigned long *key_state,
+                uint64_t timestamp);
+
+  void FlushKeys();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(InputReader);
+};
+
+} // namespace flutter
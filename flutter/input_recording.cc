@@ -0,0 +1,254 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_recording.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "utils.h"
+
+namespace flutter {
+
+static const char kMagic[4] = {'F', 'L', 'I', 'R'};
+static const uint32_t kVersion = 1;
+
+static_assert(sizeof(InputRecordingHeader) == 16, "Unexpected padding.");
+static_assert(sizeof(InputRecordingBatch) == 8, "Unexpected padding.");
+static_assert(sizeof(InputRecordingEvent) == 32, "Unexpected padding.");
+
+// Polling interval while waiting for the queue in fast mode.
+static const uint64_t kDrainPollNanos = 250000;
+
+InputRecorder::InputRecorder(InputReader::Delegate &delegate,
+                             const std::string &path, size_t width,
+                             size_t height)
+    : delegate_(delegate) {
+  file_ = ::fopen(path.c_str(), "we");
+  if (file_ == nullptr) {
+    FLWAY_ERROR << "Could not open " << path
+                << " to record input: " << strerror(errno) << std::endl;
+    return;
+  }
+  ::setvbuf(file_, nullptr, _IOFBF, 64 * 1024);
+
+  InputRecordingHeader header = {};
+  ::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.width = width;
+  header.height = height;
+  if (::fwrite(&header, sizeof(header), 1, file_) != 1) {
+    FLWAY_ERROR << "Could not write the input recording header." << std::endl;
+    ::fclose(file_);
+    file_ = nullptr;
+    return;
+  }
+
+  events_.reserve(16);
+}
+
+InputRecorder::~InputRecorder() {
+  if (file_ != nullptr && ::fclose(file_) != 0) {
+    FLWAY_ERROR << "Could not finish the input recording." << std::endl;
+  }
+}
+
+bool InputRecorder::IsValid() const { return file_ != nullptr; }
+
+// |InputReader::Delegate|
+void InputRecorder::OnInputPointerEvents(const FlutterPointerEvent *events,
+                                         size_t count) {
+  // The engine comes first. The recording can wait.
+  delegate_.OnInputPointerEvents(events, count);
+
+  if (file_ == nullptr || count == 0) {
+    return;
+  }
+
+  const uint64_t now = GetMonotonicTimeNanos() / 1000;
+  InputRecordingBatch batch = {};
+  batch.delay_micros = last_batch_micros_ == 0
+                           ? 0
+                           : std::min<uint64_t>(now - last_batch_micros_,
+                                                UINT32_MAX);
+  batch.event_count = count;
+  last_batch_micros_ = now;
+
+  events_.clear();
+  for (size_t i = 0; i < count; ++i) {
+    const auto &event = events[i];
+    InputRecordingEvent recorded = {};
+    recorded.phase = event.phase;
+    recorded.device_kind = event.device_kind;
+    recorded.signal_kind = event.signal_kind;
+    recorded.device = event.device;
+    // The timestamp wraps every 71 minutes on 32 bit targets.
+    const auto time = WidenTimestamp(event.timestamp, now);
+    recorded.age_micros =
+        time < now ? std::min<uint64_t>(now - time, UINT32_MAX) : 0;
+    recorded.buttons = event.buttons;
+    recorded.x = event.x;
+    recorded.y = event.y;
+    recorded.scroll_delta_x = event.scroll_delta_x;
+    recorded.scroll_delta_y = event.scroll_delta_y;
+    events_.push_back(recorded);
+  }
+
+  if (::fwrite(&batch, sizeof(batch), 1, file_) != 1 ||
+      ::fwrite(events_.data(), sizeof(InputRecordingEvent), count, file_) !=
+          count) {
+    FLWAY_ERROR << "Could not write the input recording. Stopping."
+                << std::endl;
+    ::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+InputReplayer::InputReplayer(PointerEventQueue &queue, const std::string &path,
+                             size_t width, size_t height, bool real_time)
+    : queue_(queue), file_(path), real_time_(real_time) {
+  if (!file_.IsValid()) {
+    FLWAY_ERROR << "Could not open the input recording " << path << "."
+                << std::endl;
+    return;
+  }
+
+  InputRecordingHeader header = {};
+  if (file_.GetSize() < sizeof(header)) {
+    FLWAY_ERROR << path << " is not an input recording." << std::endl;
+    return;
+  }
+  ::memcpy(&header, file_.GetMapping(), sizeof(header));
+
+  if (!Validate(header)) {
+    FLWAY_ERROR << path << " is not a valid input recording." << std::endl;
+    return;
+  }
+
+  if (header.width != 0 && header.height != 0) {
+    scale_x_ = static_cast<double>(width) / header.width;
+    scale_y_ = static_cast<double>(height) / header.height;
+  }
+
+  FLWAY_LOG << "Replaying " << event_count_ << " input events from " << path
+            << (real_time_ ? " in real time." : " as fast as possible.")
+            << std::endl;
+  valid_ = true;
+}
+
+InputReplayer::~InputReplayer() = default;
+
+bool InputReplayer::IsValid() const { return valid_; }
+
+bool InputReplayer::Validate(const InputRecordingHeader &header) {
+  if (::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion) {
+    return false;
+  }
+
+  // Walk the batches up front so that replay never reads past the end.
+  size_t offset = sizeof(header);
+  size_t largest_batch = 0;
+  while (offset < file_.GetSize()) {
+    InputRecordingBatch batch = {};
+    if (file_.GetSize() - offset < sizeof(batch)) {
+      return false;
+    }
+    ::memcpy(&batch, file_.GetMapping() + offset, sizeof(batch));
+    offset += sizeof(batch);
+    if ((file_.GetSize() - offset) / sizeof(InputRecordingEvent) <
+        batch.event_count) {
+      return false;
+    }
+    offset += batch.event_count * sizeof(InputRecordingEvent);
+    event_count_ += batch.event_count;
+    largest_batch = std::max<size_t>(largest_batch, batch.event_count);
+  }
+
+  batch_.reserve(largest_batch);
+  return true;
+}
+
+bool InputReplayer::Run() {
+  if (!valid_) {
+    return false;
+  }
+
+  const auto size = file_.GetSize();
+  const auto mapping = file_.GetMapping();
+  size_t offset = sizeof(InputRecordingHeader);
+  uint64_t target_time = GetMonotonicTimeNanos();
+
+  while (offset < size) {
+    InputRecordingBatch batch = {};
+    ::memcpy(&batch, mapping + offset, sizeof(batch));
+    offset += sizeof(batch);
+
+    if (real_time_) {
+      target_time += batch.delay_micros * 1000ull;
+      if (!WaitUntil(target_time)) {
+        return false;
+      }
+    } else {
+      // The queue drops events it has no room for.
+      while (!queue_.IsDrained()) {
+        if (!WaitUntil(GetMonotonicTimeNanos() + kDrainPollNanos)) {
+          return false;
+        }
+      }
+    }
+
+    const uint64_t now = GetMonotonicTimeNanos() / 1000;
+    batch_.clear();
+    for (size_t i = 0; i < batch.event_count; ++i) {
+      InputRecordingEvent recorded = {};
+      ::memcpy(&recorded, mapping + offset, sizeof(recorded));
+      offset += sizeof(recorded);
+
+      FlutterPointerEvent event = {};
+      event.struct_size = sizeof(event);
+      event.phase = static_cast<FlutterPointerPhase>(recorded.phase);
+      event.timestamp = now - std::min<uint64_t>(recorded.age_micros, now);
+      event.x = recorded.x * scale_x_;
+      event.y = recorded.y * scale_y_;
+      event.device = recorded.device;
+      event.signal_kind =
+          static_cast<FlutterPointerSignalKind>(recorded.signal_kind);
+      event.scroll_delta_x = recorded.scroll_delta_x;
+      event.scroll_delta_y = recorded.scroll_delta_y;
+      event.device_kind =
+          static_cast<FlutterPointerDeviceKind>(recorded.device_kind);
+      event.buttons = recorded.buttons;
+      batch_.push_back(event);
+    }
+
+    queue_.OnInputPointerEvents(batch_.data(), batch_.size());
+  }
+
+  return true;
+}
+
+void InputReplayer::Terminate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  terminated_ = true;
+  terminated_condition_.notify_all();
+}
+
+bool InputReplayer::WaitUntil(uint64_t time_nanos) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!terminated_) {
+    const auto now = GetMonotonicTimeNanos();
+    if (now >= time_nanos) {
+      return true;
+    }
+    terminated_condition_.wait_for(
+        lock, std::chrono::nanoseconds(time_nanos - now));
+  }
+  return false;
+}
+
+} // namespace flutter
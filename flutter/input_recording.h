@@ -0,0 +1,122 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "input_reader.h"
+#include "macros.h"
+#include "mapped_file.h"
+#include "pointer_event_queue.h"
+
+namespace flutter {
+
+// Input recordings are a header followed by the batches the input reader
+// produced, in order. Fields are in host byte order.
+struct InputRecordingHeader {
+  char magic[4];
+  uint32_t version;
+  // The size pointer coordinates were scaled to.
+  uint32_t width;
+  uint32_t height;
+};
+
+struct InputRecordingBatch {
+  // Since the previous batch arrived.
+  uint32_t delay_micros;
+  uint32_t event_count;
+};
+
+struct InputRecordingEvent {
+  uint8_t phase;
+  uint8_t device_kind;
+  uint8_t signal_kind;
+  uint8_t reserved;
+  int32_t device;
+  // How long before its batch arrived the kernel saw the event.
+  uint32_t age_micros;
+  uint32_t buttons;
+  float x;
+  float y;
+  float scroll_delta_x;
+  float scroll_delta_y;
+};
+
+// Writes every batch of pointer events the input reader delivers to a file,
+// and then passes it on to |delegate|. Writes are buffered so the input thread
+// rarely blocks on the disk.
+class InputRecorder : public InputReader::Delegate {
+public:
+  InputRecorder(InputReader::Delegate &delegate, const std::string &path,
+                size_t width, size_t height);
+
+  ~InputRecorder() override;
+
+  bool IsValid() const;
+
+  // |InputReader::Delegate|
+  void OnInputPointerEvents(const FlutterPointerEvent *events,
+                            size_t count) override;
+
+private:
+  InputReader::Delegate &delegate_;
+  FILE *file_ = nullptr;
+  uint64_t last_batch_micros_ = 0;
+  std::vector<InputRecordingEvent> events_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(InputRecorder);
+};
+
+// Feeds a recording made by |InputRecorder| to a pointer event queue as if it
+// came from the input reader. Event timestamps are moved to the time of
+// replay so that input to present latencies can be compared between builds.
+class InputReplayer {
+public:
+  // Recorded coordinates are scaled to |width| x |height|. In real time mode
+  // batches keep their original spacing. Otherwise each batch is delivered as
+  // soon as the queue has taken the previous one.
+  InputReplayer(PointerEventQueue &queue, const std::string &path,
+                size_t width, size_t height, bool real_time);
+
+  ~InputReplayer();
+
+  bool IsValid() const;
+
+  // Replays the recording on the calling thread. Returns false if |Terminate|
+  // was called before the end was reached.
+  bool Run();
+
+  // Makes |Run| return. May be called on any thread.
+  void Terminate();
+
+private:
+  PointerEventQueue &queue_;
+  MappedFile file_;
+  const bool real_time_;
+  double scale_x_ = 1.0;
+  double scale_y_ = 1.0;
+  size_t event_count_ = 0;
+  std::vector<FlutterPointerEvent> batch_;
+  std::mutex mutex_;
+  std::condition_variable terminated_condition_;
+  bool terminated_ = false;
+  bool valid_ = false;
+
+  bool Validate(const InputRecordingHeader &header);
+
+  // Returns false if terminated first.
+  bool WaitUntil(uint64_t time_nanos);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(InputReplayer);
+};
+
+} // namespace flutter
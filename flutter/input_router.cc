@@ -0,0 +1,203 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_router.h"
+
+#include <algorithm>
+
+#include "thread_policy.h"
+#include "utils.h"
+
+namespace flutter {
+
+// Enough for every slot of a touch screen to go down and up in one report,
+// which is as much as the reader hands over at once.
+static const size_t kBatchCapacity = 32;
+
+InputRouter::InputRouter(std::vector<Panel> panels,
+                         InputReader::Delegate *monitor)
+    : panels_(std::move(panels)), monitor_(monitor),
+      batches_(panels_.size()) {
+  for (const auto &panel : panels_) {
+    width_ = std::max(width_, panel.x + panel.width);
+    height_ = std::max(height_, panel.y + panel.height);
+  }
+  for (auto &batch : batches_) {
+    batch.reserve(kBatchCapacity);
+  }
+  captures_.reserve(kBatchCapacity);
+
+  // Until something is touched, the first panel that takes any input.
+  touched_panel_ = std::find_if(panels_.begin(), panels_.end(),
+                                [](const Panel &panel) {
+                                  return panel.device.empty();
+                                }) -
+                   panels_.begin();
+  focused_panel_ = touched_panel_;
+}
+
+InputRouter::~InputRouter() { Stop(); }
+
+bool InputRouter::Start() {
+  if (thread_.joinable()) {
+    return true;
+  }
+
+  if (panels_.empty() || width_ < 1.0 || height_ < 1.0) {
+    FLWAY_ERROR << "No panels to route input to." << std::endl;
+    return false;
+  }
+
+  reader_ = std::make_unique<InputReader>(*this, static_cast<size_t>(width_),
+                                          static_cast<size_t>(height_));
+  if (!reader_->IsValid()) {
+    reader_.reset();
+    return false;
+  }
+
+  thread_ = std::thread([this]() {
+    ApplyThreadPolicyOnce(ThreadRole::kInput);
+    reader_->Run();
+  });
+  return true;
+}
+
+void InputRouter::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  reader_->Terminate();
+  thread_.join();
+  reader_.reset();
+}
+
+// |InputReader::Delegate|
+void InputRouter::OnInputDeviceAdded(int32_t first_device,
+                                     size_t device_count,
+                                     const std::string &path,
+                                     const std::string &name) {
+  for (size_t i = 0; i < panels_.size(); ++i) {
+    const auto &device = panels_[i].device;
+    if (device.empty() ||
+        (path != device && name.find(device) == std::string::npos)) {
+      continue;
+    }
+    FLWAY_LOG << "Input from " << path << " goes to panel " << i << "."
+              << std::endl;
+    bindings_.push_back({first_device,
+                         first_device + static_cast<int32_t>(device_count),
+                         i});
+    return;
+  }
+}
+
+size_t InputRouter::FindBoundPanel(int32_t device) const {
+  auto binding = std::find_if(
+      bindings_.begin(), bindings_.end(), [device](const Binding &item) {
+        return device >= item.first_device && device < item.end_device;
+      });
+  return binding != bindings_.end() ? binding->panel : panels_.size();
+}
+
+size_t InputRouter::FindPanel(const FlutterPointerEvent &event) {
+  auto capture = std::find_if(
+      captures_.begin(), captures_.end(),
+      [&event](const Capture &item) { return item.device == event.device; });
+
+  size_t panel = panels_.size();
+  if (capture != captures_.end()) {
+    panel = capture->panel;
+  } else if (event.phase == kDown || event.phase == kHover ||
+             event.phase == kRemove) {
+    for (size_t i = panels_.size(); i-- > 0;) {
+      const auto &candidate = panels_[i];
+      if (candidate.device.empty() && event.x >= candidate.x &&
+          event.y >= candidate.y && event.x < candidate.x + candidate.width &&
+          event.y < candidate.y + candidate.height) {
+        panel = i;
+        break;
+      }
+    }
+  }
+
+  if (event.phase == kDown && capture == captures_.end() &&
+      panel < panels_.size()) {
+    captures_.push_back({event.device, panel});
+  } else if ((event.phase == kUp || event.phase == kCancel) &&
+             capture != captures_.end()) {
+    captures_.erase(capture);
+  }
+  return panel;
+}
+
+// |InputReader::Delegate|
+void InputRouter::OnInputPointerEvents(const FlutterPointerEvent *events,
+                                       size_t count) {
+  if (monitor_ != nullptr) {
+    monitor_->OnInputPointerEvents(events, count);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    auto event = events[i];
+
+    size_t panel = FindBoundPanel(event.device);
+    if (panel < panels_.size()) {
+      event.x = event.x * panels_[panel].width / width_;
+      event.y = event.y * panels_[panel].height / height_;
+    } else {
+      panel = FindPanel(event);
+      if (panel == panels_.size()) {
+        // Between panels, or part of a contact that went down there.
+        continue;
+      }
+      event.x -= panels_[panel].x;
+      event.y -= panels_[panel].y;
+      if (event.phase == kDown) {
+        touched_panel_ = panel;
+      }
+    }
+    batches_[panel].push_back(event);
+  }
+
+  for (size_t i = 0; i < batches_.size(); ++i) {
+    if (!batches_[i].empty()) {
+      panels_[i].delegate->OnInputPointerEvents(batches_[i].data(),
+                                                batches_[i].size());
+      batches_[i].clear();
+    }
+  }
+}
+
+// |InputReader::Delegate|
+void InputRouter::OnInputKeyEvents(const InputKeyEvent *events,
+                                   size_t count) {
+  if (monitor_ != nullptr) {
+    monitor_->OnInputKeyEvents(events, count);
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  // A batch comes from a single device.
+  size_t panel = FindBoundPanel(events[0].device);
+  if (panel == panels_.size()) {
+    if (held_keys_ == 0) {
+      focused_panel_ = touched_panel_;
+    }
+    panel = focused_panel_;
+    for (size_t i = 0; i < count; ++i) {
+      if (events[i].pressed) {
+        held_keys_++;
+      } else if (held_keys_ > 0) {
+        held_keys_--;
+      }
+    }
+  }
+  if (panel < panels_.size() && panels_[panel].keyboard != nullptr) {
+    panels_[panel].keyboard->OnInputKeyEvents(events, count);
+  }
+}
+
+} // namespace flutter
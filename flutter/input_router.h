@@ -0,0 +1,105 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "input_reader.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Reads input devices on a single thread on behalf of several applications
+// and hands each the events meant for it. Panels are laid out in a shared
+// space that absolute devices span and mice move across. Contacts and clicks
+// go to the last panel added that contains them and stay with it until
+// released. Devices can also be tied to a panel, like the touch screen of a
+// second display, in which case they only reach that panel and span all of
+// it, and the panel takes no other input. Keyboards type into the last panel
+// a pointer went down on, or into the panel they are tied to.
+class InputRouter : public InputReader::Delegate {
+public:
+  struct Panel {
+    // Receives the panel's events, in panel coordinates, on the input thread.
+    InputReader::Delegate *delegate = nullptr;
+    // Receives the panel's key events on the input thread. Null for none.
+    InputReader::Delegate *keyboard = nullptr;
+    double x = 0.0;
+    double y = 0.0;
+    double width = 0.0;
+    double height = 0.0;
+    // A device path or part of a device name. Empty for none.
+    std::string device;
+  };
+
+  // The delegates must outlive the router. |monitor|, if any, sees every
+  // event first, in the shared space, like a cursor drawn over the panels.
+  explicit InputRouter(std::vector<Panel> panels,
+                       InputReader::Delegate *monitor = nullptr);
+
+  ~InputRouter() override;
+
+  // Opens the devices and starts reading them on a new thread.
+  bool Start();
+
+  // Stops reading. Once this returns, no delegate is called again.
+  void Stop();
+
+  // |InputReader::Delegate|
+  void OnInputPointerEvents(const FlutterPointerEvent *events,
+                            size_t count) override;
+
+  // |InputReader::Delegate|
+  void OnInputKeyEvents(const InputKeyEvent *events, size_t count) override;
+
+  // |InputReader::Delegate|
+  void OnInputDeviceAdded(int32_t first_device, size_t device_count,
+                          const std::string &path,
+                          const std::string &name) override;
+
+private:
+  struct Binding {
+    int32_t first_device;
+    int32_t end_device;
+    size_t panel;
+  };
+
+  struct Capture {
+    int32_t device;
+    size_t panel;
+  };
+
+  const std::vector<Panel> panels_;
+  InputReader::Delegate *const monitor_;
+  double width_ = 0.0;
+  double height_ = 0.0;
+  std::unique_ptr<InputReader> reader_;
+  std::thread thread_;
+  // Only touched on the input thread, and by |Start| before it exists.
+  std::vector<Binding> bindings_;
+  std::vector<Capture> captures_;
+  // The panel keyboards that aren't tied to one type into. Focus moves to
+  // the panel last touched once no keys are held, so that every key is
+  // released where it was pressed.
+  size_t focused_panel_ = 0;
+  size_t touched_panel_ = 0;
+  size_t held_keys_ = 0;
+  std::vector<std::vector<FlutterPointerEvent>> batches_;
+
+  // Returns the panel |device| is tied to, or |panels_.size()| if none.
+  size_t FindBoundPanel(int32_t device) const;
+
+  // Returns the panel |event| is for, or |panels_.size()| if none.
+  size_t FindPanel(const FlutterPointerEvent &event);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(InputRouter);
+};
+
+} // namespace flutter
@@ -0,0 +1,186 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "key_event_queue.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+// How long a key is held before it repeats, and how often it repeats then.
+// The same as the X server's defaults.
+static const uint64_t kRepeatDelayNanos = 660000000ull;
+static const uint64_t kRepeatIntervalNanos = 1000000000ull / 25;
+
+static timespec ToTimespec(uint64_t nanos) {
+  timespec time = {};
+  time.tv_sec = nanos / 1000000000ull;
+  time.tv_nsec = nanos % 1000000000ull;
+  return time;
+}
+
+KeyEventQueue::KeyEventQueue(EventLoop &loop, Sender sender)
+    : loop_(loop), sender_(std::move(sender)) {
+  wakeup_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wakeup_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the key event wakeup." << std::endl;
+    return;
+  }
+
+  repeat_timer_fd_ =
+      ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (repeat_timer_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the key repeat timer." << std::endl;
+    return;
+  }
+
+  if (!loop_.AddFD(wakeup_fd_, EPOLLIN, [this](uint32_t) { Drain(); })) {
+    return;
+  }
+  if (!loop_.AddFD(repeat_timer_fd_, EPOLLIN,
+                   [this](uint32_t) { Repeat(); })) {
+    loop_.RemoveFD(wakeup_fd_);
+    return;
+  }
+
+  valid_ = true;
+}
+
+KeyEventQueue::~KeyEventQueue() {
+  if (dropped_count_ > 0) {
+    FLWAY_ERROR << "Dropped " << dropped_count_
+                << " key events because the queue was full." << std::endl;
+  }
+
+  if (valid_) {
+    loop_.RemoveFD(repeat_timer_fd_);
+    loop_.RemoveFD(wakeup_fd_);
+  }
+
+  for (auto fd : {repeat_timer_fd_, wakeup_fd_}) {
+    if (fd != -1) {
+      ::close(fd);
+    }
+  }
+}
+
+bool KeyEventQueue::IsValid() const { return valid_; }
+
+// |InputReader::Delegate|
+void KeyEventQueue::OnInputPointerEvents(const FlutterPointerEvent *events,
+                                         size_t count) {
+  // Keyboards only.
+}
+
+// |InputReader::Delegate|
+void KeyEventQueue::OnInputKeyEvents(const InputKeyEvent *events,
+                                     size_t count) {
+  KeyMessage message;
+  bool pushed = false;
+  for (size_t i = 0; i < count; ++i) {
+    Keymap::Key key;
+    if (!keymap_.Translate(events[i].code, events[i].pressed, &key)) {
+      continue;
+    }
+
+    // flutter/keyevent uses the JSON message codec. snprintf formats
+    // integers without allocating.
+    const int size = ::snprintf(
+        message.data, sizeof(message.data),
+        R"({"type":"%s","keymap":"linux","toolkit":"glfw","keyCode":%d,)"
+        R"("scanCode":%u,"modifiers":%u,"unicodeScalarValues":%u})",
+        events[i].pressed ? "keydown" : "keyup", key.key_code, key.scan_code,
+        key.modifiers, key.code_point);
+    if (size <= 0 || static_cast<size_t>(size) >= sizeof(message.data)) {
+      continue;
+    }
+    message.timestamp = events[i].timestamp;
+    message.device = events[i].device;
+    message.code = events[i].code;
+    message.size = size;
+    message.pressed = events[i].pressed;
+    message.repeats = key.repeats;
+
+    if (ring_.Push(message)) {
+      pushed = true;
+    } else {
+      dropped_count_++;
+    }
+  }
+
+  if (pushed && !signaled_.exchange(true, std::memory_order_acq_rel)) {
+    uint64_t value = 1;
+    if (::write(wakeup_fd_, &value, sizeof(value)) != sizeof(value)) {
+      FLWAY_ERROR << "Could not signal the key event queue." << std::endl;
+    }
+  }
+}
+
+void KeyEventQueue::Drain() {
+  uint64_t value = 0;
+  while (::read(wakeup_fd_, &value, sizeof(value)) == -1 && errno == EINTR) {
+  }
+
+  // Messages pushed after this are either drained below or signal again.
+  signaled_.exchange(false, std::memory_order_acq_rel);
+
+  bool repeat_changed = false;
+  while (ring_.Pop(message_)) {
+    sender_(reinterpret_cast<const uint8_t *>(message_.data), message_.size,
+            message_.timestamp);
+
+    // The last key pressed repeats until it is released, like X does.
+    if (message_.pressed && message_.repeats) {
+      repeat_message_ = message_;
+      repeating_ = true;
+      repeat_changed = true;
+    } else if (!message_.pressed && repeating_ &&
+               message_.device == repeat_message_.device &&
+               message_.code == repeat_message_.code) {
+      repeating_ = false;
+      repeat_changed = true;
+    }
+  }
+
+  // Once per burst rather than per key, since scanners press and release
+  // every key within a few milliseconds.
+  if (repeat_changed) {
+    ArmRepeatTimer(repeating_);
+  }
+}
+
+void KeyEventQueue::Repeat() {
+  uint64_t expirations = 0;
+  if (::read(repeat_timer_fd_, &expirations, sizeof(expirations)) == -1) {
+    return;
+  }
+  // Expirations missed while the loop was busy are not made up for, or a
+  // stalled frame would be followed by a burst of repeats.
+  if (repeating_) {
+    sender_(reinterpret_cast<const uint8_t *>(repeat_message_.data),
+            repeat_message_.size, GetMonotonicTimeNanos() / 1000);
+  }
+}
+
+void KeyEventQueue::ArmRepeatTimer(bool arm) {
+  itimerspec spec = {};
+  if (arm) {
+    spec.it_value = ToTimespec(kRepeatDelayNanos);
+    spec.it_interval = ToTimespec(kRepeatIntervalNanos);
+  }
+  if (::timerfd_settime(repeat_timer_fd_, 0, &spec, nullptr) == -1) {
+    FLWAY_ERROR << "Could not set the key repeat timer: " << strerror(errno)
+                << std::endl;
+  }
+}
+
+} // namespace flutter
@@ -0,0 +1,90 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+
+#include "event_loop.h"
+#include "input_reader.h"
+#include "keymap.h"
+#include "macros.h"
+#include "spsc_ring.h"
+
+namespace flutter {
+
+// Turns key events from the input reader thread into flutter/keyevent
+// messages for the engine and hands them to the event loop without locks or
+// allocations, so that barcode scanners typing hundreds of keys a second cost
+// little more than a copy each. Messages are encoded on the input thread into
+// fixed slots of a ring, and everything that arrived since the loop last woke
+// up is sent in one iteration. Held keys are repeated by a timer on the loop.
+class KeyEventQueue : public InputReader::Delegate {
+public:
+  // Called on the event loop with each JSON message. |timestamp| is when the
+  // key changed, in microseconds.
+  using Sender =
+      std::function<void(const uint8_t *message, size_t size,
+                         uint64_t timestamp)>;
+
+  // Must be created on |loop|'s thread.
+  KeyEventQueue(EventLoop &loop, Sender sender);
+
+  // Must be destroyed on |loop|'s thread once the reader has stopped.
+  ~KeyEventQueue() override;
+
+  bool IsValid() const;
+
+  // |InputReader::Delegate|
+  void OnInputPointerEvents(const FlutterPointerEvent *events,
+                            size_t count) override;
+
+  // |InputReader::Delegate|
+  void OnInputKeyEvents(const InputKeyEvent *events, size_t count) override;
+
+private:
+  // Large enough for the longest message the encoder writes.
+  struct KeyMessage {
+    uint64_t timestamp;
+    int32_t device;
+    uint16_t code;
+    uint16_t size;
+    bool pressed;
+    bool repeats;
+    char data[160];
+  };
+
+  EventLoop &loop_;
+  Sender sender_;
+  int wakeup_fd_ = -1;
+  int repeat_timer_fd_ = -1;
+  bool valid_ = false;
+
+  // Only touched on the input thread.
+  Keymap keymap_;
+  size_t dropped_count_ = 0;
+
+  SPSCRing<KeyMessage, 512> ring_;
+  // Set by the input thread when it signals the wakeup and cleared by the
+  // loop before draining, so that a burst costs one write and one wakeup.
+  std::atomic<bool> signaled_{false};
+
+  // Only touched on the loop.
+  KeyMessage message_ = {};
+  KeyMessage repeat_message_ = {};
+  bool repeating_ = false;
+
+  void Drain();
+
+  void Repeat();
+
+  void ArmRepeatTimer(bool arm);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(KeyEventQueue);
+};
+
+} // namespace flutter
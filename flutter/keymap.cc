@@ -0,0 +1,235 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "keymap.h"
+
+#include <linux/input.h>
+
+namespace flutter {
+
+// GLFW key codes that are treated specially.
+static const int32_t kGLFWKeyCapsLock = 280;
+static const int32_t kGLFWKeyNumLock = 282;
+static const int32_t kGLFWKeyKeypad0 = 320;
+static const int32_t kGLFWKeyKeypadDecimal = 330;
+static const int32_t kGLFWKeyLeftShift = 340;
+static const int32_t kGLFWKeyMenu = 348;
+
+// X11 key codes are Linux ones offset by the 8 codes X reserves.
+static const uint32_t kScanCodeOffset = 8;
+
+struct KeyMapping {
+  uint16_t code;
+  int16_t key_code;
+  // What the key types on a US layout without and with shift. Zero for
+  // keys that don't type.
+  char normal;
+  char shifted;
+};
+
+static const KeyMapping kKeyMappings[] = {
+    {KEY_ESC, 256, 0, 0},
+    {KEY_1, '1', '1', '!'},
+    {KEY_2, '2', '2', '@'},
+    {KEY_3, '3', '3', '#'},
+    {KEY_4, '4', '4', '$'},
+    {KEY_5, '5', '5', '%'},
+    {KEY_6, '6', '6', '^'},
+    {KEY_7, '7', '7', '&'},
+    {KEY_8, '8', '8', '*'},
+    {KEY_9, '9', '9', '('},
+    {KEY_0, '0', '0', ')'},
+    {KEY_MINUS, '-', '-', '_'},
+    {KEY_EQUAL, '=', '=', '+'},
+    {KEY_BACKSPACE, 259, 0, 0},
+    {KEY_TAB, 258, 0, 0},
+    {KEY_Q, 'Q', 'q', 'Q'},
+    {KEY_W, 'W', 'w', 'W'},
+    {KEY_E, 'E', 'e', 'E'},
+    {KEY_R, 'R', 'r', 'R'},
+    {KEY_T, 'T', 't', 'T'},
+    {KEY_Y, 'Y', 'y', 'Y'},
+    {KEY_U, 'U', 'u', 'U'},
+    {KEY_I, 'I', 'i', 'I'},
+    {KEY_O, 'O', 'o', 'O'},
+    {KEY_P, 'P', 'p', 'P'},
+    {KEY_LEFTBRACE, '[', '[', '{'},
+    {KEY_RIGHTBRACE, ']', ']', '}'},
+    {KEY_ENTER, 257, 0, 0},
+    {KEY_LEFTCTRL, 341, 0, 0},
+    {KEY_A, 'A', 'a', 'A'},
+    {KEY_S, 'S', 's', 'S'},
+    {KEY_D, 'D', 'd', 'D'},
+    {KEY_F, 'F', 'f', 'F'},
+    {KEY_G, 'G', 'g', 'G'},
+    {KEY_H, 'H', 'h', 'H'},
+    {KEY_J, 'J', 'j', 'J'},
+    {KEY_K, 'K', 'k', 'K'},
+    {KEY_L, 'L', 'l', 'L'},
+    {KEY_SEMICOLON, ';', ';', ':'},
+    {KEY_APOSTROPHE, '\'', '\'', '"'},
+    {KEY_GRAVE, '`', '`', '~'},
+    {KEY_LEFTSHIFT, 340, 0, 0},
+    {KEY_BACKSLASH, '\\', '\\', '|'},
+    {KEY_Z, 'Z', 'z', 'Z'},
+    {KEY_X, 'X', 'x', 'X'},
+    {KEY_C, 'C', 'c', 'C'},
+    {KEY_V, 'V', 'v', 'V'},
+    {KEY_B, 'B', 'b', 'B'},
+    {KEY_N, 'N', 'n', 'N'},
+    {KEY_M, 'M', 'm', 'M'},
+    {KEY_COMMA, ',', ',', '<'},
+    {KEY_DOT, '.', '.', '>'},
+    {KEY_SLASH, '/', '/', '?'},
+    {KEY_RIGHTSHIFT, 344, 0, 0},
+    {KEY_KPASTERISK, 332, '*', '*'},
+    {KEY_LEFTALT, 342, 0, 0},
+    {KEY_SPACE, ' ', ' ', ' '},
+    {KEY_CAPSLOCK, kGLFWKeyCapsLock, 0, 0},
+    {KEY_F1, 290, 0, 0},
+    {KEY_F2, 291, 0, 0},
+    {KEY_F3, 292, 0, 0},
+    {KEY_F4, 293, 0, 0},
+    {KEY_F5, 294, 0, 0},
+    {KEY_F6, 295, 0, 0},
+    {KEY_F7, 296, 0, 0},
+    {KEY_F8, 297, 0, 0},
+    {KEY_F9, 298, 0, 0},
+    {KEY_F10, 299, 0, 0},
+    {KEY_NUMLOCK, kGLFWKeyNumLock, 0, 0},
+    {KEY_SCROLLLOCK, 281, 0, 0},
+    {KEY_KP7, 327, '7', '7'},
+    {KEY_KP8, 328, '8', '8'},
+    {KEY_KP9, 329, '9', '9'},
+    {KEY_KPMINUS, 333, '-', '-'},
+    {KEY_KP4, 324, '4', '4'},
+    {KEY_KP5, 325, '5', '5'},
+    {KEY_KP6, 326, '6', '6'},
+    {KEY_KPPLUS, 334, '+', '+'},
+    {KEY_KP1, 321, '1', '1'},
+    {KEY_KP2, 322, '2', '2'},
+    {KEY_KP3, 323, '3', '3'},
+    {KEY_KP0, 320, '0', '0'},
+    {KEY_KPDOT, 330, '.', '.'},
+    {KEY_102ND, 162, '\\', '|'},
+    {KEY_F11, 300, 0, 0},
+    {KEY_F12, 301, 0, 0},
+    {KEY_KPENTER, 335, 0, 0},
+    {KEY_RIGHTCTRL, 345, 0, 0},
+    {KEY_KPSLASH, 331, '/', '/'},
+    {KEY_SYSRQ, 283, 0, 0},
+    {KEY_RIGHTALT, 346, 0, 0},
+    {KEY_HOME, 268, 0, 0},
+    {KEY_UP, 265, 0, 0},
+    {KEY_PAGEUP, 266, 0, 0},
+    {KEY_LEFT, 263, 0, 0},
+    {KEY_RIGHT, 262, 0, 0},
+    {KEY_END, 269, 0, 0},
+    {KEY_DOWN, 264, 0, 0},
+    {KEY_PAGEDOWN, 267, 0, 0},
+    {KEY_INSERT, 260, 0, 0},
+    {KEY_DELETE, 261, 0, 0},
+    {KEY_KPEQUAL, 336, '=', '='},
+    {KEY_PAUSE, 284, 0, 0},
+    {KEY_LEFTMETA, 343, 0, 0},
+    {KEY_RIGHTMETA, 347, 0, 0},
+    {KEY_COMPOSE, kGLFWKeyMenu, 0, 0},
+    {KEY_F13, 302, 0, 0},
+    {KEY_F14, 303, 0, 0},
+    {KEY_F15, 304, 0, 0},
+    {KEY_F16, 305, 0, 0},
+    {KEY_F17, 306, 0, 0},
+    {KEY_F18, 307, 0, 0},
+    {KEY_F19, 308, 0, 0},
+    {KEY_F20, 309, 0, 0},
+    {KEY_F21, 310, 0, 0},
+    {KEY_F22, 311, 0, 0},
+    {KEY_F23, 312, 0, 0},
+    {KEY_F24, 313, 0, 0},
+};
+
+static_assert(sizeof(kKeyMappings) / sizeof(kKeyMappings[0]) < 255,
+              "Mappings must be indexable by a byte.");
+
+// The modifiers of the left then right shift, control, alt and super keys,
+// which GLFW numbers in that order.
+static const uint32_t kSideModifiers[] = {
+    kKeyModifierShift, kKeyModifierControl, kKeyModifierAlt,
+    kKeyModifierSuper, kKeyModifierShift,   kKeyModifierControl,
+    kKeyModifierAlt,   kKeyModifierSuper,
+};
+
+Keymap::Keymap() {
+  for (size_t i = 0; i < sizeof(kKeyMappings) / sizeof(kKeyMappings[0]);
+       ++i) {
+    mappings_[kKeyMappings[i].code] = i + 1;
+  }
+  // Num lock starts out on so that keypads type digits.
+  locks_ = kKeyModifierNumLock;
+}
+
+uint32_t Keymap::GetModifiers() const {
+  uint32_t modifiers = locks_;
+  for (size_t side = 0; side < 8; ++side) {
+    if (held_ & (1u << side)) {
+      modifiers |= kSideModifiers[side];
+    }
+  }
+  return modifiers;
+}
+
+bool Keymap::Translate(uint16_t code, bool pressed, Key *key) {
+  if (code >= sizeof(mappings_) || mappings_[code] == 0) {
+    return false;
+  }
+  const KeyMapping &mapping = kKeyMappings[mappings_[code] - 1];
+
+  // GLFW reports the modifiers as they were before the key changed them.
+  const uint32_t modifiers = GetModifiers();
+  key->key_code = mapping.key_code;
+  key->scan_code = code + kScanCodeOffset;
+  key->modifiers = modifiers;
+  key->code_point = 0;
+  key->repeats = true;
+
+  if (mapping.key_code >= kGLFWKeyLeftShift &&
+      mapping.key_code < kGLFWKeyMenu) {
+    const uint32_t side = 1u << (mapping.key_code - kGLFWKeyLeftShift);
+    held_ = pressed ? held_ | side : held_ & ~side;
+    key->repeats = false;
+    return true;
+  }
+  if (mapping.key_code == kGLFWKeyCapsLock ||
+      mapping.key_code == kGLFWKeyNumLock) {
+    if (pressed) {
+      locks_ ^= mapping.key_code == kGLFWKeyCapsLock ? kKeyModifierCapsLock
+                                                     : kKeyModifierNumLock;
+    }
+    key->repeats = false;
+    return true;
+  }
+
+  // Shortcuts type nothing, and neither do releases.
+  if (!pressed || mapping.normal == 0 ||
+      (modifiers &
+       (kKeyModifierControl | kKeyModifierAlt | kKeyModifierSuper))) {
+    return true;
+  }
+  if (mapping.key_code >= kGLFWKeyKeypad0 &&
+      mapping.key_code <= kGLFWKeyKeypadDecimal &&
+      !(modifiers & kKeyModifierNumLock)) {
+    return true;
+  }
+
+  bool shifted = modifiers & kKeyModifierShift;
+  if (mapping.key_code >= 'A' && mapping.key_code <= 'Z' &&
+      (modifiers & kKeyModifierCapsLock)) {
+    shifted = !shifted;
+  }
+  key->code_point = static_cast<unsigned char>(shifted ? mapping.shifted
+                                                       : mapping.normal);
+  return true;
+}
+
+} // namespace flutter
@@ -0,0 +1,61 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Modifier bits as GLFW reports them.
+enum KeyModifier : uint32_t {
+  kKeyModifierShift = 0x01,
+  kKeyModifierControl = 0x02,
+  kKeyModifierAlt = 0x04,
+  kKeyModifierSuper = 0x08,
+  kKeyModifierCapsLock = 0x10,
+  kKeyModifierNumLock = 0x20,
+};
+
+// Translates Linux key codes into what the framework's GLFW key helper
+// expects: GLFW key codes, X11 scan codes and the characters typed on a US
+// layout. Tracks held modifiers and locks across calls, which keyboards
+// feeding the same keymap share. Translation is a table lookup and never
+// allocates.
+class Keymap {
+public:
+  struct Key {
+    int32_t key_code = 0;
+    uint32_t scan_code = 0;
+    // The modifiers held before this key went down or up.
+    uint32_t modifiers = 0;
+    // The Unicode scalar value a press types, or zero.
+    uint32_t code_point = 0;
+    // Modifiers and locks don't repeat while held.
+    bool repeats = false;
+  };
+
+  Keymap();
+
+  // Returns false for keys GLFW has no code for. Those don't change the
+  // modifiers.
+  bool Translate(uint16_t code, bool pressed, Key *key);
+
+private:
+  // Indexed by Linux key code. Zero for keys without a mapping, otherwise
+  // one more than the index of the mapping.
+  uint8_t mappings_[256] = {};
+  // Bits of the modifier keys held, by side.
+  uint32_t held_ = 0;
+  uint32_t locks_ = 0;
+
+  uint32_t GetModifiers() const;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Keymap);
+};
+
+} // namespace flutter
@@ -0,0 +1,356 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "logging.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+#include "utils.h"
+
+namespace flutter {
+
+// Longer messages are truncated.
+static const size_t kMaxMessageLength = 232;
+
+// Messages logged by a thread faster than the writer drains them are dropped
+// once this many are pending.
+static const size_t kRingCapacity = 64;
+
+// Each call site may log this many messages per window. The rest are counted
+// and reported with the next message let through.
+static const uint64_t kRateLimitWindowNanos = 1000000000ull;
+static const uint32_t kRateLimitBurst = 10;
+
+struct LogRecord {
+  uint64_t sequence;
+  const char *file;
+  int line;
+  LogSeverity severity;
+  uint32_t suppressed;
+  uint32_t length;
+  bool truncated;
+  char text[kMaxMessageLength];
+};
+
+struct LogRing {
+  SPSCRing<LogRecord, kRingCapacity> records;
+  std::atomic<size_t> dropped{0};
+  // Set when the producing thread exits. The ring is released once drained.
+  std::atomic<bool> orphaned{false};
+};
+
+// A fixed size buffer so that formatting does not allocate. Writes past the
+// end put the stream in a bad state, which makes further insertions no-ops.
+class LogStreamBuffer : public std::streambuf {
+public:
+  void Reset() { setp(buffer_, buffer_ + sizeof(buffer_)); }
+
+  const char *GetData() const { return pbase(); }
+
+  size_t GetSize() const { return pptr() - pbase(); }
+
+  bool IsFull() const { return pptr() == epptr(); }
+
+private:
+  char buffer_[kMaxMessageLength];
+};
+
+class LogWriter {
+public:
+  // Never destroyed so that messages logged during static destruction are not
+  // lost.
+  static LogWriter &Get() {
+    static LogWriter *writer = new LogWriter();
+    return *writer;
+  }
+
+  std::shared_ptr<LogRing> CreateRing() {
+    auto ring = std::make_shared<LogRing>();
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.push_back(ring);
+    return ring;
+  }
+
+  uint64_t NextSequence() {
+    return sequence_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void Submit(LogRing &ring, const LogRecord &record) {
+    if (synchronous_.load()) {
+      std::lock_guard<std::mutex> lock(drain_mutex_);
+      Write({record});
+      return;
+    }
+
+    if (!ring.records.Push(record)) {
+      ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (idle_.exchange(false)) {
+      uint64_t value = 1;
+      while (::write(wakeup_fd_, &value, sizeof(value)) == -1 &&
+             errno == EINTR) {
+      }
+    }
+  }
+
+  // Once the process starts exiting the writer thread may be gone, so later
+  // messages are written by the thread logging them.
+  void FlushAndWriteSynchronously() {
+    Flush();
+    synchronous_ = true;
+    Flush();
+  }
+
+  void Flush() {
+    while (Drain()) {
+    }
+  }
+
+private:
+  std::mutex rings_mutex_;
+  std::vector<std::shared_ptr<LogRing>> rings_;
+  // Held by whichever thread is consuming the rings.
+  std::mutex drain_mutex_;
+  std::vector<LogRecord> pending_;
+  std::atomic<uint64_t> sequence_{0};
+  std::atomic<bool> idle_{false};
+  std::atomic<bool> synchronous_{false};
+  int wakeup_fd_ = -1;
+
+  LogWriter() {
+    wakeup_fd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (wakeup_fd_ == -1) {
+      // Nowhere to report this but the console.
+      synchronous_ = true;
+      return;
+    }
+    ::atexit([]() { Get().FlushAndWriteSynchronously(); });
+    std::thread([this]() { Run(); }).detach();
+  }
+
+  void Run() {
+    // Signals are handled by the threads that expect them.
+    sigset_t signals;
+    ::sigfillset(&signals);
+    ::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    while (true) {
+      if (Drain()) {
+        continue;
+      }
+
+      // Producers signal the wakeup only if they see the writer idle. Check
+      // once more after going idle so that no message is left behind.
+      idle_ = true;
+      if (Drain()) {
+        continue;
+      }
+
+      uint64_t value = 0;
+      while (::read(wakeup_fd_, &value, sizeof(value)) == -1 &&
+             errno == EINTR) {
+      }
+    }
+  }
+
+  // Writes every pending message, ordered by when it was logged within this
+  // batch. Returns false if there were none.
+  bool Drain() {
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      rings = rings_;
+    }
+
+    size_t dropped = 0;
+    std::vector<LogRing *> released;
+    pending_.clear();
+    for (const auto &ring : rings) {
+      // Read before draining. Once set, nothing more will be pushed.
+      const bool orphaned = ring->orphaned.load();
+      LogRecord record;
+      while (ring->records.Pop(record)) {
+        pending_.push_back(record);
+      }
+      dropped += ring->dropped.exchange(0);
+      if (orphaned) {
+        released.push_back(ring.get());
+      }
+    }
+
+    if (!released.empty()) {
+      auto is_released = [&released](const std::shared_ptr<LogRing> &ring) {
+        return std::find(released.begin(), released.end(), ring.get()) !=
+               released.end();
+      };
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      rings_.erase(std::remove_if(rings_.begin(), rings_.end(), is_released),
+                   rings_.end());
+    }
+
+    if (pending_.empty() && dropped == 0) {
+      return false;
+    }
+
+    std::sort(pending_.begin(), pending_.end(),
+              [](const LogRecord &a, const LogRecord &b) {
+                return a.sequence < b.sequence;
+              });
+    Write(pending_);
+
+    if (dropped > 0) {
+      const auto message = "ERROR: Dropped " + std::to_string(dropped) +
+                           " log messages because they were logged faster "
+                           "than they could be written.\n";
+      WriteFully(STDERR_FILENO, message);
+    }
+    return true;
+  }
+
+  static void Write(const std::vector<LogRecord> &records) {
+    std::string out;
+    std::string err;
+    for (const auto &record : records) {
+      auto &stream = record.severity >= LogSeverity::kWarning ? err : out;
+      switch (record.severity) {
+      case LogSeverity::kDebug:
+        stream += "DEBUG: ";
+        break;
+      case LogSeverity::kInfo:
+        stream += "LOG: ";
+        break;
+      case LogSeverity::kWarning:
+        stream += "WARNING: ";
+        break;
+      case LogSeverity::kError:
+        stream += "ERROR: ";
+        break;
+      }
+      stream += record.file;
+      stream += ":";
+      stream += std::to_string(record.line);
+      stream += ": ";
+      stream.append(record.text, record.length);
+      if (record.truncated) {
+        stream += "...";
+      }
+      if (record.suppressed > 0) {
+        stream += " [" + std::to_string(record.suppressed) +
+                  " similar messages suppressed]";
+      }
+      stream += "\n";
+    }
+
+    // Anything already buffered by the streams goes first.
+    std::cout.flush();
+    WriteFully(STDOUT_FILENO, out);
+    WriteFully(STDERR_FILENO, err);
+  }
+
+  static void WriteFully(int fd, const std::string &data) {
+    size_t written = 0;
+    while (written < data.size()) {
+      const auto result =
+          ::write(fd, data.data() + written, data.size() - written);
+      if (result == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return;
+      }
+      written += result;
+    }
+  }
+
+  LogWriter(const LogWriter &) = delete;
+  void operator=(const LogWriter &) = delete;
+};
+
+// Everything a thread needs to log without locking or allocating.
+struct ThreadLogState {
+  LogStreamBuffer buffer;
+  std::ostream stream{&buffer};
+  std::shared_ptr<LogRing> ring = LogWriter::Get().CreateRing();
+
+  ~ThreadLogState() { ring->orphaned = true; }
+};
+
+static ThreadLogState &GetThreadLogState() {
+  static thread_local ThreadLogState state;
+  return state;
+}
+
+bool LogSite::Admit(uint64_t now_nanos, uint32_t &suppressed) {
+  auto window_start = window_start_.load(std::memory_order_relaxed);
+  if (now_nanos - window_start >= kRateLimitWindowNanos &&
+      window_start_.compare_exchange_strong(window_start, now_nanos)) {
+    window_count_ = 0;
+  }
+
+  if (window_count_.fetch_add(1, std::memory_order_relaxed) >=
+      kRateLimitBurst) {
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  suppressed = suppressed_.exchange(0);
+  return true;
+}
+
+LogMessage::LogMessage(LogSeverity severity, const char *file, int line,
+                       LogSite &site)
+    : severity_(severity), file_(file), line_(line) {
+  auto &state = GetThreadLogState();
+  admitted_ = site.Admit(GetMonotonicTimeNanos(), suppressed_);
+  state.buffer.Reset();
+  state.stream.clear(admitted_ ? std::ios::goodbit : std::ios::badbit);
+}
+
+LogMessage::~LogMessage() {
+  if (!admitted_) {
+    return;
+  }
+
+  auto &state = GetThreadLogState();
+  LogRecord record;
+  record.sequence = LogWriter::Get().NextSequence();
+  record.file = file_;
+  record.line = line_;
+  record.severity = severity_;
+  record.suppressed = suppressed_;
+  record.truncated = state.buffer.IsFull();
+
+  // Messages conventionally end with std::endl. The writer adds the newline.
+  size_t length = state.buffer.GetSize();
+  while (length > 0 && state.buffer.GetData()[length - 1] == '\n') {
+    length--;
+  }
+  ::memcpy(record.text, state.buffer.GetData(), length);
+  record.length = length;
+
+  LogWriter::Get().Submit(*state.ring, record);
+}
+
+std::ostream &LogMessage::stream() { return GetThreadLogState().stream; }
+
+void FlushLogs() { LogWriter::Get().Flush(); }
+
+} // namespace flutter
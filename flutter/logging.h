@@ -0,0 +1,102 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <iostream>
+
+// Messages below this severity are compiled out. Set by the build.
+#define FLWAY_LOG_SEVERITY_DEBUG 0
+#define FLWAY_LOG_SEVERITY_INFO 1
+#define FLWAY_LOG_SEVERITY_WARNING 2
+#define FLWAY_LOG_SEVERITY_ERROR 3
+
+#ifndef FLWAY_MIN_LOG_SEVERITY
+#define FLWAY_MIN_LOG_SEVERITY FLWAY_LOG_SEVERITY_INFO
+#endif
+
+namespace flutter {
+
+enum class LogSeverity {
+  kDebug = FLWAY_LOG_SEVERITY_DEBUG,
+  kInfo = FLWAY_LOG_SEVERITY_INFO,
+  kWarning = FLWAY_LOG_SEVERITY_WARNING,
+  kError = FLWAY_LOG_SEVERITY_ERROR,
+};
+
+// Per call site state used to rate limit messages that repeat, such as an
+// error logged on every frame.
+class LogSite {
+public:
+  constexpr LogSite() = default;
+
+  // Returns false if the message should be dropped. Otherwise |suppressed| is
+  // the number of messages dropped since the last one let through.
+  bool Admit(uint64_t now_nanos, uint32_t &suppressed);
+
+private:
+  std::atomic<uint64_t> window_start_{0};
+  std::atomic<uint32_t> window_count_{0};
+  std::atomic<uint32_t> suppressed_{0};
+
+  LogSite(const LogSite &) = delete;
+  void operator=(const LogSite &) = delete;
+};
+
+// Formats one message into a buffer owned by the calling thread and hands it
+// to a background writer when destroyed, so that logging never blocks on the
+// console. Messages from one thread are written in the order they were
+// logged. Those from different threads are only ordered within the batch the
+// writer drains, so one that reaches its ring late may follow newer ones.
+class LogMessage {
+public:
+  LogMessage(LogSeverity severity, const char *file, int line, LogSite &site);
+
+  ~LogMessage();
+
+  std::ostream &stream();
+
+private:
+  const LogSeverity severity_;
+  const char *const file_;
+  const int line_;
+  uint32_t suppressed_ = 0;
+  bool admitted_ = false;
+
+  LogMessage(const LogMessage &) = delete;
+  void operator=(const LogMessage &) = delete;
+};
+
+// Lets the conditional in the logging macros have void type on both sides.
+struct LogMessageVoidify {
+  void operator&(std::ostream &) {}
+};
+
+// Writes out every message logged so far. Blocks.
+void FlushLogs();
+
+} // namespace flutter
+
+#define __FLWAY_LOG_SITE                                                       \
+  ([]() -> ::flutter::LogSite & {                                              \
+    static ::flutter::LogSite site;                                            \
+    return site;                                                               \
+  }())
+
+// The severity check is a constant so that disabled messages are compiled out.
+#define __FLWAY_LOG(level, severity)                                           \
+  (FLWAY_LOG_SEVERITY_##level < FLWAY_MIN_LOG_SEVERITY)                        \
+      ? (void)0                                                                \
+      : ::flutter::LogMessageVoidify() &                                       \
+            ::flutter::LogMessage(::flutter::LogSeverity::severity, __FILE__,  \
+                                  __LINE__, __FLWAY_LOG_SITE)                  \
+                .stream()
+
+#define FLWAY_DLOG __FLWAY_LOG(DEBUG, kDebug)
+#define FLWAY_LOG __FLWAY_LOG(INFO, kInfo)
+#define FLWAY_WARNING __FLWAY_LOG(WARNING, kWarning)
+#define FLWAY_ERROR __FLWAY_LOG(ERROR, kError)
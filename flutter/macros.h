@@ -6,6 +6,8 @@
 
 #include <iostream>
 
+#include "logging.h"
+
 #define FLWAY_DISALLOW_COPY(TypeName) TypeName(const TypeName&) = delete;
 
 #define FLWAY_DISALLOW_ASSIGN(TypeName) \
@@ -15,9 +17,7 @@
   FLWAY_DISALLOW_COPY(TypeName)                  \
   FLWAY_DISALLOW_ASSIGN(TypeName)
 
-#define __FLWAY_LINE_PREFIX << __FILE__ << ":" << __LINE__ << ": "
-#define FLWAY_LOG std::cout << "LOG: " __FLWAY_LINE_PREFIX
-#define FLWAY_ERROR std::cerr << "ERROR: " __FLWAY_LINE_PREFIX
 #define FLWAY_WIP                                          \
+  ::flutter::FlushLogs();                                  \
   std::cerr << "Work In Progress. Aborting." << std::endl; \
   abort();
@@ -2,23 +2,48 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 #include <unistd.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "asset_preloader.h"
+#include "cursor.h"
+#include "event_loop.h"
 #include "flutter_application.h"
-#include "pi_display.h"
+#include "frame_capture.h"
+#include "framebuffer_display.h"
+#include "headless_display.h"
+#include "input_router.h"
+#include "mapped_file.h"
+#include "memory_pressure_monitor.h"
+#include "planes.h"
+#include "shader_cache.h"
+#include "startup_timeline.h"
+#include "test_pattern_producer.h"
+#include "thread_policy.h"
 #include "utils.h"
 
+#if FLWAY_ENABLE_PI_DISPLAY
+#include "pi_display.h"
+#endif
+
 namespace flutter {
 
 static void PrintUsage() {
+  // Keep the reason for the failure above the usage.
+  FlushLogs();
   std::cerr << "Flutter Raspberry Pi" << std::endl << std::endl;
   std::cerr << "========================" << std::endl;
   std::cerr << "Usage: `" << GetExecutableName()
-            << " <asset_bundle_path> <flutter_flags>`" << std::endl
+            << " <embedder_flags> <asset_bundle_path> <flutter_flags>`"
+            << std::endl
             << std::endl;
   std::cerr << R"~(
 This utility runs an instance of a Flutter application and renders using
@@ -26,13 +51,124 @@ Video Core APIs.
 
 The Flutter tools can be obtained at https://flutter.io/
 
+   embedder_flags: Flags consumed by this utility and not forwarded to the
+                   engine.
+                   --renderer=pi|fbdev|memfd|headless
+                       pi: OpenGL ES via Video Core (default).
+                       fbdev: Software rendering into a framebuffer device.
+                       memfd: Software rendering into shared memory.
+                       headless: OpenGL ES into an offscreen framebuffer.
+                   --fbdev-path=<path>
+                       The framebuffer device. Defaults to /dev/fb0.
+                   --surface-size=<width>x<height>
+                       Size of the memfd or headless surface. Defaults to
+                       800x480.
+                   --memfd-format=rgba8888|bgra8888|rgb565
+                       Pixel format of the memfd surface. Defaults to
+                       bgra8888.
+                   --headless-dump=<path>
+                       Append each headless frame to this file as raw top
+                       down RGBA pixels.
+                   --pi-display=<number>
+                       The Video Core display to render to. 0 is the main
+                       LCD (default), 2 and 7 the HDMI ports of a Pi 4.
+                   --pi-layer=<layer>
+                       The dispmanx layer to render on. Higher layers are
+                       shown over lower ones. Defaults to 0.
+                   --geometry=<width>x<height>[+<x>+<y>]
+                       Where the application goes. The pi renderer renders
+                       to this area of the display and the memfd and
+                       headless renderers make surfaces this size. Input
+                       devices span the area covering every panel.
+                   --panel=<asset_bundle_path>[,<option>,<option>...]
+                       Run another application in the same process, on its
+                       own display or on part or a layer of the same one.
+                       The options pi-display=, pi-layer=, geometry= and
+                       fbdev-path= override the flags above. input=<device>
+                       ties the input devices with this path, or with names
+                       containing it, to the panel. May be repeated. The
+                       applications share the engine's memory and the
+                       Flutter flags. Stats, capture, recording, replay and
+                       the test pattern only apply to the first.
+                   --stats-interval=<seconds>
+                       Log frame timing and input latency percentiles,
+                       and how often the platform thread woke up, at this
+                       interval.
+                   --stats-export=<path>|unix:<socket_path>
+                       Also write each summary as a line of JSON to a file
+                       or Unix datagram socket.
+                   --platform-thread=<policy>
+                   --ui-thread=<policy>
+                   --raster-thread=<policy>
+                   --io-thread=<policy>
+                   --input-thread=<policy>
+                       CPU placement and priority of each thread as a comma
+                       separated list of cpus=<list>, fifo=<1-99> and
+                       nice=<-20-19>, e.g. cpus=2+3,fifo=10. CPU lists are
+                       CPUs or ranges joined with '+'. SCHED_FIFO needs
+                       CAP_SYS_NICE or an RLIMIT_RTPRIO.
+                   --memory-pressure-stall=<stall_ms>/<window_ms>
+                       Tell Dart code to drop its caches when tasks stall
+                       on memory this long within the window. Defaults to
+                       150/2000. Pass 0 to disable the monitor.
+                   --memory-pressure-available=<percent>
+                       Without pressure stall information, the share of
+                       memory that must stay available. Defaults to 10.
+                   --record-input=<path>
+                       Record pointer input to this file for replay.
+                   --replay-input=<path>
+                       Replay recorded input instead of reading input
+                       devices, then log frame stats and exit.
+                   --replay-speed=realtime|fast
+                       Keep the recorded timing (default) or deliver input
+                       as fast as the embedder takes it.
+                   --capture=<path>
+                       Write presented frames to this file or FIFO as a
+                       sequence of QOI images. Frames are read back and
+                       compressed without blocking the raster thread.
+                   --capture-frames=<count>
+                       Stop capturing after this many frames. 1 takes a
+                       screenshot. Defaults to no limit.
+                   --shader-cache=<path>|off
+                       Keep compiled shaders in this directory across
+                       launches. Defaults to <executable>/shaders in
+                       $XDG_CACHE_HOME, ~/.cache or /var/cache.
+                   --shader-cache-size=<MiB>
+                       Evict the least recently used shaders beyond this
+                       size. Defaults to 32.
+                   --warm-up-shaders[=<route>,<route>...]
+                       Show each route for two seconds (and replay input
+                       if --replay-input is given), then exit and ship the
+                       shaders compiled on the way in the bundle's
+                       shader_cache directory. Meant for a build machine
+                       with --renderer=headless.
+                   --test-pattern=<width>x<height>
+                       Register an external texture fed with a moving test
+                       pattern at 60 frames per second. Its ID is logged.
+                   --test-pattern-plane=<width>x<height>[+<x>+<y>]
+                       Show a moving test pattern on a video plane under
+                       the application instead, where it leaves the screen
+                       transparent. The application draws no frame for it.
+                   --background=#<rrggbb>|<path>
+                       Fill a plane under the application with this color,
+                       or show this QOI image centered on it. Shows before
+                       the application presents and through transparent
+                       parts of its frames.
+                   --cursor
+                       Draw the mouse pointer on a plane over the
+                       application. Moving it costs the application no
+                       frame. Touches hide it.
+
 asset_bundle_path: The Flutter application code needs to be snapshotted using
                    the Flutter tools and the assets packaged in the appropriate
                    location. This can be done for any Flutter application by
                    running `flutter build bundle` while in the directory of a
                    valid Flutter project. This should package all the code and
                    assets in the "build/flutter_assets" directory. Specify this
-                   directory as the first argument to this utility.
+                   directory as the first argument to this utility. Release
+                   engines need AOT snapshots in the bundle instead, either as
+                   vm_snapshot_data, vm_snapshot_instr, isolate_snapshot_data
+                   and isolate_snapshot_instr or as an app.so ELF library.
 
     flutter_flags: Typically empty. These extra flags are passed directly to the
                    Flutter engine. To see all supported flags, run
@@ -41,8 +177,636 @@ asset_bundle_path: The Flutter application code needs to be snapshotted using
 )~" << std::endl;
 }
 
+static bool ParsePixelFormat(const std::string &name, PixelFormat *format) {
+  if (name == "rgba8888") {
+    *format = PixelFormat::kRGBA8888;
+  } else if (name == "bgra8888") {
+    *format = PixelFormat::kBGRA8888;
+  } else if (name == "rgb565") {
+    *format = PixelFormat::kRGB565;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+struct Geometry {
+  size_t x = 0;
+  size_t y = 0;
+  // Zero if not given.
+  size_t width = 0;
+  size_t height = 0;
+};
+
+// Parses geometries of the form "800x480+0+0", where the offset is optional.
+static bool ParseGeometry(const std::string &string, Geometry *geometry) {
+  if (string.empty()) {
+    *geometry = Geometry{};
+    return true;
+  }
+  const auto offset = string.find('+');
+  unsigned long x = 0;
+  unsigned long y = 0;
+  char trailing = 0;
+  if (!ParseSize(string.substr(0, offset), &geometry->width,
+                 &geometry->height) ||
+      (offset != std::string::npos &&
+       ::sscanf(string.c_str() + offset, "+%lu+%lu%c", &x, &y, &trailing) !=
+           2)) {
+    return false;
+  }
+  geometry->x = x;
+  geometry->y = y;
+  return true;
+}
+
+struct DisplayOptions {
+  std::string renderer = "pi";
+  std::string fbdev_path = "/dev/fb0";
+  std::string surface_size = "800x480";
+  std::string memfd_format = "bgra8888";
+  std::string headless_dump;
+  std::string pi_display = "0";
+  std::string pi_layer = "0";
+  std::string geometry;
+};
+
+static DisplayOptions ExtractDisplayOptions(std::vector<std::string> &args) {
+  DisplayOptions options;
+  ExtractFlag(args, "--renderer", &options.renderer);
+  ExtractFlag(args, "--fbdev-path", &options.fbdev_path);
+  ExtractFlag(args, "--surface-size", &options.surface_size);
+  ExtractFlag(args, "--memfd-format", &options.memfd_format);
+  ExtractFlag(args, "--headless-dump", &options.headless_dump);
+  ExtractFlag(args, "--pi-display", &options.pi_display);
+  ExtractFlag(args, "--pi-layer", &options.pi_layer);
+  ExtractFlag(args, "--geometry", &options.geometry);
+  return options;
+}
+
+static std::unique_ptr<Display> CreateDisplay(const DisplayOptions &options) {
+  Geometry geometry;
+  if (!ParseGeometry(options.geometry, &geometry)) {
+    FLWAY_ERROR << "Invalid geometry: " << options.geometry << std::endl;
+    return nullptr;
+  }
+
+#if FLWAY_ENABLE_PI_DISPLAY
+  if (options.renderer == "pi") {
+    PiDisplay::Config config;
+    config.display = ::strtoul(options.pi_display.c_str(), nullptr, 10);
+    config.layer = ::atoi(options.pi_layer.c_str());
+    config.x = geometry.x;
+    config.y = geometry.y;
+    config.width = geometry.width;
+    config.height = geometry.height;
+    return std::make_unique<PiDisplay>(config);
+  }
+#endif
+
+  if (options.renderer == "fbdev") {
+    return std::make_unique<FramebufferDisplay>(options.fbdev_path);
+  }
+
+  size_t width = geometry.width;
+  size_t height = geometry.height;
+  if (width == 0 && !ParseSize(options.surface_size, &width, &height)) {
+    FLWAY_ERROR << "Invalid surface size: " << options.surface_size
+                << std::endl;
+    return nullptr;
+  }
+
+  if (options.renderer == "headless") {
+    return std::make_unique<HeadlessDisplay>(width, height,
+                                             options.headless_dump);
+  }
+
+  if (options.renderer == "memfd") {
+    PixelFormat format = PixelFormat::kBGRA8888;
+    if (!ParsePixelFormat(options.memfd_format, &format)) {
+      FLWAY_ERROR << "Invalid pixel format: " << options.memfd_format
+                  << std::endl;
+      return nullptr;
+    }
+    return std::make_unique<FramebufferDisplay>(width, height, format);
+  }
+
+  FLWAY_ERROR << "Unknown renderer: " << options.renderer << std::endl;
+  return nullptr;
+}
+
+// Routes SIGINT and SIGTERM to the event loop so that shutdown happens in an
+// orderly fashion on the platform thread. SIGHUP also ends the loop but sets
+// |restart_requested| so that the engine is relaunched. Must be called before
+// any threads are created so that they inherit the signal mask.
+static int WatchSignals(EventLoop &loop, bool *restart_requested) {
+  sigset_t signals;
+  ::sigemptyset(&signals);
+  ::sigaddset(&signals, SIGINT);
+  ::sigaddset(&signals, SIGTERM);
+  ::sigaddset(&signals, SIGHUP);
+  if (::pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0) {
+    return -1;
+  }
+
+  const int fd = ::signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+  if (fd == -1) {
+    return -1;
+  }
+
+  loop.AddFD(fd, EPOLLIN, [fd, &loop, restart_requested](uint32_t) {
+    signalfd_siginfo info = {};
+    if (::read(fd, &info, sizeof(info)) != sizeof(info)) {
+      return;
+    }
+    *restart_requested = info.ssi_signo == SIGHUP;
+    FLWAY_LOG << "Received signal " << info.ssi_signo << ". "
+              << (*restart_requested ? "Restarting the engine."
+                                     : "Shutting down.")
+              << std::endl;
+    loop.Terminate();
+  });
+  return fd;
+}
+
+static bool ExtractThreadPolicies(std::vector<std::string> &args) {
+  const ThreadRole roles[] = {ThreadRole::kPlatform, ThreadRole::kUI,
+                              ThreadRole::kRaster, ThreadRole::kIO,
+                              ThreadRole::kInput};
+  for (const auto role : roles) {
+    const auto flag = std::string("--") + GetThreadRoleName(role) + "-thread";
+    std::string spec;
+    if (!ExtractFlag(args, flag, &spec)) {
+      continue;
+    }
+    ThreadPolicy policy;
+    if (!ParseThreadPolicy(spec, &policy)) {
+      FLWAY_ERROR << "Invalid thread policy: " << flag << "=" << spec
+                  << std::endl;
+      return false;
+    }
+    SetThreadPolicy(role, policy);
+  }
+  return true;
+}
+
+// Returns false if the flags are malformed. |enabled| is cleared if the
+// monitor is turned off.
+static bool ExtractMemoryPressureConfig(std::vector<std::string> &args,
+                                        MemoryPressureMonitor::Config *config,
+                                        bool *enabled) {
+  *enabled = true;
+
+  std::string stall;
+  if (ExtractFlag(args, "--memory-pressure-stall", &stall)) {
+    if (stall == "0") {
+      *enabled = false;
+    } else {
+      unsigned stall_ms = 0;
+      unsigned window_ms = 0;
+      if (::sscanf(stall.c_str(), "%u/%u", &stall_ms, &window_ms) != 2) {
+        FLWAY_ERROR << "Invalid memory pressure stall: " << stall
+                    << std::endl;
+        return false;
+      }
+      config->stall_ms = stall_ms;
+      config->window_ms = window_ms;
+    }
+  }
+
+  std::string available;
+  if (ExtractFlag(args, "--memory-pressure-available", &available)) {
+    config->min_available_percent = ::atof(available.c_str());
+  }
+  return true;
+}
+
+// How long each route is shown for while warming up the shader cache.
+static const uint64_t kWarmUpRouteNanos = 2000000000ull;
+
+// How long to wait before trying again when a relaunch fails.
+static const uint64_t kRelaunchRetryNanos = 1000000000ull;
+
+static std::string GetDefaultShaderCacheDirectory() {
+  std::string base;
+  if (auto cache_home = ::getenv("XDG_CACHE_HOME")) {
+    base = cache_home;
+  } else if (auto home = ::getenv("HOME")) {
+    base = std::string(home) + "/.cache";
+  } else {
+    base = "/var/cache";
+  }
+  return base + "/" + GetExecutableName() + "/shaders";
+}
+
+static std::vector<std::string> SplitList(const std::string &list) {
+  std::vector<std::string> items;
+  size_t begin = 0;
+  while (begin < list.size()) {
+    auto end = list.find(',', begin);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    if (end > begin) {
+      items.push_back(list.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return items;
+}
+
+// Flags that apply to each launch of the engine.
+struct LaunchOptions {
+  std::string stats_interval;
+  std::string stats_export;
+  std::string record_input;
+  std::string replay_input;
+  std::string replay_speed = "realtime";
+  bool warm_up_shaders = false;
+  std::string warm_up_routes;
+  bool show_test_pattern = false;
+  std::string test_pattern;
+  std::string test_pattern_plane;
+  bool monitor_memory_pressure = true;
+  MemoryPressureMonitor::Config memory_pressure_config;
+};
+
+// An application and the display it renders to. Every panel runs on the same
+// event loop and input thread, and the engine shares the Dart VM, the ICU
+// data and its shader cache between them.
+struct Panel {
+  std::string asset_bundle_path;
+  DisplayOptions display_options;
+  // Where input devices find the panel.
+  Geometry geometry;
+  // See |InputRouter::Panel::device|.
+  std::string input_device;
+  std::unique_ptr<Display> display;
+  // Only the first panel has planes, and only if a flag asks for them. They
+  // stay up across relaunches.
+  PlaneAllocator *planes = nullptr;
+  std::unique_ptr<Plane> background;
+  std::unique_ptr<Cursor> cursor;
+};
+
+// Parses "<asset_bundle_path>,<option>,<option>..." where options override
+// |defaults|.
+static bool ParsePanel(const std::string &spec,
+                       const DisplayOptions &defaults, Panel *panel) {
+  const auto items = SplitList(spec);
+  if (items.empty()) {
+    return false;
+  }
+  panel->asset_bundle_path = items[0];
+  panel->display_options = defaults;
+  // Every panel would append to the same file.
+  panel->display_options.headless_dump.clear();
+  for (size_t i = 1; i < items.size(); ++i) {
+    const auto &item = items[i];
+    const auto equals = item.find('=');
+    const auto key = item.substr(0, equals);
+    const auto value =
+        equals == std::string::npos ? std::string() : item.substr(equals + 1);
+    if (key == "pi-display") {
+      panel->display_options.pi_display = value;
+    } else if (key == "pi-layer") {
+      panel->display_options.pi_layer = value;
+    } else if (key == "geometry") {
+      panel->display_options.geometry = value;
+    } else if (key == "fbdev-path") {
+      panel->display_options.fbdev_path = value;
+    } else if (key == "input") {
+      panel->input_device = value;
+    } else {
+      FLWAY_ERROR << "Unknown panel option: " << item << std::endl;
+      return false;
+    }
+  }
+  return ParseGeometry(panel->display_options.geometry, &panel->geometry);
+}
+
+// Fills a plane the size of the display with "#rrggbb" or shows the QOI image
+// at |spec| centered on it.
+static std::unique_ptr<Plane> CreateBackground(PlaneAllocator &planes,
+                                               const std::string &spec,
+                                               size_t width, size_t height) {
+  std::vector<uint8_t> pixels;
+  size_t image_width = width;
+  size_t image_height = height;
+  if (spec.size() == 7 && spec[0] == '#') {
+    char *end = nullptr;
+    const auto color = ::strtoul(spec.c_str() + 1, &end, 16);
+    if (*end != '\0') {
+      FLWAY_ERROR << "Invalid background color: " << spec << std::endl;
+      return nullptr;
+    }
+    pixels.resize(width * height * 4);
+    for (size_t i = 0; i < width * height; ++i) {
+      pixels[i * 4 + 0] = color & 0xff;
+      pixels[i * 4 + 1] = (color >> 8) & 0xff;
+      pixels[i * 4 + 2] = (color >> 16) & 0xff;
+      pixels[i * 4 + 3] = 255;
+    }
+  } else {
+    MappedFile file(spec);
+    if (!file.IsValid() || !DecodeQOI(file.GetMapping(), file.GetSize(),
+                                      pixels, &image_width, &image_height)) {
+      FLWAY_ERROR << "Could not read the background image " << spec << "."
+                  << std::endl;
+      return nullptr;
+    }
+  }
+
+  auto plane =
+      planes.AllocatePlane(PlaneKind::kBackground, image_width, image_height);
+  if (!plane || !plane->SetContents(pixels.data(), image_width * 4)) {
+    FLWAY_ERROR << "Could not show the background." << std::endl;
+    return nullptr;
+  }
+  plane->SetPosition(
+      (static_cast<int32_t>(width) - static_cast<int32_t>(image_width)) / 2,
+      (static_cast<int32_t>(height) - static_cast<int32_t>(image_height)) / 2);
+  plane->SetVisible(true);
+  planes.Commit();
+  return plane;
+}
+
+// The first panel's preloader also reads |icu_data_path|, which the engine
+// only loads once per process.
+static std::vector<std::unique_ptr<AssetPreloader>>
+StartPreloaders(const std::vector<Panel> &panels,
+                const std::string &icu_data_path, StartupTimeline &timeline) {
+  std::vector<std::unique_ptr<AssetPreloader>> preloaders;
+  for (const auto &panel : panels) {
+    preloaders.push_back(std::make_unique<AssetPreloader>(
+        panel.asset_bundle_path, preloaders.empty() ? icu_data_path : "",
+        timeline));
+  }
+  return preloaders;
+}
+
+// Returns whether every bundle was valid.
+static bool WaitForPreloaders(
+    std::vector<std::unique_ptr<AssetPreloader>> &preloaders) {
+  bool valid = true;
+  for (auto &preloader : preloaders) {
+    valid = preloader->Wait() && valid;
+  }
+  return valid;
+}
+
+// Launches an engine on each panel's display and runs |loop| until it is
+// terminated. Everything that refers to the engines lives and dies here, so
+// that they can be relaunched without touching the displays. Returns false if
+// the launch failed. |preloaders| are released once the engines have read
+// their bundles. Options that measure or drive an application apply to the
+// first panel.
+static bool RunApplications(std::vector<Panel> &panels,
+                            const std::vector<std::string> &args,
+                            EventLoop &loop, const ShaderCache *shader_cache,
+                            const LaunchOptions &options,
+                            std::vector<std::unique_ptr<AssetPreloader>>
+                                preloaders,
+                            StartupTimeline &timeline) {
+  // Tasks posted below may still be queued when the applications go away and
+  // hold weak references to them.
+  std::vector<std::shared_ptr<FlutterApplication>> applications;
+  std::unique_ptr<MemoryPressureMonitor> memory_pressure_monitor;
+  std::unique_ptr<TestPatternProducer> test_pattern_producer;
+  std::unique_ptr<TestPatternProducer> test_pattern_plane;
+  // Delivers to the applications, so it goes first.
+  std::unique_ptr<InputRouter> input_router;
+
+  {
+    // Threads inherit the placement and priority of the thread that creates
+    // them. The platform thread's policy only applies to itself.
+    ScopedDefaultThreadPolicy default_thread_policy;
+
+    // Engines after the first reuse the Dart VM and ICU data it set up, and
+    // launch faster.
+    const auto engine_begin = GetMonotonicTimeNanos();
+    for (auto &panel : panels) {
+      auto application = std::make_shared<FlutterApplication>(
+          panel.asset_bundle_path, args, *panel.display, loop, shader_cache);
+      if (!application->IsValid()) {
+        FLWAY_ERROR << "Flutter application was not valid." << std::endl;
+        return false;
+      }
+      if (!application->SetWindowSize(panel.display->GetWidth(),
+                                      panel.display->GetHeight())) {
+        FLWAY_ERROR << "Could not update Flutter application size."
+                    << std::endl;
+        return false;
+      }
+      applications.push_back(std::move(application));
+    }
+    const auto engine_end = GetMonotonicTimeNanos();
+    timeline.AddPhase("engine run", engine_begin, engine_end);
+
+    // The engines have read what they need. The pages stay cached.
+    preloaders.clear();
+
+    const auto &application = applications.front();
+
+    application->GetFrameStats().SetFirstPresentCallback(
+        [&timeline, engine_end](uint64_t end) {
+          timeline.AddPhase("first frame", engine_end, end);
+          timeline.Log();
+        });
+
+    if (!options.stats_interval.empty() &&
+        !application->GetFrameStats().StartReporting(
+            loop, ::atof(options.stats_interval.c_str()),
+            options.stats_export)) {
+      FLWAY_ERROR << "Could not start reporting frame stats." << std::endl;
+      return false;
+    }
+
+    std::weak_ptr<FlutterApplication> weak_application = application;
+
+    if (options.warm_up_shaders) {
+      uint64_t route_time = GetMonotonicTimeNanos();
+      for (const auto &route : SplitList(options.warm_up_routes)) {
+        route_time += kWarmUpRouteNanos;
+        loop.PostTask(
+            [weak_application, route]() {
+              if (auto application = weak_application.lock()) {
+                FLWAY_LOG << "Warming up " << route << "." << std::endl;
+                application->PushRoute(route);
+              }
+            },
+            route_time);
+      }
+      // A replay ends the run itself.
+      if (options.replay_input.empty()) {
+        loop.PostTask(
+            [&loop, weak_application]() {
+              if (!weak_application.expired()) {
+                loop.Terminate();
+              }
+            },
+            route_time + kWarmUpRouteNanos);
+      }
+    }
+
+    // Running without the monitor only costs the chance to shed caches
+    // early.
+    if (options.monitor_memory_pressure) {
+      memory_pressure_monitor = std::make_unique<MemoryPressureMonitor>(
+          loop, options.memory_pressure_config,
+          [&applications]() {
+            for (const auto &application : applications) {
+              application->NotifyMemoryPressure();
+            }
+          });
+      if (!memory_pressure_monitor->IsValid()) {
+        FLWAY_WARNING << "Not monitoring memory pressure." << std::endl;
+        memory_pressure_monitor.reset();
+      }
+    }
+
+    if (options.show_test_pattern) {
+      size_t width = 0;
+      size_t height = 0;
+      if (!ParseSize(options.test_pattern, &width, &height)) {
+        FLWAY_ERROR << "Invalid test pattern size: " << options.test_pattern
+                    << std::endl;
+        return false;
+      }
+      test_pattern_producer = std::make_unique<TestPatternProducer>(
+          *application, width, height, 60.0);
+      if (!test_pattern_producer->IsValid()) {
+        FLWAY_ERROR << "Could not start the test pattern." << std::endl;
+        return false;
+      }
+    }
+
+    if (!options.test_pattern_plane.empty()) {
+      Geometry geometry;
+      if (!ParseGeometry(options.test_pattern_plane, &geometry) ||
+          geometry.width == 0 || geometry.height == 0) {
+        FLWAY_ERROR << "Invalid test pattern plane: "
+                    << options.test_pattern_plane << std::endl;
+        return false;
+      }
+      test_pattern_plane = std::make_unique<TestPatternProducer>(
+          *panels[0].planes, geometry.width, geometry.height, geometry.x,
+          geometry.y, 60.0);
+      if (!test_pattern_plane->IsValid()) {
+        FLWAY_ERROR << "Could not show the test pattern on a plane."
+                    << std::endl;
+        return false;
+      }
+    }
+
+    if (!options.replay_input.empty()) {
+      if (options.replay_speed != "realtime" &&
+          options.replay_speed != "fast") {
+        FLWAY_ERROR << "Invalid replay speed: " << options.replay_speed
+                    << std::endl;
+        return false;
+      }
+      // Leave time for the last frames to be presented before summing up.
+      const auto on_done = [&loop, weak_application]() {
+        loop.PostTask(
+            [&loop, weak_application]() {
+              if (auto application = weak_application.lock()) {
+                application->GetFrameStats().ReportNow();
+                loop.Terminate();
+              }
+            },
+            GetMonotonicTimeNanos() + 500000000ull);
+      };
+      if (!application->ReplayInputEvents(options.replay_input,
+                                          options.replay_speed == "realtime",
+                                          on_done)) {
+        FLWAY_ERROR << "Could not replay input events." << std::endl;
+        return false;
+      }
+    } else {
+      application->SetInputRecordingPath(options.record_input);
+      std::vector<InputRouter::Panel> input_panels;
+      for (size_t i = 0; i < panels.size(); ++i) {
+        InputRouter::Panel input_panel;
+        input_panel.delegate = applications[i]->AcceptInputEvents();
+        input_panel.keyboard = applications[i]->AcceptKeyEvents();
+        input_panel.x = panels[i].geometry.x;
+        input_panel.y = panels[i].geometry.y;
+        input_panel.width = panels[i].display->GetWidth();
+        input_panel.height = panels[i].display->GetHeight();
+        input_panel.device = panels[i].input_device;
+        if (input_panel.delegate == nullptr) {
+          input_panels.clear();
+          break;
+        }
+        input_panels.push_back(std::move(input_panel));
+      }
+      input_router = std::make_unique<InputRouter>(std::move(input_panels),
+                                                   panels[0].cursor.get());
+      if (!input_router->Start()) {
+        FLWAY_ERROR << "Could not read input events." << std::endl;
+        input_router.reset();
+      }
+    }
+  }
+
+  // Applied once the other threads exist. Relaunches find it in place.
+  ApplyThreadPolicyOnce(ThreadRole::kPlatform);
+
+  loop.Run();
+
+  const auto shutdown_begin = GetMonotonicTimeNanos();
+  input_router.reset();
+  test_pattern_plane.reset();
+  test_pattern_producer.reset();
+  memory_pressure_monitor.reset();
+  applications.clear();
+  FLWAY_LOG << "The engine shut down in "
+            << (GetMonotonicTimeNanos() - shutdown_begin) / 1000000 << " ms."
+            << std::endl;
+  return true;
+}
+
 static bool Main(std::vector<std::string> args) {
-  if (args.size() == 0) {
+  StartupTimeline timeline;
+
+  const auto display_options = ExtractDisplayOptions(args);
+
+  LaunchOptions launch_options;
+  ExtractFlag(args, "--stats-interval", &launch_options.stats_interval);
+  ExtractFlag(args, "--stats-export", &launch_options.stats_export);
+  ExtractFlag(args, "--record-input", &launch_options.record_input);
+  ExtractFlag(args, "--replay-input", &launch_options.replay_input);
+  ExtractFlag(args, "--replay-speed", &launch_options.replay_speed);
+
+  std::string capture_path;
+  std::string capture_frames;
+  ExtractFlag(args, "--capture", &capture_path);
+  ExtractFlag(args, "--capture-frames", &capture_frames);
+
+  std::string shader_cache_path = GetDefaultShaderCacheDirectory();
+  std::string shader_cache_size;
+  ExtractFlag(args, "--shader-cache", &shader_cache_path);
+  ExtractFlag(args, "--shader-cache-size", &shader_cache_size);
+  const bool warm_up_shaders = launch_options.warm_up_shaders =
+      ExtractFlag(args, "--warm-up-shaders", &launch_options.warm_up_routes);
+
+  launch_options.show_test_pattern =
+      ExtractFlag(args, "--test-pattern", &launch_options.test_pattern);
+  ExtractFlag(args, "--test-pattern-plane",
+              &launch_options.test_pattern_plane);
+
+  std::string background;
+  ExtractFlag(args, "--background", &background);
+  const bool show_cursor = ExtractFlag(args, "--cursor", nullptr);
+
+  const auto panel_specs = ExtractFlagValues(args, "--panel");
+
+  if (!ExtractThreadPolicies(args) ||
+      !ExtractMemoryPressureConfig(args,
+                                   &launch_options.memory_pressure_config,
+                                   &launch_options.monitor_memory_pressure) ||
+      args.size() == 0) {
     std::cerr << "   <Invalid Arguments>   " << std::endl;
     PrintUsage();
     return false;
@@ -50,34 +814,191 @@ static bool Main(std::vector<std::string> args) {
 
   const auto asset_bundle_path = args[0];
 
-  if (!FlutterAssetBundleIsValid(asset_bundle_path)) {
-    std::cerr << "   <Invalid Flutter Asset Bundle>   " << std::endl;
-    PrintUsage();
+  std::vector<Panel> panels(1);
+  panels[0].asset_bundle_path = asset_bundle_path;
+  panels[0].display_options = display_options;
+  if (!ParseGeometry(display_options.geometry, &panels[0].geometry)) {
+    FLWAY_ERROR << "Invalid geometry: " << display_options.geometry
+                << std::endl;
+    return false;
+  }
+  for (const auto &spec : panel_specs) {
+    Panel panel;
+    if (!ParsePanel(spec, display_options, &panel)) {
+      FLWAY_ERROR << "Invalid panel: " << spec << std::endl;
+      return false;
+    }
+    panels.push_back(std::move(panel));
+  }
+
+  if (warm_up_shaders && panels.size() > 1) {
+    FLWAY_ERROR << "Shaders are warmed up for one application at a time."
+                << std::endl;
     return false;
   }
 
-  PiDisplay display;
+  EventLoop loop;
+
+  if (!loop.IsValid()) {
+    FLWAY_ERROR << "Could not create the event loop." << std::endl;
+    return false;
+  }
 
-  if (!display.IsValid()) {
-    FLWAY_ERROR << "Could not initialize the display." << std::endl;
+  bool restart_requested = false;
+  const int signal_fd = WatchSignals(loop, &restart_requested);
+  if (signal_fd == -1) {
+    FLWAY_ERROR << "Could not watch for termination signals." << std::endl;
     return false;
   }
 
-  FLWAY_LOG << "Display Size: " << display.GetWidth() << " x "
-            << display.GetHeight() << std::endl;
+  // The bundles are validated and the files the engines read at launch are
+  // paged in on background threads while the displays are brought up.
+  auto preloaders = StartPreloaders(
+      panels, GetICUDataPath(panels[0].asset_bundle_path), timeline);
 
-  FlutterApplication application(asset_bundle_path, args, display);
-  if (!application.IsValid()) {
-    FLWAY_ERROR << "Flutter application was not valid." << std::endl;
+  // Outlives the display and the application, which read frames into it.
+  std::unique_ptr<FrameCapture> frame_capture;
+
+  // Outlives the application so that warmed up shaders are only published
+  // once the engine is done writing them.
+  std::unique_ptr<ShaderCache> shader_cache;
+
+  const auto display_begin = GetMonotonicTimeNanos();
+  for (auto &panel : panels) {
+    panel.display = CreateDisplay(panel.display_options);
+    if (!panel.display || !panel.display->IsValid()) {
+      FLWAY_ERROR << "Could not initialize the display for "
+                  << panel.asset_bundle_path << "." << std::endl;
+      return false;
+    }
+    FLWAY_LOG << "Display Size: " << panel.display->GetWidth() << " x "
+              << panel.display->GetHeight() << std::endl;
+  }
+
+  // Allocated before the first frame, which displays compositing in software
+  // need.
+  if (!background.empty() || show_cursor ||
+      !launch_options.test_pattern_plane.empty()) {
+    auto &panel = panels[0];
+    panel.planes = panel.display->GetPlaneAllocator();
+    if (panel.planes == nullptr) {
+      FLWAY_ERROR << "This display can't show planes." << std::endl;
+      return false;
+    }
+    if (!background.empty()) {
+      panel.background =
+          CreateBackground(*panel.planes, background,
+                           panel.display->GetWidth(),
+                           panel.display->GetHeight());
+      if (!panel.background) {
+        return false;
+      }
+    }
+    if (show_cursor) {
+      panel.cursor = std::make_unique<Cursor>(
+          *panel.planes, panel.geometry.x, panel.geometry.y);
+      if (!panel.cursor->IsValid()) {
+        return false;
+      }
+    }
+  }
+  timeline.AddPhase("display", display_begin, GetMonotonicTimeNanos());
+
+  const auto wait_begin = GetMonotonicTimeNanos();
+  const bool bundle_valid = WaitForPreloaders(preloaders);
+  timeline.AddPhase("wait for assets", wait_begin, GetMonotonicTimeNanos());
+
+  if (!bundle_valid) {
+    std::cerr << "   <Invalid Flutter Asset Bundle>   " << std::endl;
+    PrintUsage();
     return false;
   }
 
-  if (!application.SetWindowSize(display.GetWidth(), display.GetHeight())) {
-    FLWAY_ERROR << "Could not update Flutter application size." << std::endl;
+  if (!capture_path.empty()) {
+    frame_capture = std::make_unique<FrameCapture>(
+        capture_path, ::strtoul(capture_frames.c_str(), nullptr, 10));
+    if (!frame_capture->IsValid() ||
+        !panels[0].display->SetFrameCapture(frame_capture.get())) {
+      FLWAY_ERROR << "Could not capture frames from this display."
+                  << std::endl;
+      return false;
+    }
+  }
+
+  if (warm_up_shaders || shader_cache_path != "off") {
+    const auto cache_begin = GetMonotonicTimeNanos();
+    ShaderCache::Config config;
+    config.bundled_directory = asset_bundle_path + "/shader_cache";
+    if (warm_up_shaders) {
+      // SkSL rather than driver specific binaries, so that shaders warmed up
+      // on a build machine work on any GPU.
+      config.directory = config.bundled_directory + ".warm-up";
+      config.max_bytes = 0;
+      config.warm_up = true;
+      args.push_back("--cache-sksl");
+    } else {
+      config.directory = shader_cache_path;
+      if (!shader_cache_size.empty()) {
+        config.max_bytes = ::strtoul(shader_cache_size.c_str(), nullptr, 10)
+                           << 20;
+      }
+    }
+    shader_cache = std::make_unique<ShaderCache>(config);
+    timeline.AddPhase("shader cache", cache_begin, GetMonotonicTimeNanos());
+    if (!shader_cache->IsValid()) {
+      if (warm_up_shaders) {
+        return false;
+      }
+      // Shaders are compiled on every launch.
+      FLWAY_WARNING << "Not caching shaders." << std::endl;
+      shader_cache.reset();
+    }
+  }
+
+  if (!RunApplications(panels, args, loop, shader_cache.get(),
+                       launch_options, std::move(preloaders), timeline)) {
     return false;
   }
 
-  application.ReadInputEvents();
+  // Relaunches keep the displays, their contexts and surfaces, the loop and
+  // the shader cache, and the engine keeps the ICU data and Dart VM it set up
+  // the first time. The last frame stays on screen until the new engine
+  // presents.
+  while (restart_requested) {
+    restart_requested = false;
+    FLWAY_LOG << "Relaunching the engine." << std::endl;
+    StartupTimeline relaunch_timeline;
+    // The ICU data was read by the first launch and is not reloaded.
+    auto relaunch_preloaders = StartPreloaders(panels, "", relaunch_timeline);
+    if (WaitForPreloaders(relaunch_preloaders) &&
+        RunApplications(panels, args, loop, shader_cache.get(),
+                        launch_options, std::move(relaunch_preloaders),
+                        relaunch_timeline)) {
+      continue;
+    }
+
+    // The bundle may be halfway through an update. Try again unless asked to
+    // shut down meanwhile.
+    FLWAY_ERROR << "Could not relaunch the engine. Retrying in a second."
+                << std::endl;
+    restart_requested = true;
+    // A signal may end the wait early. The timer is disarmed then, or it would
+    // stop the loop of the engines launched next.
+    auto retry_token = std::make_shared<bool>(true);
+    std::weak_ptr<bool> weak_retry_token = retry_token;
+    loop.PostTask(
+        [&loop, weak_retry_token]() {
+          if (!weak_retry_token.expired()) {
+            loop.Terminate();
+          }
+        },
+        GetMonotonicTimeNanos() + kRelaunchRetryNanos);
+    loop.Run();
+    retry_token.reset();
+  }
+
+  loop.RemoveFD(signal_fd);
+  ::close(signal_fd);
 
   return true;
 }
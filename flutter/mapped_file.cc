@@ -0,0 +1,78 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flutter {
+
+MappedFile::MappedFile(const std::string &path, bool executable)
+    : path_(path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    FLWAY_ERROR << "Could not open " << path << std::endl;
+    return;
+  }
+
+  struct stat info = {};
+  if (::fstat(fd, &info) != 0) {
+    FLWAY_ERROR << "Could not stat " << path << std::endl;
+    ::close(fd);
+    return;
+  }
+
+  size_ = info.st_size;
+  if (size_ > 0) {
+    const int protection = executable ? PROT_READ | PROT_EXEC : PROT_READ;
+    void *mapping =
+        ::mmap(nullptr, size_, protection, MAP_PRIVATE, fd, 0 /* offset */);
+    if (mapping == MAP_FAILED) {
+      FLWAY_ERROR << "Could not map " << path << std::endl;
+      ::close(fd);
+      return;
+    }
+    mapping_ = reinterpret_cast<uint8_t *>(mapping);
+  }
+
+  // The mapping keeps the file alive.
+  ::close(fd);
+  valid_ = true;
+}
+
+MappedFile::~MappedFile() {
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, size_);
+  }
+}
+
+bool MappedFile::IsValid() const { return valid_; }
+
+const std::string &MappedFile::GetPath() const { return path_; }
+
+const uint8_t *MappedFile::GetMapping() const { return mapping_; }
+
+size_t MappedFile::GetSize() const { return size_; }
+
+void MappedFile::Prefetch() const {
+  if (mapping_ == nullptr) {
+    return;
+  }
+
+  // The advice only queues readahead. Faulting the pages in sequentially
+  // afterwards keeps the device busy with large requests and waits for them.
+  ::madvise(mapping_, size_, MADV_WILLNEED);
+
+  const size_t page_size = ::sysconf(_SC_PAGESIZE);
+  volatile uint8_t sink = 0;
+  for (size_t offset = 0; offset < size_; offset += page_size) {
+    sink ^= mapping_[offset];
+  }
+  (void)sink;
+}
+
+} // namespace flutter
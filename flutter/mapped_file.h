@@ -0,0 +1,46 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A read-only, private memory mapping of an entire file.
+class MappedFile {
+public:
+  // Executable mappings are used for AOT compiled instructions.
+  explicit MappedFile(const std::string &path, bool executable = false);
+
+  ~MappedFile();
+
+  bool IsValid() const;
+
+  const std::string &GetPath() const;
+
+  // Null for empty files.
+  const uint8_t *GetMapping() const;
+
+  size_t GetSize() const;
+
+  // Starts readahead of the whole file and then touches every page so that
+  // the file is resident in the page cache when this returns.
+  void Prefetch() const;
+
+private:
+  const std::string path_;
+  bool valid_ = false;
+  uint8_t *mapping_ = nullptr;
+  size_t size_ = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+} // namespace flutter
@@ -0,0 +1,191 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "memory_pressure_monitor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+static const char *kPressurePath = "/proc/pressure/memory";
+static const char *kMemInfoPath = "/proc/meminfo";
+
+MemoryPressureMonitor::MemoryPressureMonitor(EventLoop &loop,
+                                             const Config &config,
+                                             Callback callback)
+    : loop_(loop), config_(config), callback_(std::move(callback)) {
+  if (!callback_) {
+    FLWAY_ERROR << "A memory pressure callback is required." << std::endl;
+    return;
+  }
+
+  if (config_.stall_ms == 0 || config_.stall_ms >= config_.window_ms ||
+      config_.window_ms < 500 || config_.window_ms > 10000) {
+    FLWAY_ERROR << "Invalid memory pressure stall of " << config_.stall_ms
+                << " ms in " << config_.window_ms << " ms." << std::endl;
+    return;
+  }
+
+  if (config_.min_available_percent <= 0.0 ||
+      config_.min_available_percent >= 100.0 ||
+      config_.poll_interval_seconds <= 0.0 || config_.cooldown_seconds < 0.0) {
+    FLWAY_ERROR << "Invalid memory pressure threshold." << std::endl;
+    return;
+  }
+
+  valid_ = StartPressureTrigger() || StartPolling();
+}
+
+MemoryPressureMonitor::~MemoryPressureMonitor() {
+  StopPressureTrigger();
+  poll_token_.reset();
+  if (meminfo_fd_ != -1) {
+    ::close(meminfo_fd_);
+  }
+}
+
+bool MemoryPressureMonitor::IsValid() const { return valid_; }
+
+bool MemoryPressureMonitor::UsesPressureStallInformation() const {
+  return psi_fd_ != -1;
+}
+
+bool MemoryPressureMonitor::StartPressureTrigger() {
+  const int fd = ::open(kPressurePath, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1) {
+    FLWAY_LOG << "Memory pressure stall information is unavailable ("
+              << strerror(errno) << "). Polling " << kMemInfoPath << "."
+              << std::endl;
+    return false;
+  }
+
+  // The trigger lives as long as the file descriptor. The terminating null is
+  // part of the write.
+  char trigger[64];
+  const int length =
+      ::snprintf(trigger, sizeof(trigger), "some %u %u",
+                 config_.stall_ms * 1000u, config_.window_ms * 1000u);
+  if (::write(fd, trigger, length + 1) == -1) {
+    FLWAY_LOG << "Could not set a memory pressure trigger ("
+              << strerror(errno) << "). Polling " << kMemInfoPath << "."
+              << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  const bool added = loop_.AddFD(fd, EPOLLPRI, [this](uint32_t events) {
+    if (events & EPOLLERR) {
+      // The cgroup the trigger was set up in has gone away.
+      FLWAY_WARNING << "Lost the memory pressure trigger. Polling "
+                    << kMemInfoPath << "." << std::endl;
+      StopPressureTrigger();
+      StartPolling();
+      return;
+    }
+    if (events & EPOLLPRI) {
+      Notify("memory stalls");
+    }
+  });
+  if (!added) {
+    ::close(fd);
+    return false;
+  }
+
+  psi_fd_ = fd;
+  FLWAY_LOG << "Watching for " << config_.stall_ms
+            << " ms memory stalls within " << config_.window_ms << " ms."
+            << std::endl;
+  return true;
+}
+
+void MemoryPressureMonitor::StopPressureTrigger() {
+  if (psi_fd_ == -1) {
+    return;
+  }
+  loop_.RemoveFD(psi_fd_);
+  ::close(psi_fd_);
+  psi_fd_ = -1;
+}
+
+bool MemoryPressureMonitor::StartPolling() {
+  // The file is regenerated on each read from the start, so it is opened once.
+  meminfo_fd_ = ::open(kMemInfoPath, O_RDONLY | O_CLOEXEC);
+  if (meminfo_fd_ == -1) {
+    FLWAY_ERROR << "Could not open " << kMemInfoPath << ": "
+                << strerror(errno) << std::endl;
+    return false;
+  }
+
+  poll_token_ = std::make_shared<bool>(true);
+  SchedulePoll(GetMonotonicTimeNanos());
+  return true;
+}
+
+void MemoryPressureMonitor::SchedulePoll(uint64_t target_time) {
+  std::weak_ptr<bool> token = poll_token_;
+  loop_.PostTask(
+      [this, token, target_time]() {
+        if (token.expired()) {
+          return;
+        }
+        Poll();
+        SchedulePoll(target_time + config_.poll_interval_seconds * 1e9);
+      },
+      target_time);
+}
+
+// Returns the value in kB of a "<name>: <value> kB" line.
+static bool FindMemInfoField(const char *text, const char *name,
+                             uint64_t *kilobytes) {
+  const char *line = ::strstr(text, name);
+  if (line == nullptr) {
+    return false;
+  }
+  char *end = nullptr;
+  *kilobytes = ::strtoull(line + ::strlen(name), &end, 10);
+  return end != line + ::strlen(name);
+}
+
+void MemoryPressureMonitor::Poll() {
+  // Both fields are among the first few lines.
+  char text[1024];
+  const ssize_t size = ::pread(meminfo_fd_, text, sizeof(text) - 1, 0);
+  if (size <= 0) {
+    return;
+  }
+  text[size] = '\0';
+
+  uint64_t total = 0;
+  uint64_t available = 0;
+  if (!FindMemInfoField(text, "MemTotal:", &total) ||
+      !FindMemInfoField(text, "MemAvailable:", &available) || total == 0) {
+    return;
+  }
+
+  if (available * 100.0 < total * config_.min_available_percent) {
+    Notify("low available memory");
+  }
+}
+
+void MemoryPressureMonitor::Notify(const char *reason) {
+  const auto now = GetMonotonicTimeNanos();
+  if (last_notification_ != 0 &&
+      now - last_notification_ < config_.cooldown_seconds * 1e9) {
+    return;
+  }
+  last_notification_ = now;
+
+  FLWAY_WARNING << "Memory pressure: " << reason << "." << std::endl;
+  callback_();
+}
+
+} // namespace flutter
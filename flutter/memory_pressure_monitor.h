@@ -0,0 +1,76 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+
+#include "event_loop.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Watches for the system running short of memory so that Dart code can drop
+// its caches before the OOM killer picks this process. Uses a pressure stall
+// information (PSI) trigger on /proc/pressure/memory, which wakes the loop only
+// when tasks are actually stalled on memory. Kernels without PSI fall back to
+// polling MemAvailable in /proc/meminfo.
+class MemoryPressureMonitor {
+public:
+  struct Config {
+    // PSI: notify when tasks were stalled on memory for |stall_ms| within a
+    // |window_ms| window. Windows must be between 500 ms and 10 s, and a
+    // multiple of 2 s for processes without CAP_SYS_RESOURCE.
+    uint32_t stall_ms = 150;
+    uint32_t window_ms = 2000;
+    // Fallback: notify while MemAvailable is below this share of MemTotal.
+    double min_available_percent = 10.0;
+    double poll_interval_seconds = 1.0;
+    // Notifications closer together than this are dropped.
+    double cooldown_seconds = 10.0;
+  };
+
+  using Callback = std::function<void()>;
+
+  // |callback| is invoked on |loop|.
+  MemoryPressureMonitor(EventLoop &loop, const Config &config,
+                        Callback callback);
+
+  ~MemoryPressureMonitor();
+
+  bool IsValid() const;
+
+  // False if /proc/meminfo is being polled instead.
+  bool UsesPressureStallInformation() const;
+
+private:
+  EventLoop &loop_;
+  const Config config_;
+  Callback callback_;
+  int psi_fd_ = -1;
+  int meminfo_fd_ = -1;
+  // Polls that are still posted to the loop check this before running.
+  std::shared_ptr<bool> poll_token_;
+  uint64_t last_notification_ = 0;
+  bool valid_ = false;
+
+  bool StartPressureTrigger();
+
+  bool StartPolling();
+
+  void SchedulePoll(uint64_t target_time);
+
+  void Poll();
+
+  void StopPressureTrigger();
+
+  void Notify(const char *reason);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(MemoryPressureMonitor);
+};
+
+} // namespace flutter
@@ -7,26 +7,23 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 
-namespace flutter {
+#include <algorithm>
+#include <cmath>
 
-PiDisplay::PiDisplay() {
-  bcm_host_init();
+#include "utils.h"
 
-  // Setup the EGL Display.
-  {
-    auto display = ::eglGetDisplay(EGL_DEFAULT_DISPLAY);
-    if (display == EGL_NO_DISPLAY) {
-      FLWAY_ERROR << "Could not get the EGL display." << std::endl;
-      return;
-    }
+#ifndef EGL_BUFFER_AGE_EXT
+#define EGL_BUFFER_AGE_EXT 0x313D
+#endif
 
-    if (::eglInitialize(display, nullptr, nullptr) != EGL_TRUE) {
-      FLWAY_ERROR << "Could not initialize the EGL display." << std::endl;
-      return;
-    }
+namespace flutter {
 
-    display_ = display;
+PiDisplay::PiDisplay(const Config &display_config)
+    : config_(display_config), video_core_(VideoCore::Acquire()) {
+  if (!video_core_->IsValid()) {
+    return;
   }
+  display_ = video_core_->GetEGLDisplay();
 
   // Choose an EGL config.
   EGLConfig config = {0};
@@ -65,38 +62,52 @@ PiDisplay::PiDisplay() {
     context_ = context;
   }
 
-  // Query the size of the current display.
+  // Without a resource context the engine still works, just with texture
+  // uploads on the raster thread.
+  SetupResourceContext();
+
+  // Query the size of the display and fit the area rendered into to it.
   {
     uint32_t display_width = 0;
     uint32_t display_height = 0;
 
-    if (graphics_get_display_size(0 /* LCD */, &display_width,
+    if (graphics_get_display_size(config_.display, &display_width,
                                   &display_height) < 0) {
-      FLWAY_ERROR << "Could not query display size." << std::endl;
+      FLWAY_ERROR << "Could not query the size of display "
+                  << config_.display << "." << std::endl;
       return;
     }
 
-    if (display_height <= 0 || display_width <= 0) {
-      FLWAY_ERROR << "Invalid display size: " << display_width << " x "
-                  << display_height << std::endl;
+    const int32_t full_width = display_width;
+    const int32_t full_height = display_height;
+    const int32_t right =
+        config_.width > 0 ? config_.x + config_.width : full_width;
+    const int32_t bottom =
+        config_.height > 0 ? config_.y + config_.height : full_height;
+    if (config_.x < 0 || config_.y < 0 || right <= config_.x ||
+        bottom <= config_.y || right > full_width || bottom > full_height) {
+      FLWAY_ERROR << "Invalid area " << right - config_.x << " x "
+                  << bottom - config_.y << " at " << config_.x << ", "
+                  << config_.y << " on a " << display_width << " x "
+                  << display_height << " display." << std::endl;
       return;
     }
 
-    display_width_ = display_width;
-    display_height_ = display_height;
+    display_width_ = right - config_.x;
+    display_height_ = bottom - config_.y;
   }
 
   // VideoCore Fu.
   // TODO(chinmaygarde): There is insufficient error handler in this block on
   // all the call to vc_.
   {
-    dispman_display_ = ::vc_dispmanx_display_open(0 /* LCD */);
+    dispman_display_ = ::vc_dispmanx_display_open(config_.display);
 
     DISPMANX_UPDATE_HANDLE_T dispman_update = ::vc_dispmanx_update_start(0);
 
     const VC_RECT_T destination_rect = {
-        .x = 0,
-        .y = 0,
+        .x = config_.x,
+        .y = config_.y,
         .width = display_width_,
         .height = display_height_,
     };
@@ -111,7 +122,7 @@ PiDisplay::PiDisplay() {
     dispman_element_ =
         ::vc_dispmanx_element_add(dispman_update,           // update
                                   dispman_display_,         // display
-                                  0,                        // layer
+                                  config_.layer,            // layer
                                   &destination_rect,        // destination rect
                                   0,                        // source handle
                                   &source_rect,             // source rect
@@ -140,36 +151,119 @@ PiDisplay::PiDisplay() {
     surface_ = surface;
   }
 
+  // Partial present. The damage only helps if the driver can tell how old
+  // each buffer is, so that the engine repaints just what is out of date.
+  {
+    const auto extensions = ::eglQueryString(display_, EGL_EXTENSIONS);
+    supports_buffer_age_ = HasExtension(extensions, "EGL_EXT_buffer_age");
+    if (HasExtension(extensions, "EGL_KHR_swap_buffers_with_damage")) {
+      swap_buffers_with_damage_ = reinterpret_cast<SwapBuffersWithDamageProc>(
+          ::eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+    } else if (HasExtension(extensions, "EGL_EXT_swap_buffers_with_damage")) {
+      swap_buffers_with_damage_ = reinterpret_cast<SwapBuffersWithDamageProc>(
+          ::eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+    }
+  }
+
+  video_core_->AddVsyncObserver(this);
+  observing_vsync_ = true;
+
   valid_ = true;
 }
 
 PiDisplay::~PiDisplay() {
+  if (observing_vsync_) {
+    video_core_->RemoveVsyncObserver(this);
+  }
+
   if (surface_ != EGL_NO_SURFACE) {
     ::eglDestroySurface(display_, surface_);
     surface_ = EGL_NO_SURFACE;
   }
 
+  if (resource_surface_ != EGL_NO_SURFACE) {
+    ::eglDestroySurface(display_, resource_surface_);
+    resource_surface_ = EGL_NO_SURFACE;
+  }
+
+  if (resource_context_ != EGL_NO_CONTEXT) {
+    ::eglDestroyContext(display_, resource_context_);
+    resource_context_ = EGL_NO_CONTEXT;
+  }
+
+  // Its planes are gone already and their elements removed.
+  planes_.reset();
+
   // TODO(chinmaygarde): There is insufficient error handling here and the
   // element resource lifecycle is unclear.
-  ::vc_dispmanx_display_close(dispman_display_);
+  if (dispman_display_ != 0) {
+    ::vc_dispmanx_display_close(dispman_display_);
+  }
 
   if (context_ != EGL_NO_CONTEXT) {
     ::eglDestroyContext(display_, context_);
     context_ = EGL_NO_CONTEXT;
   }
 
-  if (display_ != EGL_NO_DISPLAY) {
-    ::eglTerminate(display_);
-    display_ = EGL_NO_DISPLAY;
+  // The EGL display and the host library go with the last display.
+  display_ = EGL_NO_DISPLAY;
+}
+
+void PiDisplay::SetupResourceContext() {
+  // The window config need not support pbuffers, so pick one that does.
+  // Contexts with different configs can still share resources.
+  EGLConfig config = {0};
+  EGLint num_config = 0;
+  const EGLint attribute_list[] = {EGL_RED_SIZE,     8,
+                                   EGL_GREEN_SIZE,   8,
+                                   EGL_BLUE_SIZE,    8,
+                                   EGL_ALPHA_SIZE,   8,
+                                   EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                   EGL_NONE};
+  if (::eglChooseConfig(display_, attribute_list, &config, 1, &num_config) !=
+          EGL_TRUE ||
+      num_config == 0) {
+    FLWAY_WARNING << "No pbuffer config for the resource context."
+                  << std::endl;
+    return;
+  }
+
+  const EGLint context_attributes[] = {
+      EGL_CONTEXT_CLIENT_VERSION, //
+      2,                          //
+      EGL_NONE                    //
+  };
+  auto context =
+      ::eglCreateContext(display_, config, context_, context_attributes);
+  if (context == EGL_NO_CONTEXT) {
+    FLWAY_WARNING << "Could not create the resource context." << std::endl;
+    return;
   }
 
-  ::bcm_host_deinit();
+  const EGLint surface_attributes[] = {
+      EGL_WIDTH,  1, //
+      EGL_HEIGHT, 1, //
+      EGL_NONE       //
+  };
+  auto surface =
+      ::eglCreatePbufferSurface(display_, config, surface_attributes);
+  if (surface == EGL_NO_SURFACE) {
+    FLWAY_WARNING << "Could not create the resource pbuffer." << std::endl;
+    ::eglDestroyContext(display_, context);
+    return;
+  }
+
+  resource_context_ = context;
+  resource_surface_ = surface;
 }
 
+// |Display|
 bool PiDisplay::IsValid() const { return valid_; }
 
+// |Display|
 size_t PiDisplay::GetWidth() const { return display_width_; }
 
+// |Display|
 size_t PiDisplay::GetHeight() const { return display_height_; }
 
 // |FlutterApplication::RenderDelegate|
@@ -200,6 +294,42 @@ bool PiDisplay::OnApplicationContextClearCurrent() {
   return true;
 }
 
+// |FlutterApplication::RenderDelegate|
+bool PiDisplay::OnApplicationMakeResourceCurrent() {
+  if (!valid_ || resource_context_ == EGL_NO_CONTEXT) {
+    return false;
+  }
+  if (::eglMakeCurrent(display_, resource_surface_, resource_surface_,
+                       resource_context_) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not make the resource context current."
+                << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// |Display|
+bool PiDisplay::SetFrameCapture(FrameCapture *capture) {
+  frame_reader_.reset();
+  if (capture != nullptr) {
+    frame_reader_ = std::make_unique<GLFrameReader>(*capture, display_width_,
+                                                    display_height_);
+  }
+  return true;
+}
+
+// |Display|
+PlaneAllocator *PiDisplay::GetPlaneAllocator() {
+  if (!valid_) {
+    return nullptr;
+  }
+  if (!planes_) {
+    planes_ = std::make_unique<DispmanxPlaneAllocator>(
+        dispman_display_, config_.layer, config_.x, config_.y);
+  }
+  return planes_.get();
+}
+
 // |FlutterApplication::RenderDelegate|
 bool PiDisplay::OnApplicationPresent() {
   if (!valid_) {
@@ -207,6 +337,11 @@ bool PiDisplay::OnApplicationPresent() {
     return false;
   }
 
+  // The back buffer is undefined once swapped.
+  if (frame_reader_) {
+    frame_reader_->ReadFrame(0);
+  }
+
   if (::eglSwapBuffers(display_, surface_) != EGL_TRUE) {
     FLWAY_ERROR << "Could not swap buffers to present the screen." << std::endl;
     return false;
@@ -215,6 +350,78 @@ bool PiDisplay::OnApplicationPresent() {
   return true;
 }
 
+// |FlutterApplication::RenderDelegate|
+bool PiDisplay::SupportsPartialPresent() const {
+  return supports_buffer_age_ && swap_buffers_with_damage_ != nullptr;
+}
+
+// |FlutterApplication::RenderDelegate|
+void PiDisplay::OnApplicationGetBufferDamage(FlutterDamage &damage) {
+  EGLint age = 0;
+  if (::eglQuerySurface(display_, surface_, EGL_BUFFER_AGE_EXT, &age) !=
+      EGL_TRUE) {
+    age = 0;
+  }
+
+  const auto rect = damage_history_.GetBufferDamage(age, display_width_,
+                                                    display_height_);
+  buffer_damage_.left = rect.x;
+  buffer_damage_.top = rect.y;
+  buffer_damage_.right = rect.x + rect.width;
+  buffer_damage_.bottom = rect.y + rect.height;
+  damage.num_rects = 1;
+  damage.damage = &buffer_damage_;
+}
+
+// |FlutterApplication::RenderDelegate|
+bool PiDisplay::OnApplicationPresentWithDamage(const FlutterDamage &damage) {
+  if (!valid_) {
+    FLWAY_ERROR << "Cannot present an invalid display." << std::endl;
+    return false;
+  }
+
+  // The history only keeps bounding boxes.
+  DamageRect bounds;
+  for (size_t i = 0; i < damage.num_rects; ++i) {
+    const auto &rect = damage.damage[i];
+    const double left = std::max(rect.left, 0.0);
+    const double top = std::max(rect.top, 0.0);
+    const double right = std::min<double>(rect.right, display_width_);
+    const double bottom = std::min<double>(rect.bottom, display_height_);
+    if (right <= left || bottom <= top) {
+      continue;
+    }
+    DamageRect damage_rect;
+    damage_rect.x = left;
+    damage_rect.y = top;
+    damage_rect.width = std::ceil(right) - damage_rect.x;
+    damage_rect.height = std::ceil(bottom) - damage_rect.y;
+    bounds = bounds.Union(damage_rect);
+  }
+  damage_history_.Push(bounds);
+
+  // Buffer age repairs make the whole back buffer current, not just the
+  // damage.
+  if (frame_reader_) {
+    frame_reader_->ReadFrame(0);
+  }
+
+  // An empty frame still needs a swap to return the buffer. EGL rects have a
+  // bottom left origin.
+  const EGLint rect[] = {
+      static_cast<EGLint>(bounds.x),
+      static_cast<EGLint>(display_height_ - bounds.y - bounds.height),
+      static_cast<EGLint>(bounds.width),
+      static_cast<EGLint>(bounds.height),
+  };
+  if (swap_buffers_with_damage_(display_, surface_, rect, 1) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not swap buffers to present the screen." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
 // |FlutterApplication::RenderDelegate|
 uint32_t PiDisplay::OnApplicationGetOnscreenFBO() {
   // Just FBO0.
@@ -231,7 +438,91 @@ void *PiDisplay::GetProcAddress(const char *name) {
     return address;
   }
 
-  return nullptr;
+  // Extension entry points aren't necessarily exported.
+  return reinterpret_cast<void *>(::eglGetProcAddress(name));
+}
+
+// |FlutterApplication::RenderDelegate|
+VsyncWaiter *PiDisplay::GetVsyncWaiter() { return valid_ ? this : nullptr; }
+
+// |FlutterApplication::RenderDelegate|
+void PiDisplay::OnApplicationShutdown() {
+  // The engine's IO thread exited with the resource context current, so the
+  // next engine couldn't make it current. The old one is freed by the driver
+  // once nothing refers to it.
+  if (resource_surface_ != EGL_NO_SURFACE) {
+    ::eglDestroySurface(display_, resource_surface_);
+    resource_surface_ = EGL_NO_SURFACE;
+  }
+  if (resource_context_ != EGL_NO_CONTEXT) {
+    ::eglDestroyContext(display_, resource_context_);
+    resource_context_ = EGL_NO_CONTEXT;
+    SetupResourceContext();
+  }
+
+  // See |HeadlessDisplay::OnApplicationShutdown|.
+  if (frame_reader_ && OnApplicationMakeResourceCurrent()) {
+    frame_reader_->Finish();
+    ::eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+}
+
+// |VsyncWaiter|
+void PiDisplay::AwaitVsync(VsyncWaiter::Callback callback) {
+  {
+    std::lock_guard<std::mutex> lock(vsync_mutex_);
+    pending_vsync_callback_ = std::move(callback);
+  }
+  // Not under the lock, which pulses take on the Video Core thread.
+  video_core_->RequestVsync(dispman_display_);
+}
+
+// |VsyncWaiter|
+void PiDisplay::CancelVsync() {
+  std::unique_lock<std::mutex> lock(vsync_mutex_);
+  pending_vsync_callback_ = nullptr;
+  vsync_callback_done_.wait(lock,
+                            [this]() { return !invoking_vsync_callback_; });
+}
+
+// |VideoCore::VsyncObserver|
+bool PiDisplay::OnVideoCoreVsync(uint64_t now) {
+  VsyncWaiter::Callback callback;
+  uint64_t period = 0;
+  bool wanted = true;
+  {
+    std::lock_guard<std::mutex> lock(vsync_mutex_);
+    // Track the real refresh period. Pulses more than two periods apart mean
+    // some were missed and say nothing about the period.
+    if (last_vsync_nanos_ != 0) {
+      const auto delta = now - last_vsync_nanos_;
+      if (delta < vsync_period_nanos_ * 2) {
+        vsync_period_nanos_ = (vsync_period_nanos_ * 7 + delta) / 8;
+      }
+    }
+    last_vsync_nanos_ = now;
+    period = vsync_period_nanos_;
+    std::swap(callback, pending_vsync_callback_);
+    invoking_vsync_callback_ = static_cast<bool>(callback);
+
+    // Nothing is animating. Let Video Core stop waking up 60 times a second
+    // until the next frame is scheduled. A single miss is tolerated since the
+    // engine asks for the next pulse late when a frame runs long.
+    if (callback) {
+      unanswered_vsync_count_ = 0;
+    } else if (++unanswered_vsync_count_ >= 2) {
+      unanswered_vsync_count_ = 0;
+      wanted = false;
+    }
+  }
+
+  if (callback) {
+    callback(now, now + period);
+    std::lock_guard<std::mutex> lock(vsync_mutex_);
+    invoking_vsync_callback_ = false;
+    vsync_callback_done_.notify_all();
+  }
+  return wanted;
 }
 
 } // namespace flutter
@@ -8,51 +8,141 @@
 #include <EGL/eglext.h>
 #include <bcm_host.h>
 
-#include "flutter_application.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "damage_tracker.h"
+#include "display.h"
+#include "dispmanx_plane_allocator.h"
+#include "gl_frame_reader.h"
 #include "macros.h"
+#include "video_core.h"
+#include "vsync_waiter.h"
 
 namespace flutter {
 
-class PiDisplay : public FlutterApplication::RenderDelegate {
+class PiDisplay : public Display,
+                  public VsyncWaiter,
+                  public VideoCore::VsyncObserver {
 public:
-  PiDisplay();
+  struct Config {
+    // The Video Core display number. 0 is the main LCD, 2 and 7 are the
+    // first and second HDMI ports of a Pi 4.
+    uint32_t display = 0;
+    // Displays on higher layers are shown over those on lower ones.
+    int32_t layer = 0;
+    // The area of the display rendered into. Zero width or height extends it
+    // to the edge of the display.
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+  };
 
-  ~PiDisplay();
+  // Any number of displays may exist at once, each with its own surface and
+  // contexts.
+  explicit PiDisplay(const Config &config);
 
-  bool IsValid() const;
+  ~PiDisplay() override;
 
-  size_t GetWidth() const;
+  // |Display|
+  bool IsValid() const override;
 
-  size_t GetHeight() const;
+  // |Display|
+  size_t GetWidth() const override;
+
+  // |Display|
+  size_t GetHeight() const override;
+
+  // |Display|
+  bool SetFrameCapture(FrameCapture *capture) override;
+
+  // |Display|
+  PlaneAllocator *GetPlaneAllocator() override;
 
 private:
+  const Config config_;
+  std::shared_ptr<VideoCore> video_core_;
   int32_t display_width_ = 0;
   int32_t display_height_ = 0;
   EGLDisplay display_ = EGL_NO_DISPLAY;
   EGLContext context_ = EGL_NO_CONTEXT;
   EGLSurface surface_ = EGL_NO_SURFACE;
+  // Shares resources with |context_| so that the engine's IO thread can upload
+  // textures. The pbuffer only exists to have something to make current.
+  EGLContext resource_context_ = EGL_NO_CONTEXT;
+  EGLSurface resource_surface_ = EGL_NO_SURFACE;
   DISPMANX_DISPLAY_HANDLE_T dispman_display_ = {0};
   DISPMANX_ELEMENT_HANDLE_T dispman_element_ = {0};
 
   EGL_DISPMANX_WINDOW_T native_window_ = {};
 
+  // Set if EGL_KHR_swap_buffers_with_damage or its EXT variant is available.
+  using SwapBuffersWithDamageProc = EGLBoolean (*)(EGLDisplay, EGLSurface,
+                                                   const EGLint *, EGLint);
+  SwapBuffersWithDamageProc swap_buffers_with_damage_ = nullptr;
+  bool supports_buffer_age_ = false;
+  DamageHistory damage_history_;
+  FlutterRect buffer_damage_ = {};
+  std::unique_ptr<GLFrameReader> frame_reader_;
+  std::unique_ptr<DispmanxPlaneAllocator> planes_;
+
   bool valid_ = false;
 
+  bool observing_vsync_ = false;
+  std::mutex vsync_mutex_;
+  size_t unanswered_vsync_count_ = 0;
+  VsyncWaiter::Callback pending_vsync_callback_;
+  bool invoking_vsync_callback_ = false;
+  std::condition_variable vsync_callback_done_;
+  uint64_t last_vsync_nanos_ = 0;
+  uint64_t vsync_period_nanos_ = 1000000000ull / 60;
+
+  void SetupResourceContext();
+
   // |FlutterApplication::RenderDelegate|
   bool OnApplicationContextMakeCurrent() override;
 
   // |FlutterApplication::RenderDelegate|
   bool OnApplicationContextClearCurrent() override;
 
+  // |FlutterApplication::RenderDelegate|
+  bool OnApplicationMakeResourceCurrent() override;
+
   // |FlutterApplication::RenderDelegate|
   bool OnApplicationPresent() override;
 
+  // |FlutterApplication::RenderDelegate|
+  bool SupportsPartialPresent() const override;
+
+  // |FlutterApplication::RenderDelegate|
+  bool OnApplicationPresentWithDamage(const FlutterDamage &damage) override;
+
+  // |FlutterApplication::RenderDelegate|
+  void OnApplicationGetBufferDamage(FlutterDamage &damage) override;
+
   // |FlutterApplication::RenderDelegate|
   uint32_t OnApplicationGetOnscreenFBO() override;
 
   // |FlutterApplication::RenderDelegate|
   void *GetProcAddress(const char *) override;
 
+  // |FlutterApplication::RenderDelegate|
+  VsyncWaiter *GetVsyncWaiter() override;
+
+  // |FlutterApplication::RenderDelegate|
+  void OnApplicationShutdown() override;
+
+  // |VsyncWaiter|
+  void AwaitVsync(VsyncWaiter::Callback callback) override;
+
+  // |VsyncWaiter|
+  void CancelVsync() override;
+
+  // |VideoCore::VsyncObserver|
+  bool OnVideoCoreVsync(uint64_t now) override;
+
   FLWAY_DISALLOW_COPY_AND_ASSIGN(PiDisplay);
 };
 
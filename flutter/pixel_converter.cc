@@ -0,0 +1,180 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "pixel_converter.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FLWAY_PIXELS_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FLWAY_PIXELS_SSE2 1
+#endif
+
+namespace flutter {
+
+size_t BytesPerPixel(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::kRGBA8888:
+  case PixelFormat::kBGRA8888:
+    return 4;
+  case PixelFormat::kRGB565:
+    return 2;
+  }
+  return 0;
+}
+
+const char *PixelFormatToString(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::kRGBA8888:
+    return "RGBA8888";
+  case PixelFormat::kBGRA8888:
+    return "BGRA8888";
+  case PixelFormat::kRGB565:
+    return "RGB565";
+  }
+  return "Unknown";
+}
+
+static inline uint32_t SwizzlePixel(uint32_t pixel) {
+  return (pixel & 0xFF00FF00u) | ((pixel >> 16) & 0xFFu) |
+         ((pixel & 0xFFu) << 16);
+}
+
+static inline uint16_t PackPixel565(const uint8_t *pixel, bool bgra) {
+  const uint8_t r = bgra ? pixel[2] : pixel[0];
+  const uint8_t g = pixel[1];
+  const uint8_t b = bgra ? pixel[0] : pixel[2];
+  return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+// Swaps the red and blue channels of |count| 32 bits per pixel pixels.
+static void SwizzleRow(const uint8_t *source, uint8_t *destination,
+                       size_t count) {
+  size_t i = 0;
+#if FLWAY_PIXELS_NEON
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x4_t pixels = vld4q_u8(source + i * 4);
+    const uint8x16_t red = pixels.val[0];
+    pixels.val[0] = pixels.val[2];
+    pixels.val[2] = red;
+    vst4q_u8(destination + i * 4, pixels);
+  }
+#elif FLWAY_PIXELS_SSE2
+  const __m128i keep_mask = _mm_set1_epi32(0xFF00FF00);
+  const __m128i low_mask = _mm_set1_epi32(0x000000FF);
+  for (; i + 4 <= count; i += 4) {
+    const __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 4));
+    const __m128i kept = _mm_and_si128(pixels, keep_mask);
+    const __m128i high = _mm_and_si128(_mm_srli_epi32(pixels, 16), low_mask);
+    const __m128i low = _mm_slli_epi32(_mm_and_si128(pixels, low_mask), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 4),
+                     _mm_or_si128(kept, _mm_or_si128(high, low)));
+  }
+#endif
+  for (; i < count; ++i) {
+    uint32_t pixel = 0;
+    memcpy(&pixel, source + i * 4, sizeof(pixel));
+    pixel = SwizzlePixel(pixel);
+    memcpy(destination + i * 4, &pixel, sizeof(pixel));
+  }
+}
+
+// Packs |count| 32 bits per pixel pixels into RGB565.
+static void PackRow565(const uint8_t *source, uint8_t *destination,
+                       size_t count, bool bgra) {
+  size_t i = 0;
+#if FLWAY_PIXELS_NEON
+  for (; i + 16 <= count; i += 16) {
+    const uint8x16x4_t pixels = vld4q_u8(source + i * 4);
+    const uint8x16_t r = bgra ? pixels.val[2] : pixels.val[0];
+    const uint8x16_t g = pixels.val[1];
+    const uint8x16_t b = bgra ? pixels.val[0] : pixels.val[2];
+
+    uint16x8_t low = vshll_n_u8(vget_low_u8(r), 8);
+    low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(g), 8), 5);
+    low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(b), 8), 11);
+
+    uint16x8_t high = vshll_n_u8(vget_high_u8(r), 8);
+    high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(g), 8), 5);
+    high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(b), 8), 11);
+
+    uint16_t *out = reinterpret_cast<uint16_t *>(destination + i * 2);
+    vst1q_u16(out, low);
+    vst1q_u16(out + 8, high);
+  }
+#elif FLWAY_PIXELS_SSE2
+  const __m128i red_mask = _mm_set1_epi32(0xF800);
+  const __m128i green_mask = _mm_set1_epi32(0x07E0);
+  const __m128i blue_mask = _mm_set1_epi32(0x001F);
+  auto pack4 = [&](const uint8_t *pixels_ptr) -> __m128i {
+    const __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels_ptr));
+    // Red lives in byte 0 (RGBA) or byte 2 (BGRA). Blue is the other one.
+    const __m128i red = bgra ? _mm_srli_epi32(pixels, 8)
+                             : _mm_slli_epi32(pixels, 8);
+    const __m128i green = _mm_srli_epi32(pixels, 5);
+    const __m128i blue = bgra ? _mm_srli_epi32(pixels, 3)
+                              : _mm_srli_epi32(pixels, 19);
+    __m128i packed = _mm_and_si128(red, red_mask);
+    packed = _mm_or_si128(packed, _mm_and_si128(green, green_mask));
+    packed = _mm_or_si128(packed, _mm_and_si128(blue, blue_mask));
+    // Sign extend the low half of each lane so that the saturating pack below
+    // preserves the bit pattern.
+    return _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+  };
+  for (; i + 8 <= count; i += 8) {
+    const __m128i low = pack4(source + i * 4);
+    const __m128i high = pack4(source + i * 4 + 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 2),
+                     _mm_packs_epi32(low, high));
+  }
+#endif
+  for (; i < count; ++i) {
+    const uint16_t pixel = PackPixel565(source + i * 4, bgra);
+    memcpy(destination + i * 2, &pixel, sizeof(pixel));
+  }
+}
+
+bool ConvertPixels(const void *source, size_t source_row_bytes,
+                   PixelFormat source_format, void *destination,
+                   size_t destination_row_bytes, PixelFormat destination_format,
+                   size_t width, size_t height) {
+  if (BytesPerPixel(source_format) != 4) {
+    return false;
+  }
+
+  auto src = reinterpret_cast<const uint8_t *>(source);
+  auto dst = reinterpret_cast<uint8_t *>(destination);
+
+  if (source_format == destination_format) {
+    const size_t row_bytes = width * 4;
+    if (row_bytes == source_row_bytes && row_bytes == destination_row_bytes) {
+      memcpy(dst, src, row_bytes * height);
+      return true;
+    }
+    for (size_t y = 0; y < height; ++y) {
+      memcpy(dst + y * destination_row_bytes, src + y * source_row_bytes,
+             row_bytes);
+    }
+    return true;
+  }
+
+  const bool bgra = source_format == PixelFormat::kBGRA8888;
+  for (size_t y = 0; y < height; ++y) {
+    const uint8_t *src_row = src + y * source_row_bytes;
+    uint8_t *dst_row = dst + y * destination_row_bytes;
+    if (destination_format == PixelFormat::kRGB565) {
+      PackRow565(src_row, dst_row, width, bgra);
+    } else {
+      SwizzleRow(src_row, dst_row, width);
+    }
+  }
+  return true;
+}
+
+} // namespace flutter
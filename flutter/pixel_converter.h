@@ -0,0 +1,36 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace flutter {
+
+enum class PixelFormat {
+  // 32 bits per pixel. Bytes in memory are R, G, B, A.
+  kRGBA8888,
+  // 32 bits per pixel. Bytes in memory are B, G, R, A.
+  kBGRA8888,
+  // 16 bits per pixel. Little endian with red in the most significant bits.
+  kRGB565,
+};
+
+size_t BytesPerPixel(PixelFormat format);
+
+const char *PixelFormatToString(PixelFormat format);
+
+// Copies a |width| x |height| region of 32 bits per pixel |source| pixels into
+// |destination|, converting to the destination pixel format along the way.
+// Both buffers may have padding at the end of each row. Uses NEON or SSE2 when
+// the target supports it.
+//
+// Returns false if the source format is not a 32 bits per pixel format.
+bool ConvertPixels(const void *source, size_t source_row_bytes,
+                   PixelFormat source_format, void *destination,
+                   size_t destination_row_bytes, PixelFormat destination_format,
+                   size_t width, size_t height);
+
+} // namespace flutter
@@ -0,0 +1,268 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "planes.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "utils.h"
+
+namespace flutter {
+
+static const size_t kBytesPerPixel = 4;
+
+// Returns the part of a plane at |x|, |y| that is on a display of the given
+// size, or false if none of it is.
+static bool ClipToDisplay(int64_t x, int64_t y, size_t width, size_t height,
+                          size_t display_width, size_t display_height,
+                          DamageRect *rect) {
+  const int64_t left = std::max<int64_t>(x, 0);
+  const int64_t top = std::max<int64_t>(y, 0);
+  const int64_t right = std::min<int64_t>(x + width, display_width);
+  const int64_t bottom = std::min<int64_t>(y + height, display_height);
+  if (right <= left || bottom <= top) {
+    return false;
+  }
+  rect->x = left;
+  rect->y = top;
+  rect->width = right - left;
+  rect->height = bottom - top;
+  return true;
+}
+
+// Premultiplied source over. Cursors are mostly fully transparent or fully
+// opaque, so those pixels take the short way.
+static void BlendRow(uint8_t *destination, const uint8_t *source,
+                     size_t count) {
+  for (size_t i = 0; i < count; ++i, destination += 4, source += 4) {
+    const uint32_t alpha = source[3];
+    if (alpha == 0) {
+      continue;
+    }
+    if (alpha == 255) {
+      ::memcpy(destination, source, 4);
+      continue;
+    }
+    const uint32_t inverse = 255 - alpha;
+    for (size_t channel = 0; channel < 4; ++channel) {
+      // Exact division by 255, rounded.
+      const uint32_t scaled = destination[channel] * inverse + 128;
+      destination[channel] = source[channel] + ((scaled + (scaled >> 8)) >> 8);
+    }
+  }
+}
+
+class SoftwarePlaneAllocator::SoftwarePlane : public Plane {
+public:
+  SoftwarePlane(SoftwarePlaneAllocator &allocator, PlaneKind kind,
+                size_t width, size_t height)
+      : allocator_(allocator), kind_(kind), width_(width), height_(height),
+        pending_pixels_(width * height * kBytesPerPixel),
+        pixels_(width * height * kBytesPerPixel) {}
+
+  ~SoftwarePlane() override { allocator_.RemovePlane(this); }
+
+  // |Plane|
+  bool SetContents(const void *pixels, size_t row_bytes) override {
+    const size_t plane_row_bytes = width_ * kBytesPerPixel;
+    if (row_bytes < plane_row_bytes) {
+      FLWAY_ERROR << "Plane contents are narrower than the plane."
+                  << std::endl;
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(allocator_.mutex_);
+    for (size_t y = 0; y < height_; ++y) {
+      ::memcpy(pending_pixels_.data() + y * plane_row_bytes,
+               static_cast<const uint8_t *>(pixels) + y * row_bytes,
+               plane_row_bytes);
+    }
+    contents_changed_ = true;
+    return true;
+  }
+
+  // |Plane|
+  void SetPosition(int32_t x, int32_t y) override {
+    std::lock_guard<std::mutex> lock(allocator_.mutex_);
+    pending_x_ = x;
+    pending_y_ = y;
+  }
+
+  // |Plane|
+  void SetVisible(bool visible) override {
+    std::lock_guard<std::mutex> lock(allocator_.mutex_);
+    pending_visible_ = visible;
+  }
+
+private:
+  friend class SoftwarePlaneAllocator;
+
+  SoftwarePlaneAllocator &allocator_;
+  const PlaneKind kind_;
+  const size_t width_;
+  const size_t height_;
+  // Guarded by the allocator's lock. The pending state becomes the shown
+  // state on commit.
+  std::vector<uint8_t> pending_pixels_;
+  bool contents_changed_ = false;
+  int32_t pending_x_ = 0;
+  int32_t pending_y_ = 0;
+  bool pending_visible_ = false;
+  std::vector<uint8_t> pixels_;
+  int32_t x_ = 0;
+  int32_t y_ = 0;
+  bool visible_ = false;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(SoftwarePlane);
+};
+
+SoftwarePlaneAllocator::SoftwarePlaneAllocator(size_t width, size_t height,
+                                               PresentCallback present)
+    : width_(width), height_(height), row_bytes_(width * kBytesPerPixel),
+      present_(std::move(present)), application_(row_bytes_ * height_),
+      composited_(row_bytes_ * height_) {}
+
+SoftwarePlaneAllocator::~SoftwarePlaneAllocator() {
+  if (!planes_.empty()) {
+    FLWAY_ERROR << "Planes outlived their allocator." << std::endl;
+  }
+}
+
+std::unique_ptr<Plane> SoftwarePlaneAllocator::AllocatePlane(PlaneKind kind,
+                                                             size_t width,
+                                                             size_t height) {
+  if (width == 0 || height == 0) {
+    return nullptr;
+  }
+  auto plane = std::make_unique<SoftwarePlane>(*this, kind, width, height);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Planes of a kind stack in the order they were allocated.
+  auto position = std::upper_bound(
+      planes_.begin(), planes_.end(), kind,
+      [](PlaneKind kind, const SoftwarePlane *other) {
+        return kind < other->kind_;
+      });
+  planes_.insert(position, plane.get());
+  return plane;
+}
+
+void SoftwarePlaneAllocator::RemovePlane(SoftwarePlane *plane) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  planes_.erase(std::remove(planes_.begin(), planes_.end(), plane),
+                planes_.end());
+  DamageRect area;
+  if (plane->visible_ &&
+      ClipToDisplay(plane->x_, plane->y_, plane->width_, plane->height_,
+                    width_, height_, &area)) {
+    ComposeLocked(area);
+  }
+}
+
+// |PlaneAllocator|
+void SoftwarePlaneAllocator::Commit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto plane : planes_) {
+    const bool moved = plane->pending_x_ != plane->x_ ||
+                       plane->pending_y_ != plane->y_ ||
+                       plane->pending_visible_ != plane->visible_;
+    if (!moved && !plane->contents_changed_) {
+      continue;
+    }
+
+    // A moving cursor damages where it was and where it is, which are
+    // composited separately rather than as one box around both.
+    DamageRect before;
+    const bool was_shown =
+        plane->visible_ &&
+        ClipToDisplay(plane->x_, plane->y_, plane->width_, plane->height_,
+                      width_, height_, &before);
+
+    if (plane->contents_changed_) {
+      plane->pixels_.swap(plane->pending_pixels_);
+      plane->contents_changed_ = false;
+    }
+    plane->x_ = plane->pending_x_;
+    plane->y_ = plane->pending_y_;
+    plane->visible_ = plane->pending_visible_;
+
+    if (was_shown) {
+      ComposeLocked(before);
+    }
+    DamageRect after;
+    if ((!was_shown || moved) && plane->visible_ &&
+        ClipToDisplay(plane->x_, plane->y_, plane->width_, plane->height_,
+                      width_, height_, &after)) {
+      ComposeLocked(after);
+    }
+  }
+}
+
+void SoftwarePlaneAllocator::PresentApplicationFrame(
+    const void *pixels, size_t row_bytes,
+    const std::vector<DamageRect> &damage) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &rect : damage) {
+    DamageRect area;
+    if (!ClipToDisplay(rect.x, rect.y, rect.width, rect.height, width_,
+                       height_, &area)) {
+      continue;
+    }
+    for (size_t y = area.y; y < area.y + area.height; ++y) {
+      ::memcpy(application_.data() + y * row_bytes_ + area.x * kBytesPerPixel,
+               static_cast<const uint8_t *>(pixels) + y * row_bytes +
+                   area.x * kBytesPerPixel,
+               area.width * kBytesPerPixel);
+    }
+    ComposeLocked(area);
+  }
+}
+
+void SoftwarePlaneAllocator::ComposeLocked(const DamageRect &area) {
+  const size_t span = area.width * kBytesPerPixel;
+  for (size_t y = area.y; y < area.y + area.height; ++y) {
+    ::memset(composited_.data() + y * row_bytes_ + area.x * kBytesPerPixel, 0,
+             span);
+  }
+
+  const auto blend = [this, &area](const uint8_t *pixels, size_t row_bytes,
+                                   int64_t x, int64_t y, size_t width,
+                                   size_t height) {
+    DamageRect layer;
+    if (!ClipToDisplay(x, y, width, height, width_, height_, &layer)) {
+      return;
+    }
+    const size_t left = std::max(layer.x, area.x);
+    const size_t top = std::max(layer.y, area.y);
+    const size_t right =
+        std::min(layer.x + layer.width, area.x + area.width);
+    const size_t bottom =
+        std::min(layer.y + layer.height, area.y + area.height);
+    for (size_t row = top; row < bottom; ++row) {
+      BlendRow(composited_.data() + row * row_bytes_ + left * kBytesPerPixel,
+               pixels + (row - y) * row_bytes + (left - x) * kBytesPerPixel,
+               right > left ? right - left : 0);
+    }
+  };
+
+  bool application_blended = false;
+  for (auto plane : planes_) {
+    if (!application_blended && plane->kind_ == PlaneKind::kCursor) {
+      blend(application_.data(), row_bytes_, 0, 0, width_, height_);
+      application_blended = true;
+    }
+    if (plane->visible_) {
+      blend(plane->pixels_.data(), plane->width_ * kBytesPerPixel, plane->x_,
+            plane->y_, plane->width_, plane->height_);
+    }
+  }
+  if (!application_blended) {
+    blend(application_.data(), row_bytes_, 0, 0, width_, height_);
+  }
+
+  present_(composited_.data() + area.y * row_bytes_ + area.x * kBytesPerPixel,
+           row_bytes_, area);
+}
+
+} // namespace flutter
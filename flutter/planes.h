@@ -0,0 +1,115 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "damage_tracker.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Planes are stacked around the application in this order, from the bottom.
+// The application must leave transparent what should show through from the
+// planes below it.
+enum class PlaneKind {
+  kBackground,
+  kVideo,
+  kCursor,
+};
+
+// An image the display shows next to the application's frames without the
+// application drawing it. Changes take effect on the next commit of the
+// allocator the plane came from. Planes may be changed from any thread.
+class Plane {
+public:
+  virtual ~Plane() = default;
+
+  // Replaces the whole image with premultiplied pixels that are B, G, R, A
+  // bytes in memory, the layout of the software renderer. |pixels| must be as
+  // large as the plane.
+  virtual bool SetContents(const void *pixels, size_t row_bytes) = 0;
+
+  // Moves the top left corner, relative to the application's. Planes may hang
+  // off the edges.
+  virtual void SetPosition(int32_t x, int32_t y) = 0;
+
+  // Planes start out hidden.
+  virtual void SetVisible(bool visible) = 0;
+};
+
+// Hands out planes of a display and shows changes to them. Moving or hiding a
+// plane costs no frame of the application.
+class PlaneAllocator {
+public:
+  virtual ~PlaneAllocator() = default;
+
+  // Returns null if no plane of |kind| this size is left. Planes must go
+  // before the allocator does.
+  virtual std::unique_ptr<Plane> AllocatePlane(PlaneKind kind, size_t width,
+                                               size_t height) = 0;
+
+  // Shows every change made to the planes since the last commit at once.
+  // Doesn't wait for the display.
+  virtual void Commit() = 0;
+};
+
+// Composites planes with the application's frames on the CPU, for displays
+// that scan out of memory and as a reference for the hardware allocators. A
+// copy of the application's last frame is kept so that committed changes
+// recompose only the area of the planes that changed.
+class SoftwarePlaneAllocator : public PlaneAllocator {
+public:
+  // Called with the composited pixels of an area that changed, laid out like
+  // planes' contents and starting at the area's top left pixel. Always
+  // called under the allocator's lock.
+  using PresentCallback = std::function<void(
+      const uint8_t *pixels, size_t row_bytes, const DamageRect &area)>;
+
+  SoftwarePlaneAllocator(size_t width, size_t height, PresentCallback present);
+
+  ~SoftwarePlaneAllocator() override;
+
+  // Takes the damaged areas of a new application frame, laid out like planes'
+  // contents, and presents them composited with the planes.
+  void PresentApplicationFrame(const void *pixels, size_t row_bytes,
+                               const std::vector<DamageRect> &damage);
+
+  // |PlaneAllocator|
+  std::unique_ptr<Plane> AllocatePlane(PlaneKind kind, size_t width,
+                                       size_t height) override;
+
+  // |PlaneAllocator|
+  void Commit() override;
+
+private:
+  class SoftwarePlane;
+
+  const size_t width_;
+  const size_t height_;
+  const size_t row_bytes_;
+  PresentCallback present_;
+
+  std::mutex mutex_;
+  // Kept in stacking order.
+  std::vector<SoftwarePlane *> planes_;
+  std::vector<uint8_t> application_;
+  std::vector<uint8_t> composited_;
+
+  void RemovePlane(SoftwarePlane *plane);
+
+  // Recomposites |area| of the display and presents it.
+  void ComposeLocked(const DamageRect &area);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(SoftwarePlaneAllocator);
+};
+
+} // namespace flutter
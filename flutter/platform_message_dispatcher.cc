@@ -0,0 +1,143 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform_message_dispatcher.h"
+
+#include <memory>
+
+namespace flutter {
+
+PlatformMessageResponse::PlatformMessageResponse() = default;
+
+PlatformMessageResponse::PlatformMessageResponse(
+    std::shared_ptr<PlatformMessageEngine> engine,
+    const FlutterPlatformMessageResponseHandle *handle)
+    : engine_(std::move(engine)), handle_(handle) {}
+
+PlatformMessageResponse::PlatformMessageResponse(
+    PlatformMessageResponse &&other)
+    : engine_(std::move(other.engine_)), handle_(other.handle_) {
+  other.handle_ = nullptr;
+}
+
+PlatformMessageResponse &PlatformMessageResponse::
+operator=(PlatformMessageResponse &&other) {
+  if (this != &other) {
+    Send(nullptr, 0);
+    engine_ = std::move(other.engine_);
+    handle_ = other.handle_;
+    other.handle_ = nullptr;
+  }
+  return *this;
+}
+
+PlatformMessageResponse::~PlatformMessageResponse() { Send(nullptr, 0); }
+
+bool PlatformMessageResponse::IsPending() const { return handle_ != nullptr; }
+
+bool PlatformMessageResponse::Send(const uint8_t *data, size_t size) {
+  if (handle_ == nullptr) {
+    return false;
+  }
+
+  // The engine frees the handle once it has been responded to.
+  const auto handle = handle_;
+  handle_ = nullptr;
+  // Held while sending so that the engine can't shut down meanwhile.
+  std::lock_guard<std::mutex> lock(engine_->mutex);
+  if (engine_->engine == nullptr) {
+    FLWAY_DLOG << "Dropped a platform message response sent after shutdown."
+               << std::endl;
+    return false;
+  }
+  if (FlutterEngineSendPlatformMessageResponse(engine_->engine, handle, data,
+                                               size) != kSuccess) {
+    FLWAY_ERROR << "Could not respond to a platform message." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+PlatformMessageDispatcher::PlatformMessageDispatcher()
+    : response_engine_(std::make_shared<PlatformMessageEngine>()) {}
+
+PlatformMessageDispatcher::~PlatformMessageDispatcher() { SetEngine(nullptr); }
+
+void PlatformMessageDispatcher::SetEngine(FlutterEngine engine) {
+  engine_ = engine;
+  std::lock_guard<std::mutex> lock(response_engine_->mutex);
+  response_engine_->engine = engine;
+}
+
+void PlatformMessageDispatcher::SetHandler(const std::string &channel,
+                                           Handler handler) {
+  if (!handler) {
+    handlers_.erase(channel);
+    return;
+  }
+  handlers_[channel] = std::move(handler);
+}
+
+void PlatformMessageDispatcher::Dispatch(
+    const FlutterPlatformMessage &message) {
+  PlatformMessageResponse response(response_engine_, message.response_handle);
+
+  auto found = handlers_.find(message.channel);
+  if (found == handlers_.end()) {
+    // The response replies that the channel isn't implemented.
+    FLWAY_DLOG << "No handler for platform channel " << message.channel
+               << std::endl;
+    return;
+  }
+
+  found->second(message.message, message.message_size, std::move(response));
+}
+
+bool PlatformMessageDispatcher::Send(const char *channel, const uint8_t *data,
+                                     size_t size, ReplyHandler reply) {
+  FlutterPlatformMessage message = {};
+  message.struct_size = sizeof(FlutterPlatformMessage);
+  message.channel = channel;
+  message.message = data;
+  message.message_size = size;
+
+  // Only messages that want a reply pay for allocating a handle.
+  FlutterPlatformMessageResponseHandle *handle = nullptr;
+  std::unique_ptr<ReplyHandler> reply_handler;
+  if (reply) {
+    reply_handler = std::make_unique<ReplyHandler>(std::move(reply));
+    if (FlutterPlatformMessageCreateResponseHandle(
+            engine_,
+            [](const uint8_t *data, size_t size, void *userdata) {
+              std::unique_ptr<ReplyHandler> reply_handler(
+                  reinterpret_cast<ReplyHandler *>(userdata));
+              (*reply_handler)(data, size);
+            },
+            reply_handler.get(), &handle) != kSuccess) {
+      FLWAY_ERROR << "Could not create a platform message response handle."
+                  << std::endl;
+      return false;
+    }
+    message.response_handle = handle;
+  }
+
+  const auto result = FlutterEngineSendPlatformMessage(engine_, &message);
+
+  // The engine holds on to what it needs from the handle.
+  if (handle != nullptr) {
+    FlutterPlatformMessageReleaseResponseHandle(engine_, handle);
+  }
+
+  if (result != kSuccess) {
+    FLWAY_ERROR << "Could not send a platform message on " << channel
+                << std::endl;
+    return false;
+  }
+
+  // Freed by the response handle's callback from now on.
+  reply_handler.release();
+  return true;
+}
+
+} // namespace flutter
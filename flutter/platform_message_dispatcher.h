@@ -0,0 +1,99 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "macros.h"
+
+namespace flutter {
+
+// The engine as responses see it. Cleared before the engine shuts down, after
+// which responses are dropped.
+struct PlatformMessageEngine {
+  std::mutex mutex;
+  FlutterEngine engine = nullptr;
+};
+
+// The reply to one platform message from the Dart side. Every message must be
+// answered exactly once, but not necessarily before the handler returns.
+// Responses that are dropped unanswered reply with an empty message, which
+// Dart treats as the channel not being implemented.
+class PlatformMessageResponse {
+public:
+  PlatformMessageResponse();
+
+  PlatformMessageResponse(std::shared_ptr<PlatformMessageEngine> engine,
+                          const FlutterPlatformMessageResponseHandle *handle);
+
+  PlatformMessageResponse(PlatformMessageResponse &&other);
+
+  PlatformMessageResponse &operator=(PlatformMessageResponse &&other);
+
+  ~PlatformMessageResponse();
+
+  // False for messages that don't expect a reply and responses that were
+  // already sent.
+  bool IsPending() const;
+
+  // May be called on any thread. The engine copies |data|. Returns false
+  // without sending once the engine is shutting down.
+  bool Send(const uint8_t *data, size_t size);
+
+private:
+  std::shared_ptr<PlatformMessageEngine> engine_;
+  const FlutterPlatformMessageResponseHandle *handle_ = nullptr;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PlatformMessageResponse);
+};
+
+// Routes platform messages from the engine to handlers registered by channel
+// name and sends messages the other way. Messages are handed to handlers in
+// the buffer the engine owns, so they must be decoded before the handler
+// returns.
+class PlatformMessageDispatcher {
+public:
+  using Handler = std::function<void(const uint8_t *message, size_t size,
+                                     PlatformMessageResponse response)>;
+  using ReplyHandler = std::function<void(const uint8_t *data, size_t size)>;
+
+  PlatformMessageDispatcher();
+
+  ~PlatformMessageDispatcher();
+
+  // Must be set before any messages are sent or dispatched, and set to null
+  // before the engine shuts down. Responses pending then are dropped.
+  void SetEngine(FlutterEngine engine);
+
+  // Handlers are called on the platform thread. A null handler removes the
+  // channel. Must be called on the platform thread.
+  void SetHandler(const std::string &channel, Handler handler);
+
+  // Called on the platform thread with each message from the engine.
+  void Dispatch(const FlutterPlatformMessage &message);
+
+  // Sends a message to the Dart side. May be called on any thread. If |reply|
+  // is set it is called on the platform thread with the Dart side's response.
+  bool Send(const char *channel, const uint8_t *data, size_t size,
+            ReplyHandler reply = nullptr);
+
+private:
+  FlutterEngine engine_ = nullptr;
+  // Shared with the responses, which may outlive the engine.
+  std::shared_ptr<PlatformMessageEngine> response_engine_;
+  // Ordered so that channels can be looked up by the engine's C string
+  // without constructing a string for each message.
+  std::map<std::string, Handler, std::less<>> handlers_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PlatformMessageDispatcher);
+};
+
+} // namespace flutter
@@ -0,0 +1,164 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "pointer_event_queue.h"
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "utils.h"
+
+namespace flutter {
+
+PointerEventQueue::PointerEventQueue(uint64_t frame_interval_nanos,
+                                     Dispatcher dispatcher)
+    : frame_interval_nanos_(frame_interval_nanos),
+      dispatcher_(std::move(dispatcher)) {
+  wakeup_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wakeup_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the pointer event wakeup." << std::endl;
+    return;
+  }
+  batch_.reserve(64);
+  batch_timestamps_.reserve(64);
+  pending_moves_.reserve(16);
+}
+
+PointerEventQueue::~PointerEventQueue() {
+  if (dropped_count_ > 0) {
+    FLWAY_ERROR << "Dropped " << dropped_count_
+                << " pointer events because the queue was full." << std::endl;
+  }
+
+  if (wakeup_fd_ != -1) {
+    ::close(wakeup_fd_);
+  }
+}
+
+bool PointerEventQueue::IsValid() const { return wakeup_fd_ != -1; }
+
+int PointerEventQueue::GetWakeupFD() const { return wakeup_fd_; }
+
+void PointerEventQueue::Close() {
+  closed_ = true;
+  Signal();
+}
+
+bool PointerEventQueue::IsClosed() const { return closed_; }
+
+bool PointerEventQueue::IsDrained() const { return ring_.IsEmpty(); }
+
+size_t PointerEventQueue::GetCoalescedCount() const {
+  return coalesced_count_;
+}
+
+void PointerEventQueue::Signal() {
+  uint64_t value = 1;
+  if (::write(wakeup_fd_, &value, sizeof(value)) != sizeof(value)) {
+    FLWAY_ERROR << "Could not signal the pointer event queue." << std::endl;
+  }
+}
+
+// |InputReader::Delegate|
+void PointerEventQueue::OnInputPointerEvents(const FlutterPointerEvent *events,
+                                             size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (!ring_.Push(events[i])) {
+      dropped_count_++;
+    }
+  }
+  Signal();
+}
+
+uint64_t PointerEventQueue::Dispatch() {
+  uint64_t value = 0;
+  while (::read(wakeup_fd_, &value, sizeof(value)) == -1 && errno == EINTR) {
+  }
+
+  FlutterPointerEvent event = {};
+  while (ring_.Pop(event)) {
+    if ((event.phase == kMove || event.phase == kHover) &&
+        event.signal_kind == kFlutterPointerSignalKindNone) {
+      AddMove(event);
+      continue;
+    }
+    // Anything else for this device must come after its pending move.
+    FlushMove(event.device);
+    AddToBatch(event, event.timestamp);
+  }
+
+  const auto now = GetMonotonicTimeNanos();
+
+  // Pending moves ride along with any other dispatch. Otherwise they wait for
+  // the frame interval to elapse.
+  if (!pending_moves_.empty() &&
+      (!batch_.empty() ||
+       now >= last_move_dispatch_nanos_ + frame_interval_nanos_)) {
+    FlushMoves();
+    last_move_dispatch_nanos_ = now;
+  }
+
+  if (!batch_.empty()) {
+    // Widened only now that every event in the batch has been pushed.
+    const uint64_t now_micros = now / 1000;
+    uint64_t oldest = now_micros;
+    for (const auto timestamp : batch_timestamps_) {
+      oldest = std::min(oldest, WidenTimestamp(timestamp, now_micros));
+    }
+    dispatcher_(batch_.data(), batch_.size(), oldest);
+    batch_.clear();
+    batch_timestamps_.clear();
+  }
+
+  return pending_moves_.empty()
+             ? 0
+             : last_move_dispatch_nanos_ + frame_interval_nanos_;
+}
+
+void PointerEventQueue::AddMove(const FlutterPointerEvent &event) {
+  for (auto &pending : pending_moves_) {
+    if (pending.event.device == event.device &&
+        pending.event.phase == event.phase &&
+        pending.event.buttons == event.buttons) {
+      // The engine gets the latest position and time. Latency is measured
+      // from the first move.
+      pending.event = event;
+      coalesced_count_++;
+      return;
+    }
+  }
+  // A change in buttons, or between hovering and dragging, is not a merge
+  // candidate.
+  FlushMove(event.device);
+  pending_moves_.push_back({event, event.timestamp});
+}
+
+void PointerEventQueue::AddToBatch(const FlutterPointerEvent &event,
+                                   size_t first_timestamp) {
+  batch_.push_back(event);
+  batch_timestamps_.push_back(first_timestamp);
+}
+
+void PointerEventQueue::FlushMove(int32_t device) {
+  auto found = std::find_if(pending_moves_.begin(), pending_moves_.end(),
+                            [device](const PendingMove &pending) {
+                              return pending.event.device == device;
+                            });
+  if (found != pending_moves_.end()) {
+    AddToBatch(found->event, found->first_timestamp);
+    pending_moves_.erase(found);
+  }
+}
+
+void PointerEventQueue::FlushMoves() {
+  for (const auto &pending : pending_moves_) {
+    AddToBatch(pending.event, pending.first_timestamp);
+  }
+  pending_moves_.clear();
+}
+
+} // namespace flutter
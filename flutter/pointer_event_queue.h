@@ -0,0 +1,100 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "input_reader.h"
+#include "macros.h"
+#include "spsc_ring.h"
+
+namespace flutter {
+
+// Hands pointer events from the input reader thread to the thread that talks
+// to the engine without locks. Runs of move or hover events from the same
+// device are merged so that at most one per device is dispatched per frame
+// interval. Other phases are dispatched as soon as they are seen, in order.
+class PointerEventQueue : public InputReader::Delegate {
+public:
+  // |oldest_timestamp| is when the oldest event of the batch happened, in
+  // microseconds, including the moves merged into the ones dispatched, which
+  // carry the time of the latest. Unlike the events' own timestamps, it
+  // doesn't wrap on 32 bit targets.
+  using Dispatcher =
+      std::function<void(const FlutterPointerEvent *events, size_t count,
+                         uint64_t oldest_timestamp)>;
+
+  PointerEventQueue(uint64_t frame_interval_nanos, Dispatcher dispatcher);
+
+  ~PointerEventQueue() override;
+
+  bool IsValid() const;
+
+  // Readable when |Dispatch| has work to do. Only valid on the consumer
+  // thread.
+  int GetWakeupFD() const;
+
+  // Drains the ring and dispatches events. Must only be called on the consumer
+  // thread. Returns the monotonic time (in nanoseconds) at which coalesced
+  // moves become due, or zero if none are pending.
+  uint64_t Dispatch();
+
+  // Wakes the consumer and marks the queue as closed. May be called on any
+  // thread.
+  void Close();
+
+  bool IsClosed() const;
+
+  // True once the consumer has taken every event pushed so far. Coalesced
+  // moves may still be waiting to be dispatched. Only valid on the producer
+  // thread.
+  bool IsDrained() const;
+
+  // Number of move and hover events that were merged into a later one.
+  size_t GetCoalescedCount() const;
+
+  // |InputReader::Delegate|
+  void OnInputPointerEvents(const FlutterPointerEvent *events,
+                            size_t count) override;
+
+private:
+  struct PendingMove {
+    FlutterPointerEvent event;
+    // The time of the first move merged into |event|.
+    size_t first_timestamp;
+  };
+
+  const uint64_t frame_interval_nanos_;
+  Dispatcher dispatcher_;
+  int wakeup_fd_ = -1;
+  SPSCRing<FlutterPointerEvent, 1024> ring_;
+  std::atomic<bool> closed_{false};
+  std::vector<FlutterPointerEvent> batch_;
+  // The first timestamp of each event in |batch_|.
+  std::vector<size_t> batch_timestamps_;
+  std::vector<PendingMove> pending_moves_;
+  uint64_t last_move_dispatch_nanos_ = 0;
+  size_t coalesced_count_ = 0;
+  size_t dropped_count_ = 0;
+
+  void AddMove(const FlutterPointerEvent &event);
+
+  void AddToBatch(const FlutterPointerEvent &event, size_t first_timestamp);
+
+  void FlushMove(int32_t device);
+
+  void FlushMoves();
+
+  void Signal();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PointerEventQueue);
+};
+
+} // namespace flutter
@@ -0,0 +1,335 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "shader_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "utils.h"
+
+namespace flutter {
+
+// Suffix of files being copied into place.
+static const char kTemporarySuffix[] = ".tmp";
+
+namespace {
+
+struct CachedFile {
+  // Relative to the cache directory.
+  std::string name;
+  size_t size;
+  time_t last_used;
+};
+
+} // namespace
+
+static bool IsDirectory(const std::string &path) {
+  struct stat info = {};
+  return ::stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool EndsWith(const std::string &string, const char *suffix) {
+  const size_t length = ::strlen(suffix);
+  return string.size() >= length &&
+         string.compare(string.size() - length, length, suffix) == 0;
+}
+
+static bool MakeDirectories(const std::string &path) {
+  size_t slash = 0;
+  while ((slash = path.find('/', slash + 1)) != std::string::npos) {
+    if (::mkdir(path.substr(0, slash).c_str(), 0755) != 0 &&
+        errno != EEXIST) {
+      return false;
+    }
+  }
+  return ::mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+// The engine keeps a directory per engine version, so the cache is a tree.
+static void ListFiles(const std::string &root, const std::string &relative,
+                      std::vector<CachedFile> &files) {
+  const auto directory_path = relative.empty() ? root : root + "/" + relative;
+  auto directory = ::opendir(directory_path.c_str());
+  if (directory == nullptr) {
+    return;
+  }
+
+  while (auto entry = ::readdir(directory)) {
+    if (::strcmp(entry->d_name, ".") == 0 ||
+        ::strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    const auto name =
+        relative.empty() ? entry->d_name : relative + "/" + entry->d_name;
+    struct stat info = {};
+    if (::lstat((root + "/" + name).c_str(), &info) != 0) {
+      continue;
+    }
+    if (S_ISDIR(info.st_mode)) {
+      ListFiles(root, name, files);
+    } else if (S_ISREG(info.st_mode)) {
+      // Access times are only updated about once a day under relatime, which
+      // is plenty for units that reboot daily.
+      files.push_back({name, static_cast<size_t>(info.st_size),
+                       std::max(info.st_atime, info.st_mtime)});
+    }
+  }
+  ::closedir(directory);
+}
+
+static void RemoveTree(const std::string &path) {
+  struct stat info = {};
+  if (::lstat(path.c_str(), &info) != 0) {
+    return;
+  }
+  if (!S_ISDIR(info.st_mode)) {
+    ::unlink(path.c_str());
+    return;
+  }
+
+  if (auto directory = ::opendir(path.c_str())) {
+    while (auto entry = ::readdir(directory)) {
+      if (::strcmp(entry->d_name, ".") != 0 &&
+          ::strcmp(entry->d_name, "..") != 0) {
+        RemoveTree(path + "/" + entry->d_name);
+      }
+    }
+    ::closedir(directory);
+  }
+  ::rmdir(path.c_str());
+}
+
+// Writes a temporary file and renames it over |to| so that a power cut never
+// leaves a partial shader behind for the engine to trip over.
+static bool CopyFileAtomically(const std::string &from,
+                               const std::string &to) {
+  const auto slash = to.find_last_of('/');
+  if (slash != std::string::npos && !MakeDirectories(to.substr(0, slash))) {
+    return false;
+  }
+
+  const int source = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (source == -1) {
+    return false;
+  }
+
+  const auto temporary = to + kTemporarySuffix;
+  const int destination =
+      ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (destination == -1) {
+    ::close(source);
+    return false;
+  }
+
+  bool copied = true;
+  char buffer[16 * 1024];
+  while (true) {
+    const ssize_t read_size = ::read(source, buffer, sizeof(buffer));
+    if (read_size == 0) {
+      break;
+    }
+    if (read_size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      copied = false;
+      break;
+    }
+    if (::write(destination, buffer, read_size) != read_size) {
+      copied = false;
+      break;
+    }
+  }
+
+  copied = copied && ::fsync(destination) == 0;
+  copied = ::close(destination) == 0 && copied;
+  ::close(source);
+
+  if (!copied || ::rename(temporary.c_str(), to.c_str()) != 0) {
+    ::unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+ShaderCache::ShaderCache(const Config &config) : config_(config) {
+  if (!Open()) {
+    return;
+  }
+
+  if (!read_only_ && !config_.warm_up) {
+    const auto copied = Seed();
+    if (copied > 0) {
+      FLWAY_LOG << "Copied " << copied << " bundled shaders to the cache."
+                << std::endl;
+    }
+    Trim();
+  }
+
+  valid_ = true;
+}
+
+ShaderCache::~ShaderCache() {
+  if (valid_ && config_.warm_up) {
+    Publish();
+  }
+}
+
+bool ShaderCache::IsValid() const { return valid_; }
+
+const std::string &ShaderCache::GetPath() const { return path_; }
+
+bool ShaderCache::IsReadOnly() const { return read_only_; }
+
+bool ShaderCache::Open() {
+  if (config_.warm_up) {
+    // Only what the application compiles this time should ship.
+    RemoveTree(config_.directory);
+  }
+
+  if (MakeDirectories(config_.directory) &&
+      ::access(config_.directory.c_str(), W_OK) == 0) {
+    path_ = config_.directory;
+    return true;
+  }
+
+  const auto error = errno;
+  if (!config_.warm_up && IsDirectory(config_.bundled_directory)) {
+    FLWAY_WARNING << "Could not write to the shader cache "
+                  << config_.directory << ": " << strerror(error)
+                  << ". Using the bundled shaders read only." << std::endl;
+    path_ = config_.bundled_directory;
+    read_only_ = true;
+    return true;
+  }
+
+  FLWAY_ERROR << "Could not create the shader cache " << config_.directory
+              << ": " << strerror(error) << std::endl;
+  return false;
+}
+
+size_t ShaderCache::Seed() {
+  std::vector<CachedFile> bundled;
+  ListFiles(config_.bundled_directory, "", bundled);
+
+  size_t copied = 0;
+  for (const auto &file : bundled) {
+    const auto destination = path_ + "/" + file.name;
+    if (::access(destination.c_str(), F_OK) == 0) {
+      continue;
+    }
+    if (!CopyFileAtomically(config_.bundled_directory + "/" + file.name,
+                            destination)) {
+      FLWAY_WARNING << "Could not copy the bundled shader " << file.name
+                    << " to the cache." << std::endl;
+      continue;
+    }
+    copied++;
+  }
+  return copied;
+}
+
+void ShaderCache::Trim() {
+  std::vector<CachedFile> files;
+  ListFiles(path_, "", files);
+
+  // Copies cut short by a power cut.
+  files.erase(std::remove_if(files.begin(), files.end(),
+                             [this](const CachedFile &file) {
+                               if (!EndsWith(file.name, kTemporarySuffix)) {
+                                 return false;
+                               }
+                               ::unlink((path_ + "/" + file.name).c_str());
+                               return true;
+                             }),
+              files.end());
+
+  size_t total = 0;
+  for (const auto &file : files) {
+    total += file.size;
+  }
+  if (config_.max_bytes == 0 || total <= config_.max_bytes) {
+    FLWAY_DLOG << "Shader cache: " << files.size() << " files, "
+               << total / 1024 << " KiB." << std::endl;
+    return;
+  }
+
+  std::sort(files.begin(), files.end(),
+            [](const CachedFile &a, const CachedFile &b) {
+              return a.last_used < b.last_used;
+            });
+
+  size_t evicted = 0;
+  for (const auto &file : files) {
+    if (total <= config_.max_bytes) {
+      break;
+    }
+    if (::unlink((path_ + "/" + file.name).c_str()) != 0) {
+      continue;
+    }
+    total -= file.size;
+    evicted++;
+
+    // Directories left behind by older engine versions go with their last
+    // file. Removing one that isn't empty fails harmlessly.
+    auto name = file.name;
+    for (auto slash = name.find_last_of('/'); slash != std::string::npos;
+         slash = name.find_last_of('/')) {
+      name.resize(slash);
+      if (::rmdir((path_ + "/" + name).c_str()) != 0) {
+        break;
+      }
+    }
+  }
+
+  FLWAY_LOG << "Evicted " << evicted << " shaders to keep the cache under "
+            << config_.max_bytes / 1024 << " KiB." << std::endl;
+}
+
+bool ShaderCache::Publish() {
+  std::vector<CachedFile> files;
+  ListFiles(path_, "", files);
+  if (files.empty()) {
+    FLWAY_ERROR << "No shaders were compiled during warm-up. Keeping the "
+                   "bundled shaders."
+                << std::endl;
+    RemoveTree(path_);
+    return false;
+  }
+
+  // Swapped with renames so that the bundle always has a complete set.
+  const auto previous = config_.bundled_directory + ".previous";
+  RemoveTree(previous);
+  if (::rename(config_.bundled_directory.c_str(), previous.c_str()) != 0 &&
+      errno != ENOENT) {
+    FLWAY_ERROR << "Could not move the bundled shaders aside: "
+                << strerror(errno) << std::endl;
+    return false;
+  }
+  if (::rename(path_.c_str(), config_.bundled_directory.c_str()) != 0) {
+    FLWAY_ERROR << "Could not move the warmed up shaders into the bundle: "
+                << strerror(errno) << std::endl;
+    ::rename(previous.c_str(), config_.bundled_directory.c_str());
+    return false;
+  }
+  RemoveTree(previous);
+
+  size_t total = 0;
+  for (const auto &file : files) {
+    total += file.size;
+  }
+  FLWAY_LOG << "Bundled " << files.size() << " shaders (" << total / 1024
+            << " KiB) in " << config_.bundled_directory << "." << std::endl;
+  return true;
+}
+
+} // namespace flutter
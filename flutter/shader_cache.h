@@ -0,0 +1,69 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Manages the directory the engine keeps compiled shaders in across launches.
+// Shaders shipped with the asset bundle are copied in when missing and the
+// least recently used files are evicted to keep the cache under a size limit.
+// Both happen when the cache is opened, since a unit that is powered off never
+// gets to clean up on exit.
+//
+// In warm-up mode the cache starts out empty and replaces the bundled shaders
+// when it is destroyed, so that whatever was compiled while the application
+// ran ships with the bundle.
+class ShaderCache {
+public:
+  struct Config {
+    // Where the engine reads and writes compiled shaders.
+    std::string directory;
+    // Shaders shipped with the bundle. Used as is, read only, if |directory|
+    // is not writable.
+    std::string bundled_directory;
+    // Zero for no limit.
+    size_t max_bytes = 32 * 1024 * 1024;
+    bool warm_up = false;
+  };
+
+  explicit ShaderCache(const Config &config);
+
+  // Must be destroyed after the engine has been shut down.
+  ~ShaderCache();
+
+  bool IsValid() const;
+
+  // The directory to hand to the engine.
+  const std::string &GetPath() const;
+
+  // The engine must not write to the cache.
+  bool IsReadOnly() const;
+
+private:
+  const Config config_;
+  std::string path_;
+  bool read_only_ = false;
+  bool valid_ = false;
+
+  bool Open();
+
+  // Copies bundled shaders that are missing from the cache. Returns the number
+  // of files copied.
+  size_t Seed();
+
+  void Trim();
+
+  bool Publish();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ShaderCache);
+};
+
+} // namespace flutter
@@ -0,0 +1,65 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A bounded lock-free queue with exactly one producer thread and one consumer
+// thread. |kCapacity| must be a power of two.
+template <typename T, size_t kCapacity> class SPSCRing {
+public:
+  static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0,
+                "Capacity must be a power of two.");
+
+  SPSCRing() = default;
+
+  // May only be called on the producer thread. Returns false if the ring is
+  // full.
+  bool Push(const T &item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+      return false;
+    }
+    items_[tail & (kCapacity - 1)] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // May only be called on the consumer thread. Returns false if the ring is
+  // empty.
+  bool Pop(T &item) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items_[head & (kCapacity - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // May be called on either thread. Only the consumer can rely on the answer
+  // staying true.
+  bool IsEmpty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  // The indices only ever increase. Each is written by one side only and kept
+  // on its own cache line to avoid false sharing.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) T items_[kCapacity];
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(SPSCRing);
+};
+
+} // namespace flutter
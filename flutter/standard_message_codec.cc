@@ -0,0 +1,344 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "standard_message_codec.h"
+
+#include <string.h>
+
+namespace flutter {
+
+// Sizes below this are stored in a single byte.
+static const uint8_t kSizeUint16 = 254;
+static const uint8_t kSizeUint32 = 255;
+
+// Guards against malicious messages exhausting the stack.
+static const size_t kMaxDepth = 64;
+
+bool StandardValue::StringEquals(const char *string) const {
+  return type == StandardValueType::kString && ::strlen(string) == size &&
+         ::memcmp(string_value, string, size) == 0;
+}
+
+const StandardValue *StandardValue::Find(const char *key) const {
+  if (type != StandardValueType::kMap) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < size; i++) {
+    if (map[i * 2].StringEquals(key)) {
+      return &map[i * 2 + 1];
+    }
+  }
+  return nullptr;
+}
+
+StandardMessageReader::StandardMessageReader(const uint8_t *data, size_t size,
+                                             Arena &arena)
+    : data_(data), size_(size), arena_(arena) {}
+
+const StandardValue *StandardMessageReader::ReadValue() {
+  auto value = arena_.AllocateArray<StandardValue>(1);
+  if (value == nullptr || !ReadValue(*value, 0)) {
+    return nullptr;
+  }
+  return value;
+}
+
+bool StandardMessageReader::IsAtEnd() const { return offset_ == size_; }
+
+bool StandardMessageReader::ReadValue(StandardValue &value, size_t depth) {
+  uint8_t type = 0;
+  if (depth > kMaxDepth || !ReadBytes(&type, sizeof(type))) {
+    return false;
+  }
+
+  value.type = static_cast<StandardValueType>(type);
+  value.size = 0;
+  value.int_value = 0;
+
+  const void *elements = nullptr;
+  switch (value.type) {
+  case StandardValueType::kNull:
+  case StandardValueType::kTrue:
+  case StandardValueType::kFalse:
+    return true;
+  case StandardValueType::kInt32: {
+    int32_t int32 = 0;
+    if (!ReadBytes(&int32, sizeof(int32))) {
+      return false;
+    }
+    value.int_value = int32;
+    return true;
+  }
+  case StandardValueType::kInt64:
+    return ReadBytes(&value.int_value, sizeof(value.int_value));
+  case StandardValueType::kFloat64:
+    return Align(8) && ReadBytes(&value.double_value, sizeof(double));
+  case StandardValueType::kLargeInt:
+  case StandardValueType::kString:
+  case StandardValueType::kUint8List:
+    if (!ReadSize(value.size) || !ReadTypedData(elements, value.size, 1)) {
+      return false;
+    }
+    value.uint8_list = static_cast<const uint8_t *>(elements);
+    return true;
+  case StandardValueType::kInt32List:
+  case StandardValueType::kFloat32List:
+    if (!ReadSize(value.size) || !Align(4) ||
+        !ReadTypedData(elements, value.size, 4)) {
+      return false;
+    }
+    value.int32_list = static_cast<const int32_t *>(elements);
+    return true;
+  case StandardValueType::kInt64List:
+  case StandardValueType::kFloat64List:
+    if (!ReadSize(value.size) || !Align(8) ||
+        !ReadTypedData(elements, value.size, 8)) {
+      return false;
+    }
+    value.int64_list = static_cast<const int64_t *>(elements);
+    return true;
+  case StandardValueType::kList:
+  case StandardValueType::kMap: {
+    if (!ReadSize(value.size)) {
+      return false;
+    }
+    // Every element takes at least a byte, which bounds the allocation for
+    // messages that lie about their size. Checked before doubling the size
+    // of maps, which could otherwise wrap where size_t has 32 bits.
+    const size_t per_element = value.type == StandardValueType::kMap ? 2 : 1;
+    if (value.size > (size_ - offset_) / per_element) {
+      return false;
+    }
+    const size_t count = value.size * per_element;
+    auto children = arena_.AllocateArray<StandardValue>(count);
+    if (children == nullptr && count > 0) {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (!ReadValue(children[i], depth + 1)) {
+        return false;
+      }
+    }
+    value.list = children;
+    return true;
+  }
+  }
+
+  return false;
+}
+
+bool StandardMessageReader::ReadSize(size_t &size) {
+  uint8_t byte = 0;
+  if (!ReadBytes(&byte, sizeof(byte))) {
+    return false;
+  }
+  if (byte < kSizeUint16) {
+    size = byte;
+    return true;
+  }
+  if (byte == kSizeUint16) {
+    uint16_t size16 = 0;
+    if (!ReadBytes(&size16, sizeof(size16))) {
+      return false;
+    }
+    size = size16;
+    return true;
+  }
+  uint32_t size32 = 0;
+  if (!ReadBytes(&size32, sizeof(size32))) {
+    return false;
+  }
+  size = size32;
+  return true;
+}
+
+bool StandardMessageReader::ReadBytes(void *bytes, size_t count) {
+  if (count > size_ - offset_) {
+    return false;
+  }
+  ::memcpy(bytes, data_ + offset_, count);
+  offset_ += count;
+  return true;
+}
+
+bool StandardMessageReader::Align(size_t alignment) {
+  const size_t remainder = offset_ % alignment;
+  if (remainder == 0) {
+    return true;
+  }
+  const size_t padding = alignment - remainder;
+  if (padding > size_ - offset_) {
+    return false;
+  }
+  offset_ += padding;
+  return true;
+}
+
+bool StandardMessageReader::ReadTypedData(const void *&elements,
+                                          size_t count, size_t element_size) {
+  if (count > (size_ - offset_) / element_size) {
+    return false;
+  }
+  const size_t length = count * element_size;
+  const uint8_t *source = data_ + offset_;
+  offset_ += length;
+
+  // Padding in the message aligns elements relative to its start. The engine's
+  // buffers are malloc'd so this only copies for callers that pass in slices.
+  if (reinterpret_cast<uintptr_t>(source) % element_size == 0) {
+    elements = source;
+    return true;
+  }
+  auto copy = arena_.Allocate(length, element_size);
+  if (copy == nullptr) {
+    return false;
+  }
+  ::memcpy(copy, source, length);
+  elements = copy;
+  return true;
+}
+
+bool DecodeStandardMethodCall(const uint8_t *data, size_t size, Arena &arena,
+                              StandardMethodCall &call) {
+  StandardMessageReader reader(data, size, arena);
+  call.method = reader.ReadValue();
+  if (call.method == nullptr || !call.method->IsString()) {
+    return false;
+  }
+  call.arguments = reader.ReadValue();
+  return call.arguments != nullptr && reader.IsAtEnd();
+}
+
+StandardMessageWriter::StandardMessageWriter() = default;
+
+void StandardMessageWriter::Clear() { buffer_.clear(); }
+
+const uint8_t *StandardMessageWriter::GetData() const {
+  return buffer_.data();
+}
+
+size_t StandardMessageWriter::GetSize() const { return buffer_.size(); }
+
+void StandardMessageWriter::WriteNull() {
+  WriteType(StandardValueType::kNull);
+}
+
+void StandardMessageWriter::WriteBool(bool value) {
+  WriteType(value ? StandardValueType::kTrue : StandardValueType::kFalse);
+}
+
+void StandardMessageWriter::WriteInt(int64_t value) {
+  if (value >= INT32_MIN && value <= INT32_MAX) {
+    const int32_t int32 = static_cast<int32_t>(value);
+    WriteType(StandardValueType::kInt32);
+    WriteBytes(&int32, sizeof(int32));
+    return;
+  }
+  WriteType(StandardValueType::kInt64);
+  WriteBytes(&value, sizeof(value));
+}
+
+void StandardMessageWriter::WriteDouble(double value) {
+  WriteType(StandardValueType::kFloat64);
+  Align(8);
+  WriteBytes(&value, sizeof(value));
+}
+
+void StandardMessageWriter::WriteString(const char *string) {
+  WriteString(string, ::strlen(string));
+}
+
+void StandardMessageWriter::WriteString(const char *string, size_t length) {
+  WriteTypedData(StandardValueType::kString, string, length, 1);
+}
+
+void StandardMessageWriter::WriteUint8List(const uint8_t *elements,
+                                           size_t count) {
+  WriteTypedData(StandardValueType::kUint8List, elements, count, 1);
+}
+
+void StandardMessageWriter::WriteInt32List(const int32_t *elements,
+                                           size_t count) {
+  WriteTypedData(StandardValueType::kInt32List, elements, count, 4);
+}
+
+void StandardMessageWriter::WriteInt64List(const int64_t *elements,
+                                           size_t count) {
+  WriteTypedData(StandardValueType::kInt64List, elements, count, 8);
+}
+
+void StandardMessageWriter::WriteFloat32List(const float *elements,
+                                             size_t count) {
+  WriteTypedData(StandardValueType::kFloat32List, elements, count, 4);
+}
+
+void StandardMessageWriter::WriteFloat64List(const double *elements,
+                                             size_t count) {
+  WriteTypedData(StandardValueType::kFloat64List, elements, count, 8);
+}
+
+void StandardMessageWriter::BeginList(size_t count) {
+  WriteType(StandardValueType::kList);
+  WriteSize(count);
+}
+
+void StandardMessageWriter::BeginMap(size_t count) {
+  WriteType(StandardValueType::kMap);
+  WriteSize(count);
+}
+
+void StandardMessageWriter::BeginSuccessEnvelope() { buffer_.push_back(0); }
+
+void StandardMessageWriter::WriteErrorEnvelope(const char *code,
+                                               const char *message) {
+  buffer_.push_back(1);
+  WriteString(code);
+  if (message != nullptr) {
+    WriteString(message);
+  } else {
+    WriteNull();
+  }
+  WriteNull();
+}
+
+void StandardMessageWriter::WriteType(StandardValueType type) {
+  buffer_.push_back(static_cast<uint8_t>(type));
+}
+
+void StandardMessageWriter::WriteSize(size_t size) {
+  if (size < kSizeUint16) {
+    buffer_.push_back(static_cast<uint8_t>(size));
+  } else if (size <= UINT16_MAX) {
+    const uint16_t size16 = static_cast<uint16_t>(size);
+    buffer_.push_back(kSizeUint16);
+    WriteBytes(&size16, sizeof(size16));
+  } else {
+    const uint32_t size32 = static_cast<uint32_t>(size);
+    buffer_.push_back(kSizeUint32);
+    WriteBytes(&size32, sizeof(size32));
+  }
+}
+
+void StandardMessageWriter::WriteBytes(const void *bytes, size_t count) {
+  auto begin = static_cast<const uint8_t *>(bytes);
+  buffer_.insert(buffer_.end(), begin, begin + count);
+}
+
+void StandardMessageWriter::Align(size_t alignment) {
+  const size_t remainder = buffer_.size() % alignment;
+  if (remainder != 0) {
+    buffer_.resize(buffer_.size() + alignment - remainder, 0);
+  }
+}
+
+void StandardMessageWriter::WriteTypedData(StandardValueType type,
+                                           const void *elements, size_t count,
+                                           size_t element_size) {
+  WriteType(type);
+  WriteSize(count);
+  Align(element_size);
+  WriteBytes(elements, count * element_size);
+}
+
+} // namespace flutter
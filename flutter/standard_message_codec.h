@@ -0,0 +1,186 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "macros.h"
+
+namespace flutter {
+
+// The wire format of StandardMessageCodec in package:flutter/services.dart.
+enum class StandardValueType : uint8_t {
+  kNull = 0,
+  kTrue = 1,
+  kFalse = 2,
+  kInt32 = 3,
+  kInt64 = 4,
+  kLargeInt = 5,
+  kFloat64 = 6,
+  kString = 7,
+  kUint8List = 8,
+  kInt32List = 9,
+  kInt64List = 10,
+  kFloat64List = 11,
+  kList = 12,
+  kMap = 13,
+  kFloat32List = 14,
+};
+
+// A decoded value. Strings and typed data point into the message being
+// decoded, and lists and maps into the arena used to decode it, so a value is
+// only valid as long as both are.
+struct StandardValue {
+  StandardValueType type;
+  // The length in bytes of strings, the element count of typed data and lists
+  // and the entry count of maps.
+  size_t size;
+  union {
+    int64_t int_value;
+    double double_value;
+    // Not NUL terminated. Large ints are hex strings.
+    const char *string_value;
+    const uint8_t *uint8_list;
+    const int32_t *int32_list;
+    const int64_t *int64_list;
+    const float *float32_list;
+    const double *float64_list;
+    const StandardValue *list;
+    // Keys and values alternate.
+    const StandardValue *map;
+  };
+
+  bool IsNull() const { return type == StandardValueType::kNull; }
+
+  bool IsBool() const {
+    return type == StandardValueType::kTrue ||
+           type == StandardValueType::kFalse;
+  }
+
+  bool IsInt() const {
+    return type == StandardValueType::kInt32 ||
+           type == StandardValueType::kInt64;
+  }
+
+  bool IsString() const { return type == StandardValueType::kString; }
+
+  bool StringEquals(const char *string) const;
+
+  // Returns the value for the given string key of a map, or null if the value
+  // isn't a map or has no such key.
+  const StandardValue *Find(const char *key) const;
+};
+
+// Decodes values from a message without copying it. Aggregates are allocated
+// from |arena|, which callers typically reset after each message.
+class StandardMessageReader {
+public:
+  StandardMessageReader(const uint8_t *data, size_t size, Arena &arena);
+
+  // Returns null if the message is malformed or truncated.
+  const StandardValue *ReadValue();
+
+  bool IsAtEnd() const;
+
+private:
+  const uint8_t *const data_;
+  const size_t size_;
+  Arena &arena_;
+  size_t offset_ = 0;
+
+  bool ReadValue(StandardValue &value, size_t depth);
+
+  bool ReadSize(size_t &size);
+
+  bool ReadBytes(void *bytes, size_t count);
+
+  bool Align(size_t alignment);
+
+  // Points |elements| at the next |count| elements, copying them into the
+  // arena only if the message itself isn't suitably aligned in memory.
+  bool ReadTypedData(const void *&elements, size_t count, size_t element_size);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StandardMessageReader);
+};
+
+// Encodes values into a buffer that is reused after |Clear|, so that encoding
+// messages of similar size doesn't allocate.
+class StandardMessageWriter {
+public:
+  StandardMessageWriter();
+
+  void Clear();
+
+  const uint8_t *GetData() const;
+
+  size_t GetSize() const;
+
+  void WriteNull();
+
+  void WriteBool(bool value);
+
+  // Uses the smallest of the int32 and int64 encodings that fits.
+  void WriteInt(int64_t value);
+
+  void WriteDouble(double value);
+
+  void WriteString(const char *string);
+
+  void WriteString(const char *string, size_t length);
+
+  void WriteUint8List(const uint8_t *elements, size_t count);
+
+  void WriteInt32List(const int32_t *elements, size_t count);
+
+  void WriteInt64List(const int64_t *elements, size_t count);
+
+  void WriteFloat32List(const float *elements, size_t count);
+
+  void WriteFloat64List(const double *elements, size_t count);
+
+  // Must be followed by |count| values.
+  void BeginList(size_t count);
+
+  // Must be followed by |count| pairs of keys and values.
+  void BeginMap(size_t count);
+
+  // Starts a StandardMethodCodec reply. Must be followed by the result.
+  void BeginSuccessEnvelope();
+
+  // Writes a complete StandardMethodCodec error reply with null details.
+  void WriteErrorEnvelope(const char *code, const char *message);
+
+private:
+  std::vector<uint8_t> buffer_;
+
+  void WriteType(StandardValueType type);
+
+  void WriteSize(size_t size);
+
+  void WriteBytes(const void *bytes, size_t count);
+
+  void Align(size_t alignment);
+
+  void WriteTypedData(StandardValueType type, const void *elements,
+                      size_t count, size_t element_size);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StandardMessageWriter);
+};
+
+// A call encoded by StandardMethodCodec.
+struct StandardMethodCall {
+  const StandardValue *method = nullptr;
+  const StandardValue *arguments = nullptr;
+};
+
+bool DecodeStandardMethodCall(const uint8_t *data, size_t size, Arena &arena,
+                              StandardMethodCall &call);
+
+} // namespace flutter
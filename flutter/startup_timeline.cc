@@ -0,0 +1,51 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "startup_timeline.h"
+
+#include <algorithm>
+#include <iomanip>
+
+#include "utils.h"
+
+namespace flutter {
+
+StartupTimeline::StartupTimeline() : origin_(GetMonotonicTimeNanos()) {}
+
+StartupTimeline::~StartupTimeline() = default;
+
+uint64_t StartupTimeline::GetOrigin() const { return origin_; }
+
+void StartupTimeline::AddPhase(std::string name, uint64_t begin,
+                               uint64_t end) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  phases_.push_back({std::move(name), begin, end});
+}
+
+void StartupTimeline::Log() const {
+  std::vector<Phase> phases;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    phases = phases_;
+  }
+
+  std::stable_sort(phases.begin(), phases.end(),
+                   [](const Phase &a, const Phase &b) {
+                     return a.begin < b.begin;
+                   });
+
+  auto millis = [this](uint64_t time) {
+    return time > origin_ ? (time - origin_) / 1e6 : 0.0;
+  };
+
+  for (const auto &phase : phases) {
+    FLWAY_LOG << "Startup: " << std::fixed << std::setprecision(1)
+              << std::setw(8) << millis(phase.begin) << " - " << std::setw(8)
+              << millis(phase.end) << " ms (" << std::setw(7)
+              << (phase.end - phase.begin) / 1e6 << " ms) " << phase.name
+              << std::endl;
+  }
+}
+
+} // namespace flutter
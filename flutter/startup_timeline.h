@@ -0,0 +1,48 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Collects the start and end times of the phases of startup, which may run
+// concurrently on different threads. Times are relative to the construction of
+// the timeline.
+class StartupTimeline {
+public:
+  StartupTimeline();
+
+  ~StartupTimeline();
+
+  uint64_t GetOrigin() const;
+
+  // May be called on any thread. Times are monotonic nanoseconds.
+  void AddPhase(std::string name, uint64_t begin, uint64_t end);
+
+  // Logs every phase recorded so far in the order they started.
+  void Log() const;
+
+private:
+  struct Phase {
+    std::string name;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  const uint64_t origin_;
+  mutable std::mutex mutex_;
+  std::vector<Phase> phases_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StartupTimeline);
+};
+
+} // namespace flutter
@@ -0,0 +1,268 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "test_pattern_producer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "utils.h"
+
+// Older sysroots lack the udmabuf header and the sealing constants.
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#endif
+
+#ifndef F_SEAL_SHRINK
+#define F_SEAL_SHRINK 0x0002
+#endif
+
+namespace flutter {
+
+struct UdmabufCreate {
+  uint32_t memfd;
+  uint32_t flags;
+  uint64_t offset;
+  uint64_t size;
+};
+
+static const unsigned long kUdmabufCreate = _IOW('u', 0x42, UdmabufCreate);
+static const uint32_t kUdmabufFlagsCloexec = 0x01;
+
+// 'AB24': R, G, B and A bytes in memory order.
+static const uint32_t kFourCCABGR8888 = 0x34324241;
+
+static const size_t kBufferCount = 3;
+
+TestPatternProducer::TestPatternProducer(FlutterApplication &application,
+                                         size_t width, size_t height,
+                                         double frames_per_second)
+    : application_(&application), width_(width), height_(height),
+      frames_per_second_(frames_per_second) {
+  ExternalTexture::Config config;
+  config.width = width_;
+  config.height = height_;
+  config.buffer_count = kBufferCount;
+  if (CreateDmaBufs(kBufferCount)) {
+    for (const auto &memory : dmabufs_) {
+      ExternalTexture::DmaBuf dmabuf;
+      dmabuf.fd = memory.dmabuf_fd;
+      dmabuf.fourcc = kFourCCABGR8888;
+      dmabuf.stride = width_ * 4;
+      config.dmabufs.push_back(dmabuf);
+    }
+  }
+
+  texture_ = application_->RegisterExternalTexture(config);
+  if (!texture_) {
+    return;
+  }
+
+  FLWAY_LOG << "Test pattern texture " << texture_->GetID() << ": " << width_
+            << " x " << height_ << " from "
+            << (dmabufs_.empty() ? "memory" : "dmabufs") << std::endl;
+  thread_ = std::thread([this]() { Run(); });
+}
+
+TestPatternProducer::TestPatternProducer(PlaneAllocator &planes, size_t width,
+                                         size_t height, int32_t x, int32_t y,
+                                         double frames_per_second)
+    : planes_(&planes), width_(width), height_(height),
+      frames_per_second_(frames_per_second) {
+  plane_ = planes_->AllocatePlane(PlaneKind::kVideo, width_, height_);
+  if (!plane_) {
+    return;
+  }
+  plane_pixels_.resize(width_ * height_ * 4);
+  plane_->SetPosition(x, y);
+  plane_->SetVisible(true);
+
+  FLWAY_LOG << "Test pattern plane: " << width_ << " x " << height_ << " at "
+            << x << ", " << y << std::endl;
+  thread_ = std::thread([this]() { RunOnPlane(); });
+}
+
+TestPatternProducer::~TestPatternProducer() {
+  terminated_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  if (texture_) {
+    application_->UnregisterExternalTexture(texture_->GetID());
+  }
+
+  if (plane_) {
+    plane_.reset();
+    planes_->Commit();
+  }
+
+  // Images imported from the dmabufs keep the memory alive for as long as the
+  // engine still samples them.
+  for (auto &memory : dmabufs_) {
+    if (memory.pixels != nullptr) {
+      ::munmap(memory.pixels, memory.size);
+    }
+    if (memory.dmabuf_fd != -1) {
+      ::close(memory.dmabuf_fd);
+    }
+    if (memory.memfd != -1) {
+      ::close(memory.memfd);
+    }
+  }
+}
+
+bool TestPatternProducer::IsValid() const {
+  return texture_ != nullptr || plane_ != nullptr;
+}
+
+int64_t TestPatternProducer::GetTextureID() const {
+  return texture_ ? texture_->GetID() : 0;
+}
+
+bool TestPatternProducer::CreateDmaBufs(size_t count) {
+#if defined(__NR_memfd_create)
+  const int device = ::open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+  if (device == -1) {
+    return false;
+  }
+
+  const size_t page_size = ::sysconf(_SC_PAGESIZE);
+  const size_t size =
+      (width_ * height_ * 4 + page_size - 1) / page_size * page_size;
+
+  bool success = true;
+  for (size_t i = 0; i < count && success; ++i) {
+    DmaBufMemory memory;
+    memory.size = size;
+    memory.memfd = ::syscall(__NR_memfd_create, "flutter_test_pattern",
+                             MFD_ALLOW_SEALING);
+    success = memory.memfd != -1 &&
+              ::ftruncate(memory.memfd, size) == 0 &&
+              ::fcntl(memory.memfd, F_ADD_SEALS, F_SEAL_SHRINK) == 0;
+    if (success) {
+      UdmabufCreate create = {};
+      create.memfd = memory.memfd;
+      create.flags = kUdmabufFlagsCloexec;
+      create.size = size;
+      memory.dmabuf_fd = ::ioctl(device, kUdmabufCreate, &create);
+      success = memory.dmabuf_fd != -1;
+    }
+    if (success) {
+      auto pixels = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                           memory.memfd, 0);
+      success = pixels != MAP_FAILED;
+      memory.pixels = success ? static_cast<uint8_t *>(pixels) : nullptr;
+    }
+    dmabufs_.push_back(memory);
+  }
+  ::close(device);
+
+  if (!success) {
+    FLWAY_WARNING << "Could not create dmabufs for the test pattern."
+                  << std::endl;
+    for (auto &memory : dmabufs_) {
+      if (memory.pixels != nullptr) {
+        ::munmap(memory.pixels, memory.size);
+      }
+      if (memory.dmabuf_fd != -1) {
+        ::close(memory.dmabuf_fd);
+      }
+      if (memory.memfd != -1) {
+        ::close(memory.memfd);
+      }
+    }
+    dmabufs_.clear();
+  }
+  return success;
+#else
+  return false;
+#endif
+}
+
+void TestPatternProducer::Run() {
+  const auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(1.0 / frames_per_second_));
+  auto next_frame = std::chrono::steady_clock::now();
+  size_t frame = 0;
+  size_t skipped = 0;
+
+  while (!terminated_) {
+    next_frame += interval;
+    std::this_thread::sleep_until(next_frame);
+
+    auto buffer = texture_->AcquireBuffer();
+    if (buffer == nullptr) {
+      // Like a camera, the producer doesn't wait for the consumer.
+      skipped++;
+      continue;
+    }
+
+    uint8_t *pixels = dmabufs_.empty() ? buffer->pixels
+                                       : dmabufs_[buffer->index].pixels;
+    DrawFrame(pixels, buffer->row_bytes, frame++);
+    if (!texture_->SubmitBuffer(buffer)) {
+      break;
+    }
+  }
+
+  FLWAY_LOG << "Test pattern produced " << frame << " frames and skipped "
+            << skipped << std::endl;
+}
+
+void TestPatternProducer::RunOnPlane() {
+  const auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(1.0 / frames_per_second_));
+  auto next_frame = std::chrono::steady_clock::now();
+  size_t frame = 0;
+
+  while (!terminated_) {
+    next_frame += interval;
+    std::this_thread::sleep_until(next_frame);
+
+    // Shown by the display as it is, without a frame of the application.
+    DrawFrame(plane_pixels_.data(), width_ * 4, frame++);
+    if (!plane_->SetContents(plane_pixels_.data(), width_ * 4)) {
+      break;
+    }
+    planes_->Commit();
+  }
+
+  FLWAY_LOG << "Test pattern showed " << frame << " frames on its plane."
+            << std::endl;
+}
+
+// A horizontal gradient with a bar sweeping across it, so that dropped or
+// torn frames are easy to spot.
+void TestPatternProducer::DrawFrame(uint8_t *pixels, size_t row_bytes,
+                                    size_t frame) {
+  const size_t bar_width = std::max<size_t>(width_ / 16, 1);
+  const size_t bar_x = (frame * 4) % width_;
+  // Textures take R, G, B, A bytes and planes B, G, R, A.
+  const size_t red = plane_ ? 2 : 0;
+  const size_t blue = 2 - red;
+  for (size_t y = 0; y < height_; ++y) {
+    uint8_t *row = pixels + y * row_bytes;
+    for (size_t x = 0; x < width_; ++x) {
+      const bool bar = x >= bar_x && x < bar_x + bar_width;
+      row[x * 4 + red] = bar ? 255 : x * 255 / width_;
+      row[x * 4 + 1] = bar ? 255 : y * 255 / height_;
+      row[x * 4 + blue] = bar ? 255 : (frame * 2) & 0xff;
+      row[x * 4 + 3] = 255;
+    }
+  }
+}
+
+} // namespace flutter
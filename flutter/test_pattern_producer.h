@@ -0,0 +1,71 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "external_texture.h"
+#include "flutter_application.h"
+#include "macros.h"
+#include "planes.h"
+
+namespace flutter {
+
+// Feeds an external texture with a moving test pattern from its own thread,
+// standing in for a camera or video decoder. Frames are drawn into dmabufs
+// made from memfds when the kernel has udmabuf, and into the texture's own
+// buffers otherwise. It can also stand in for a video decoder that bypasses
+// the application, on a video plane.
+class TestPatternProducer {
+public:
+  TestPatternProducer(FlutterApplication &application, size_t width,
+                      size_t height, double frames_per_second);
+
+  // Shows the pattern on a video plane at |x|, |y|.
+  TestPatternProducer(PlaneAllocator &planes, size_t width, size_t height,
+                      int32_t x, int32_t y, double frames_per_second);
+
+  // Unregisters the texture or frees the plane.
+  ~TestPatternProducer();
+
+  bool IsValid() const;
+
+  int64_t GetTextureID() const;
+
+private:
+  struct DmaBufMemory {
+    int memfd = -1;
+    int dmabuf_fd = -1;
+    uint8_t *pixels = nullptr;
+    size_t size = 0;
+  };
+
+  FlutterApplication *application_ = nullptr;
+  PlaneAllocator *planes_ = nullptr;
+  const size_t width_;
+  const size_t height_;
+  const double frames_per_second_;
+  std::vector<DmaBufMemory> dmabufs_;
+  std::shared_ptr<ExternalTexture> texture_;
+  std::unique_ptr<Plane> plane_;
+  std::vector<uint8_t> plane_pixels_;
+  std::atomic<bool> terminated_{false};
+  std::thread thread_;
+
+  bool CreateDmaBufs(size_t count);
+
+  void Run();
+
+  void RunOnPlane();
+
+  void DrawFrame(uint8_t *pixels, size_t row_bytes, size_t frame);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(TestPatternProducer);
+};
+
+} // namespace flutter
@@ -0,0 +1,222 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "thread_policy.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include "logging.h"
+
+namespace flutter {
+
+static const size_t kThreadRoleCount =
+    static_cast<size_t>(ThreadRole::kInput) + 1;
+
+// Written before the threads start and only read afterwards.
+static ThreadPolicy gThreadPolicies[kThreadRoleCount];
+
+// What the calling thread ran with before a policy was applied to it.
+static thread_local bool tSchedulingSaved = false;
+static thread_local ThreadScheduling tSavedScheduling;
+
+static bool ParseInt(const std::string &string, int min, int max, int *value) {
+  if (string.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  errno = 0;
+  const long parsed = ::strtol(string.c_str(), &end, 10);
+  if (errno != 0 || *end != '\0' || parsed < min || parsed > max) {
+    return false;
+  }
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
+static bool ParseCPUs(const std::string &list, std::vector<int> *cpus) {
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, '+')) {
+    const auto dash = item.find('-');
+    int first = 0;
+    int last = 0;
+    if (dash == std::string::npos) {
+      if (!ParseInt(item, 0, CPU_SETSIZE - 1, &first)) {
+        return false;
+      }
+      last = first;
+    } else if (!ParseInt(item.substr(0, dash), 0, CPU_SETSIZE - 1, &first) ||
+               !ParseInt(item.substr(dash + 1), first, CPU_SETSIZE - 1,
+                         &last)) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus->push_back(cpu);
+    }
+  }
+  return !cpus->empty();
+}
+
+bool ThreadPolicy::IsDefault() const {
+  return cpus.empty() && realtime_priority == 0 && !has_nice;
+}
+
+bool ParseThreadPolicy(const std::string &spec, ThreadPolicy *policy) {
+  ThreadPolicy parsed;
+  std::stringstream stream(spec);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    const auto equals = item.find('=');
+    if (equals == std::string::npos) {
+      return false;
+    }
+    const auto key = item.substr(0, equals);
+    const auto value = item.substr(equals + 1);
+    if (key == "cpus") {
+      if (!ParseCPUs(value, &parsed.cpus)) {
+        return false;
+      }
+    } else if (key == "fifo") {
+      if (!ParseInt(value, 1, 99, &parsed.realtime_priority)) {
+        return false;
+      }
+    } else if (key == "nice") {
+      if (!ParseInt(value, -20, 19, &parsed.nice)) {
+        return false;
+      }
+      parsed.has_nice = true;
+    } else {
+      return false;
+    }
+  }
+  *policy = parsed;
+  return true;
+}
+
+const char *GetThreadRoleName(ThreadRole role) {
+  switch (role) {
+  case ThreadRole::kPlatform:
+    return "platform";
+  case ThreadRole::kUI:
+    return "ui";
+  case ThreadRole::kRaster:
+    return "raster";
+  case ThreadRole::kIO:
+    return "io";
+  case ThreadRole::kInput:
+    return "input";
+  }
+  return "unknown";
+}
+
+void SetThreadPolicy(ThreadRole role, const ThreadPolicy &policy) {
+  gThreadPolicies[static_cast<size_t>(role)] = policy;
+}
+
+// Failures are not fatal. The thread keeps running with the defaults.
+static void ApplyThreadPolicy(ThreadRole role, const ThreadPolicy &policy) {
+  const char *name = GetThreadRoleName(role);
+
+  if (!policy.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : policy.cpus) {
+      CPU_SET(cpu, &set);
+    }
+    const int error =
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+      FLWAY_WARNING << "Could not set the CPU affinity of the " << name
+                    << " thread: " << ::strerror(error) << std::endl;
+    }
+  }
+
+  if (policy.realtime_priority > 0) {
+    sched_param param = {};
+    param.sched_priority = policy.realtime_priority;
+    const int error =
+        ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+    if (error != 0) {
+      FLWAY_WARNING << "Could not make the " << name << " thread SCHED_FIFO "
+                    << policy.realtime_priority << ": " << ::strerror(error)
+                    << ". This needs CAP_SYS_NICE or an RLIMIT_RTPRIO."
+                    << std::endl;
+    }
+  } else if (policy.has_nice) {
+    // On Linux the nice value belongs to the thread, not the process.
+    const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+    if (::setpriority(PRIO_PROCESS, tid, policy.nice) != 0) {
+      FLWAY_WARNING << "Could not set the nice value of the " << name
+                    << " thread to " << policy.nice << ": "
+                    << ::strerror(errno) << std::endl;
+    }
+  }
+
+  FLWAY_LOG << "Applied the " << name << " thread policy." << std::endl;
+}
+
+static void GetThreadScheduling(ThreadScheduling &scheduling) {
+  CPU_ZERO(&scheduling.cpus);
+  ::pthread_getaffinity_np(::pthread_self(), sizeof(scheduling.cpus),
+                           &scheduling.cpus);
+  ::pthread_getschedparam(::pthread_self(), &scheduling.policy,
+                          &scheduling.param);
+  const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+  scheduling.nice = ::getpriority(PRIO_PROCESS, tid);
+}
+
+// Going back to a saved scheduling only needs the privileges it was first
+// set up with.
+static void SetThreadScheduling(const ThreadScheduling &scheduling) {
+  ::pthread_setaffinity_np(::pthread_self(), sizeof(scheduling.cpus),
+                           &scheduling.cpus);
+  ::pthread_setschedparam(::pthread_self(), scheduling.policy,
+                          &scheduling.param);
+  const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+  ::setpriority(PRIO_PROCESS, tid, scheduling.nice);
+}
+
+void ApplyThreadPolicyOnce(ThreadRole role) {
+  static thread_local bool applied[kThreadRoleCount] = {};
+  const auto index = static_cast<size_t>(role);
+  if (applied[index]) {
+    return;
+  }
+  applied[index] = true;
+
+  const auto &policy = gThreadPolicies[index];
+  if (!policy.IsDefault()) {
+    if (!tSchedulingSaved) {
+      GetThreadScheduling(tSavedScheduling);
+      tSchedulingSaved = true;
+    }
+    ApplyThreadPolicy(role, policy);
+  }
+}
+
+ScopedDefaultThreadPolicy::ScopedDefaultThreadPolicy() {
+  if (!tSchedulingSaved) {
+    return;
+  }
+  GetThreadScheduling(applied_);
+  SetThreadScheduling(tSavedScheduling);
+  restore_ = true;
+}
+
+ScopedDefaultThreadPolicy::~ScopedDefaultThreadPolicy() {
+  if (restore_) {
+    SetThreadScheduling(applied_);
+  }
+}
+
+} // namespace flutter
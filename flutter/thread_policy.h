@@ -0,0 +1,78 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sched.h>
+
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// The threads whose placement and priority can be configured. The engine
+// creates the UI, raster and IO threads itself, so their policies are applied
+// from the first embedder callback the engine makes on each of them.
+enum class ThreadRole {
+  kPlatform,
+  kUI,
+  kRaster,
+  kIO,
+  kInput,
+};
+
+struct ThreadPolicy {
+  // The CPUs the thread may run on. Empty leaves the affinity alone.
+  std::vector<int> cpus;
+  // A SCHED_FIFO priority from 1 to 99. Zero keeps the default scheduler.
+  int realtime_priority = 0;
+  // Applied to threads that stay on the default scheduler.
+  bool has_nice = false;
+  int nice = 0;
+
+  bool IsDefault() const;
+};
+
+// Parses a comma separated list such as "cpus=2-3,fifo=10" or
+// "cpus=0,nice=-5". CPU lists are single CPUs or ranges joined with '+',
+// such as "0+2-3".
+bool ParseThreadPolicy(const std::string &spec, ThreadPolicy *policy);
+
+const char *GetThreadRoleName(ThreadRole role);
+
+// Must be called before the threads with |role| are started.
+void SetThreadPolicy(ThreadRole role, const ThreadPolicy &policy);
+
+// Applies the policy for |role| to the calling thread the first time it is
+// called on that thread. Cheap enough to call from per frame callbacks.
+void ApplyThreadPolicyOnce(ThreadRole role);
+
+// The placement and priority of a thread.
+struct ThreadScheduling {
+  cpu_set_t cpus;
+  int policy = SCHED_OTHER;
+  sched_param param = {};
+  int nice = 0;
+};
+
+// Threads inherit the placement and priority of the thread that creates them.
+// While in scope, the calling thread runs as it did before its own policy was
+// applied, so that threads started meanwhile (such as those of an engine
+// launched after the platform thread's policy took effect) don't inherit it.
+class ScopedDefaultThreadPolicy {
+public:
+  ScopedDefaultThreadPolicy();
+
+  ~ScopedDefaultThreadPolicy();
+
+private:
+  bool restore_ = false;
+  ThreadScheduling applied_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ScopedDefaultThreadPolicy);
+};
+
+} // namespace flutter
@@ -4,12 +4,24 @@
 
 #include "utils.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <sstream>
 
 namespace flutter {
 
+static const char* kICUDataFileName = "icudtl.dat";
+
+const char kKernelBlobFileName[] = "kernel_blob.bin";
+const char kAppELFFileName[] = "app.so";
+const char kVMSnapshotDataFileName[] = "vm_snapshot_data";
+const char kVMSnapshotInstructionsFileName[] = "vm_snapshot_instr";
+const char kIsolateSnapshotDataFileName[] = "isolate_snapshot_data";
+const char kIsolateSnapshotInstructionsFileName[] = "isolate_snapshot_instr";
+
 static std::string GetExecutablePath() {
   char executable_path[1024] = {0};
   std::stringstream stream;
@@ -46,18 +58,148 @@ bool FileExistsAtPath(const std::string& path) {
   return ::access(path.c_str(), R_OK) == 0;
 }
 
+uint64_t GetMonotonicTimeNanos() {
+  timespec time = {};
+  ::clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+uint64_t WidenTimestamp(size_t timestamp, uint64_t now_micros) {
+  // The age is exact in size_t arithmetic, however often the clock wrapped.
+  const size_t age = static_cast<size_t>(now_micros) - timestamp;
+  return now_micros - age;
+}
+
+std::string GetICUDataPath(const std::string& bundle_path) {
+  auto exe_dir = GetExecutableDirectory();
+  if (exe_dir != "") {
+    std::stringstream stream;
+    stream << exe_dir << kICUDataFileName;
+    auto icu_path = stream.str();
+    if (FileExistsAtPath(icu_path.c_str())) {
+      return icu_path;
+    }
+  }
+
+  auto bundle_icu_path = bundle_path + "/" + kICUDataFileName;
+  if (!FileExistsAtPath(bundle_icu_path)) {
+    FLWAY_ERROR << "Could not find " << kICUDataFileName << " next to the "
+                << "executable or in " << bundle_path << std::endl;
+    return "";
+  }
+
+  return bundle_icu_path;
+}
+
+BundleCodeType GetBundleCodeType(const std::string& bundle_path) {
+  auto exists = [&bundle_path](const char* name) {
+    return FileExistsAtPath(bundle_path + "/" + name);
+  };
+
+  // Prefer AOT code when a bundle has both.
+  if (exists(kAppELFFileName)) {
+    return BundleCodeType::kAOTELF;
+  }
+
+  if (exists(kVMSnapshotDataFileName) &&
+      exists(kVMSnapshotInstructionsFileName) &&
+      exists(kIsolateSnapshotDataFileName) &&
+      exists(kIsolateSnapshotInstructionsFileName)) {
+    return BundleCodeType::kAOTSnapshots;
+  }
+
+  if (exists(kKernelBlobFileName)) {
+    return BundleCodeType::kKernel;
+  }
+
+  return BundleCodeType::kNone;
+}
+
 bool FlutterAssetBundleIsValid(const std::string& bundle_path) {
   if (!FileExistsAtPath(bundle_path)) {
     FLWAY_ERROR << "Bundle directory does not exist." << std::endl;
     return false;
   }
 
-  if (!FileExistsAtPath(bundle_path + std::string{"/kernel_blob.bin"})) {
-    FLWAY_ERROR << "Kernel blob does not exist." << std::endl;
+  if (GetBundleCodeType(bundle_path) == BundleCodeType::kNone) {
+    FLWAY_ERROR << "Bundle contains neither a kernel blob nor AOT snapshots."
+                << std::endl;
     return false;
   }
 
   return true;
 }
 
+bool ExtractFlag(std::vector<std::string>& args,
+                 const std::string& name,
+                 std::string* value) {
+  const auto prefix = name + "=";
+  bool found = false;
+  for (auto it = args.begin(); it != args.end();) {
+    if (*it == name) {
+      if (value != nullptr) {
+        value->clear();
+      }
+    } else if (it->compare(0, prefix.size(), prefix) == 0) {
+      if (value != nullptr) {
+        *value = it->substr(prefix.size());
+      }
+    } else {
+      ++it;
+      continue;
+    }
+    found = true;
+    it = args.erase(it);
+  }
+  return found;
+}
+
+std::vector<std::string> ExtractFlagValues(std::vector<std::string>& args,
+                                           const std::string& name) {
+  const auto prefix = name + "=";
+  std::vector<std::string> values;
+  for (auto it = args.begin(); it != args.end();) {
+    if (*it == name) {
+      values.emplace_back();
+    } else if (it->compare(0, prefix.size(), prefix) == 0) {
+      values.push_back(it->substr(prefix.size()));
+    } else {
+      ++it;
+      continue;
+    }
+    it = args.erase(it);
+  }
+  return values;
+}
+
+bool HasExtension(const char* extensions, const char* name) {
+  if (extensions == nullptr) {
+    return false;
+  }
+  const size_t length = ::strlen(name);
+  for (auto found = ::strstr(extensions, name); found != nullptr;
+       found = ::strstr(found + length, name)) {
+    const char end = found[length];
+    if ((found == extensions || found[-1] == ' ') &&
+        (end == ' ' || end == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParseSize(const std::string& string, size_t* width, size_t* height) {
+  unsigned long parsed_width = 0;
+  unsigned long parsed_height = 0;
+  char trailing = 0;
+  if (::sscanf(string.c_str(), "%lux%lu%c", &parsed_width, &parsed_height,
+               &trailing) != 2 ||
+      parsed_width == 0 || parsed_height == 0) {
+    return false;
+  }
+  *width = parsed_width;
+  *height = parsed_height;
+  return true;
+}
+
 }  // namespace flutter
@@ -4,16 +4,71 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
 #include "macros.h"
 
 namespace flutter {
 
+// Files in an asset bundle that hold the application's Dart code. JIT bundles
+// have a kernel blob. AOT bundles have either the four snapshot blobs or an
+// ELF library containing them.
+extern const char kKernelBlobFileName[];
+extern const char kAppELFFileName[];
+extern const char kVMSnapshotDataFileName[];
+extern const char kVMSnapshotInstructionsFileName[];
+extern const char kIsolateSnapshotDataFileName[];
+extern const char kIsolateSnapshotInstructionsFileName[];
+
+enum class BundleCodeType {
+  kNone,
+  kKernel,
+  kAOTSnapshots,
+  kAOTELF,
+};
+
 std::string GetExecutableName();
 
 std::string GetExecutableDirectory();
 
 bool FileExistsAtPath(const std::string& path);
 
+// The current time on the monotonic clock the engine uses for timestamps.
+uint64_t GetMonotonicTimeNanos();
+
+// Pointer event timestamps are a size_t of microseconds, which wraps every 71
+// minutes on 32 bit targets. Returns the full time of a |timestamp| taken no
+// later than |now_micros|.
+uint64_t WidenTimestamp(size_t timestamp, uint64_t now_micros);
+
+// The ICU data file next to the executable, or else the one in the bundle.
+// Empty if there is neither.
+std::string GetICUDataPath(const std::string& bundle_path);
+
+BundleCodeType GetBundleCodeType(const std::string& bundle_path);
+
 bool FlutterAssetBundleIsValid(const std::string& bundle_path);
 
+// Removes all "--name=value" or "--name" arguments from |args|. Returns true if
+// the flag was present. The last value seen is written to |value| (if not
+// null). Used to keep embedder flags from being forwarded to the engine.
+bool ExtractFlag(std::vector<std::string>& args,
+                 const std::string& name,
+                 std::string* value);
+
+// Like |ExtractFlag| but for flags that may be given more than once. Returns
+// every value in the order given.
+std::vector<std::string> ExtractFlagValues(std::vector<std::string>& args,
+                                           const std::string& name);
+
+// Whether |name| appears in a space separated extension string, as returned by
+// eglQueryString and glGetString.
+bool HasExtension(const char* extensions, const char* name);
+
+// Parses sizes of the form "800x480".
+bool ParseSize(const std::string& string, size_t* width, size_t* height);
+
 }  // namespace flutter
@@ -0,0 +1,135 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "video_core.h"
+
+#include <algorithm>
+
+#include "utils.h"
+
+namespace flutter {
+
+std::shared_ptr<VideoCore> VideoCore::Acquire() {
+  static std::weak_ptr<VideoCore> shared;
+  auto video_core = shared.lock();
+  if (!video_core) {
+    video_core.reset(new VideoCore());
+    shared = video_core;
+  }
+  return video_core;
+}
+
+VideoCore::VideoCore() {
+  bcm_host_init();
+
+  auto display = ::eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY) {
+    FLWAY_ERROR << "Could not get the EGL display." << std::endl;
+    return;
+  }
+
+  if (::eglInitialize(display, nullptr, nullptr) != EGL_TRUE) {
+    FLWAY_ERROR << "Could not initialize the EGL display." << std::endl;
+    return;
+  }
+
+  display_ = display;
+  valid_ = true;
+}
+
+VideoCore::~VideoCore() {
+  // Not under the lock since a callback in flight may be waiting on it. The
+  // vsync thread may have unregistered already, which is harmless to repeat.
+  if (vsync_callback_registered_) {
+    ::vc_dispmanx_vsync_callback(vsync_display_, nullptr, nullptr);
+  }
+
+  if (display_ != EGL_NO_DISPLAY) {
+    ::eglTerminate(display_);
+    display_ = EGL_NO_DISPLAY;
+  }
+
+  ::bcm_host_deinit();
+}
+
+bool VideoCore::IsValid() const { return valid_; }
+
+EGLDisplay VideoCore::GetEGLDisplay() const { return display_; }
+
+void VideoCore::AddVsyncObserver(VsyncObserver *observer) {
+  std::unique_lock<std::mutex> lock(vsync_mutex_);
+  vsync_dispatched_.wait(lock, [this]() { return !dispatching_vsync_; });
+  vsync_observers_.push_back(observer);
+}
+
+void VideoCore::RemoveVsyncObserver(VsyncObserver *observer) {
+  bool unregister = false;
+  {
+    std::unique_lock<std::mutex> lock(vsync_mutex_);
+    vsync_dispatched_.wait(lock, [this]() { return !dispatching_vsync_; });
+    vsync_observers_.erase(std::remove(vsync_observers_.begin(),
+                                       vsync_observers_.end(), observer),
+                           vsync_observers_.end());
+    // The display pulses were registered on may be about to close.
+    if (vsync_observers_.empty() && vsync_callback_registered_) {
+      vsync_callback_registered_ = false;
+      unregister = true;
+    }
+  }
+
+  // Not under the lock since a pulse in flight may be waiting on it.
+  if (unregister) {
+    ::vc_dispmanx_vsync_callback(vsync_display_, nullptr, nullptr);
+  }
+}
+
+void VideoCore::RequestVsync(DISPMANX_DISPLAY_HANDLE_T display) {
+  std::lock_guard<std::mutex> lock(vsync_mutex_);
+  vsync_requested_ = true;
+
+  // Video Core invokes the callback on its own thread for every vsync until
+  // it is unregistered, which happens once no display wants pulses.
+  if (!vsync_callback_registered_) {
+    if (::vc_dispmanx_vsync_callback(display, &OnDispmanxVsync, this) != 0) {
+      FLWAY_ERROR << "Could not register for display vsync." << std::endl;
+      return;
+    }
+    vsync_display_ = display;
+    vsync_callback_registered_ = true;
+  }
+}
+
+void VideoCore::OnDispmanxVsync(DISPMANX_UPDATE_HANDLE_T update, void *arg) {
+  reinterpret_cast<VideoCore *>(arg)->OnVsync();
+}
+
+void VideoCore::OnVsync() {
+  const auto now = GetMonotonicTimeNanos();
+
+  // Observers are added and removed while no pulse is being delivered, so the
+  // list can be walked without holding the lock observers call back into.
+  {
+    std::lock_guard<std::mutex> lock(vsync_mutex_);
+    dispatching_vsync_ = true;
+    vsync_requested_ = false;
+  }
+
+  bool wanted = false;
+  for (auto observer : vsync_observers_) {
+    wanted = observer->OnVideoCoreVsync(now) || wanted;
+  }
+
+  std::lock_guard<std::mutex> lock(vsync_mutex_);
+  dispatching_vsync_ = false;
+  // Nothing is animating. Stop waking up 60 times a second until the next
+  // frame is scheduled. Unregistering only queues a message to Video Core, so
+  // it is safe from its thread.
+  if (!wanted && !vsync_requested_ && vsync_callback_registered_) {
+    ::vc_dispmanx_vsync_callback(vsync_display_, nullptr, nullptr);
+    vsync_callback_registered_ = false;
+  }
+  vsync_dispatched_.notify_all();
+}
+
+} // namespace flutter
@@ -0,0 +1,81 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <bcm_host.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// The host library and EGL display every PiDisplay in the process shares.
+// Neither is reference counted by the driver, so one display going away would
+// otherwise pull them out from under the others. Video Core also only
+// delivers vsync to a single callback per process, so pulses are fanned out
+// from here.
+class VideoCore {
+public:
+  class VsyncObserver {
+  public:
+    virtual ~VsyncObserver() = default;
+
+    // Called on the Video Core thread for every pulse while the callback is
+    // registered, with the time it arrived. Returns whether the observer
+    // still wants pulses.
+    virtual bool OnVideoCoreVsync(uint64_t now) = 0;
+  };
+
+  // The instance in use, or a new one if there is none. Must be called on the
+  // thread that creates the displays.
+  static std::shared_ptr<VideoCore> Acquire();
+
+  ~VideoCore();
+
+  bool IsValid() const;
+
+  EGLDisplay GetEGLDisplay() const;
+
+  // |observer| must be removed before it is destroyed.
+  void AddVsyncObserver(VsyncObserver *observer);
+
+  // Waits for a pulse being delivered to |observer| to finish. Must not be
+  // called on the Video Core thread.
+  void RemoveVsyncObserver(VsyncObserver *observer);
+
+  // Makes sure pulses are delivered. Observers call this after deciding they
+  // want the next one. Pulses come from |display|, unless another display
+  // already asked for them.
+  void RequestVsync(DISPMANX_DISPLAY_HANDLE_T display);
+
+private:
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  bool valid_ = false;
+
+  std::mutex vsync_mutex_;
+  std::vector<VsyncObserver *> vsync_observers_;
+  DISPMANX_DISPLAY_HANDLE_T vsync_display_ = {0};
+  bool vsync_callback_registered_ = false;
+  // Set by |RequestVsync| so that a pulse nobody seemed to want doesn't
+  // unregister the callback under a request made while it was delivered.
+  bool vsync_requested_ = false;
+  bool dispatching_vsync_ = false;
+  std::condition_variable vsync_dispatched_;
+
+  VideoCore();
+
+  static void OnDispmanxVsync(DISPMANX_UPDATE_HANDLE_T update, void *arg);
+
+  void OnVsync();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(VideoCore);
+};
+
+} // namespace flutter
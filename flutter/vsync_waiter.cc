@@ -0,0 +1,94 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vsync_waiter.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+TimerVsyncWaiter::TimerVsyncWaiter(EventLoop &loop, double refresh_rate)
+    : loop_(loop),
+      period_nanos_(refresh_rate > 0.0 ? 1e9 / refresh_rate : 1e9 / 60.0),
+      phase_nanos_(GetMonotonicTimeNanos()) {
+  timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (timer_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the vsync timer." << std::endl;
+    return;
+  }
+
+  if (!loop_.AddFD(timer_fd_, EPOLLIN, [this](uint32_t) { OnTimerFired(); })) {
+    FLWAY_ERROR << "Could not watch the vsync timer." << std::endl;
+    ::close(timer_fd_);
+    timer_fd_ = -1;
+    return;
+  }
+}
+
+TimerVsyncWaiter::~TimerVsyncWaiter() {
+  if (timer_fd_ != -1) {
+    loop_.RemoveFD(timer_fd_);
+    ::close(timer_fd_);
+  }
+}
+
+bool TimerVsyncWaiter::IsValid() const { return timer_fd_ != -1; }
+
+// |VsyncWaiter|
+void TimerVsyncWaiter::AwaitVsync(Callback callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_callback_ = std::move(callback);
+
+  const auto now = GetMonotonicTimeNanos();
+  const auto next_vsync =
+      phase_nanos_ + ((now - phase_nanos_) / period_nanos_ + 1) * period_nanos_;
+
+  itimerspec spec = {};
+  spec.it_value.tv_sec = next_vsync / 1000000000ull;
+  spec.it_value.tv_nsec = next_vsync % 1000000000ull;
+  if (::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+    FLWAY_ERROR << "Could not arm the vsync timer." << std::endl;
+  }
+}
+
+// |VsyncWaiter|
+void TimerVsyncWaiter::CancelVsync() {
+  // Callbacks are invoked on the loop, which is the only thread that cancels.
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_callback_ = nullptr;
+}
+
+void TimerVsyncWaiter::OnTimerFired() {
+  uint64_t expirations = 0;
+  if (::read(timer_fd_, &expirations, sizeof(expirations)) !=
+      sizeof(expirations)) {
+    return;
+  }
+
+  Callback callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(callback, pending_callback_);
+  }
+
+  if (!callback) {
+    return;
+  }
+
+  // Report the latest pulse that is not after now. If the loop woke more
+  // than a period late, that is a later pulse than the one the timer was
+  // armed for, so the engine never gets a frame start that is already a
+  // whole period behind. The timer is one-shot, so there is never more than
+  // one expiration to account for.
+  const auto now = GetMonotonicTimeNanos();
+  const auto frame_start =
+      phase_nanos_ + ((now - phase_nanos_) / period_nanos_) * period_nanos_;
+  callback(frame_start, frame_start + period_nanos_);
+}
+
+} // namespace flutter
@@ -0,0 +1,69 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+
+#include "event_loop.h"
+#include "macros.h"
+
+namespace flutter {
+
+// A source of vsync pulses the engine can align its frames to.
+class VsyncWaiter {
+public:
+  // Times are on the monotonic clock in nanoseconds. |frame_start| is the
+  // vsync that just happened and |frame_target| is the one the frame should be
+  // ready for.
+  using Callback =
+      std::function<void(uint64_t frame_start, uint64_t frame_target)>;
+
+  virtual ~VsyncWaiter() = default;
+
+  // Invokes |callback| exactly once at the next vsync. May be called on any
+  // thread. The callback may be invoked on any thread.
+  virtual void AwaitVsync(Callback callback) = 0;
+
+  // Drops a callback that hasn't been invoked yet and waits for one that is
+  // being invoked to return. Called before the engine that asked for it shuts
+  // down, since waiters may outlive it.
+  virtual void CancelVsync() = 0;
+};
+
+// Emulates vsync for displays that don't report it by arming a timerfd for the
+// next multiple of the refresh period. Pulses are delivered on the event loop.
+class TimerVsyncWaiter : public VsyncWaiter {
+public:
+  TimerVsyncWaiter(EventLoop &loop, double refresh_rate);
+
+  ~TimerVsyncWaiter() override;
+
+  bool IsValid() const;
+
+  // |VsyncWaiter|
+  void AwaitVsync(Callback callback) override;
+
+  // |VsyncWaiter|
+  void CancelVsync() override;
+
+private:
+  EventLoop &loop_;
+  const uint64_t period_nanos_;
+  // The time of an arbitrary vsync. All others are multiples of the period
+  // from this.
+  const uint64_t phase_nanos_;
+  int timer_fd_ = -1;
+  std::mutex mutex_;
+  Callback pending_callback_;
+
+  void OnTimerFired();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(TimerVsyncWaiter);
+};
+
+} // namespace flutter